@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+#include "util/compiler.h"
+
+namespace gthread {
+/**
+ * a raw spin lock for very short critical sections that are shared between
+ * kernel-managed threads
+ *
+ * NOTE: no backoff and no fallback. the holder must not be preempted, so this
+ * should only be held along with the `preempt_mutex` (or from a context that
+ * cannot be preempted).
+ */
+class mt_capability("mutex") spin_lock {
+ public:
+  spin_lock() : _flag(false) {}
+
+  bool try_lock() mt_try_acquire(true) {
+    bool expected = false;
+    return _flag.compare_exchange_strong(expected, true,
+                                         std::memory_order_acquire);
+  }
+
+  void lock() mt_acquire() {
+    // low level spin utilizing pause instruction between tries
+    bool expected = false;
+    while (!_flag.compare_exchange_weak(expected, true,
+                                        std::memory_order_acquire)) {
+      asm("pause");
+      expected = false;
+    }
+  }
+
+  void unlock() mt_release() { _flag.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> _flag;
+};
+}  // namespace gthread
@@ -38,4 +38,13 @@ extern void gthread_switch_to(gthread_saved_ctx_t* from,
 extern void gthread_switch_to_and_spawn(
     gthread_saved_ctx_t* self_ctx, void* stack, void (*entry)(void*),
     void* arg) asm("gthread_switch_to_and_spawn");
+
+/**
+ * stores a context in |ctx| that starts running |entry| on |stack| once it is
+ * switched to with `gthread_switch_to()`. unlike
+ * `gthread_switch_to_and_spawn()`, nothing runs until then, so no switches
+ * are needed to get it ready. |entry| must not return.
+ */
+extern void gthread_prime_ctx(gthread_saved_ctx_t* ctx, void* stack,
+                              void (*entry)()) asm("gthread_prime_ctx");
 }
@@ -36,3 +36,12 @@ gthread_switch_to_and_spawn:
   movq $0, (%rsp)
   mov %rcx, %rdi  /* moves 4th parameter |arg| to the 1st parameter of |entry| */
   jmp *%rdx       /* jumps to |entry| */
+
+.global gthread_prime_ctx
+gthread_prime_ctx:
+  lea -0x10(%rsi), %rax  /* leaves |stack| 16-byte aligned after the `ret` */
+  mov %rdx, 0x00(%rax)   /* where `gthread_switch_to()` returns to */
+  movq $0, 0x08(%rax)    /* |entry| has nothing to return to */
+  mov %rax, 0x08(%rdi)
+  movq $0, 0x10(%rdi)
+  ret
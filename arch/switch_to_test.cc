@@ -27,6 +27,14 @@ void test_func(void* arg) {
   abort();
 }
 
+static int primed_runs = 0;
+
+void primed_func() {
+  ++primed_runs;
+  gthread_switch_to(nullptr, &main_ctx);
+  abort();
+}
+
 int main() {
   using namespace gthread;
 
@@ -45,5 +53,15 @@ int main() {
     gthread_switch_to(&main_ctx, &test_func_ctx);
   }
 
+  // a primed context doesn't run until it is switched to
+  gthread_saved_ctx_t primed_ctx;
+  gthread_prime_ctx(&primed_ctx, stack, primed_func);
+  if (primed_runs != 0) return -1;
+  gthread_switch_to(&main_ctx, &primed_ctx);
+  if (primed_runs != 1) {
+    std::cout << "primed context didn't run" << std::endl;
+    return -1;
+  }
+
   return !good;
 }
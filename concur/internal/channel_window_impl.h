@@ -27,8 +27,10 @@ absl::optional<T> channel_window<T>::read() {
     if (_closed.load()) {
       break;
     } else if (_waiter.park_if([this]() { return !_closed.load(); })) {
+      // the writer that woke this reader may already be parked on its next
+      // write, waiting for a reader to hand it `_reader`. waking it here would
+      // let it run before the next `read()` sets one.
       assert(_reader == nullptr);
-      while (_waiter && !_waiter.unpark()) gthread::self::yield();
       break;
     } else if (_waiter.swap()) {
       break;
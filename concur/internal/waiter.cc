@@ -4,6 +4,7 @@
 #include <mutex>
 
 #include "sched/sched.h"
+#include "sched/trace.h"
 
 namespace gthread {
 namespace internal {
@@ -21,10 +22,20 @@ bool waiter::unpark() {
 
   assert(parked->run_state == task::WAITING);
 
+  // |parked| is woken up on the node it parked on, which its affinity allows.
+  // it may still be switching away there, and that node is the only one that
+  // can safely resume it.
+  if (sched_node::current() == nullptr) {
+    // a thread hosting no node can't be preempted
+    parked->run_state = task::SUSPENDED;
+    parked->node->schedule(parked);
+    return true;
+  }
   auto& pmu = preempt_mutex::get();
   std::lock_guard<preempt_mutex> l(pmu);
   parked->run_state = task::SUSPENDED;
-  pmu.node().schedule(parked);
+  gthread_trace(pmu.node(), unpark, task::current(), parked);
+  parked->node->schedule(parked);
 
   return true;
 }
@@ -42,6 +53,16 @@ bool waiter::swap() {
   auto& pmu = preempt_mutex::get();
   std::lock_guard<preempt_mutex> l(pmu);
   current->run_state = task::WAITING;
+  gthread_trace(pmu.node(), unpark, current, parked);
+
+  // a task parked on another node can only be woken up there
+  if (parked->node != &pmu.node()) {
+    parked->run_state = task::SUSPENDED;
+    parked->node->schedule(parked);
+    pmu.node().yield();
+    return true;
+  }
+
   pmu.node().switch_to(parked);
 
   return true;
@@ -37,7 +37,8 @@ class waiter {
 
   /**
    * if there was an execution context waiting, it will be unparked to the
-   * runqueue.
+   * runqueue. may also be called from a kernel-managed thread that hosts no
+   * node.
    */
   bool unpark();
 
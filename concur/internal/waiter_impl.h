@@ -4,6 +4,7 @@
 
 #include "sched/preempt.h"
 #include "sched/sched.h"
+#include "sched/trace.h"
 
 namespace gthread {
 namespace internal {
@@ -22,6 +23,14 @@ bool waiter::park_if(CheckThunk&& check_thunk) {
     return false;
   }
 
+#ifdef GTHREAD_TRACE
+  {
+    auto& pmu = preempt_mutex::get();
+    std::lock_guard<preempt_mutex> l(pmu);
+    gthread_trace(pmu.node(), park, current, nullptr);
+  }
+#endif
+
   current->run_state = task::WAITING;
   sched::yield();
 
@@ -1,5 +1,8 @@
 #include "concur/internal/waiter.h"
 
+#include <atomic>
+#include <chrono>
+
 #include "gtest/gtest.h"
 #include "gthread.h"
 
@@ -41,3 +44,44 @@ TEST(gthread_waiter, ping_pong) {
   })
       .join();
 }
+
+/**
+ * a task that parks falls behind one that spins, so unparking it switches to
+ * it right away if wakeup preemption is on. returns whether it did.
+ */
+bool unpark_runs_parked_task_first() {
+  gthread::internal::waiter w;
+  std::atomic<bool> woken{false};
+
+  auto parked = gthread::g([&w, &woken]() {
+    while (!w.park()) {
+    }
+    woken.store(true);
+  });
+
+  bool woken_first = false;
+  gthread::g([&w, &woken, &woken_first]() {
+    for (auto start = std::chrono::steady_clock::now();
+         std::chrono::steady_clock::now() - start <
+         std::chrono::milliseconds{5};) {
+    }
+    while (!w.unpark()) {
+    }
+    woken_first = woken.load();
+  })
+      .join();
+
+  parked.join();
+  return woken_first;
+}
+
+TEST(gthread_waiter, unpark_preempts_unparker) {
+  EXPECT_TRUE(unpark_runs_parked_task_first());
+}
+
+TEST(gthread_waiter, unpark_waits_its_turn_without_wakeup_preemption) {
+  auto granularity = gthread::sched::get_wakeup_granularity();
+  gthread::sched::set_wakeup_granularity(std::chrono::nanoseconds::max());
+  EXPECT_FALSE(unpark_runs_parked_task_first());
+  gthread::sched::set_wakeup_granularity(granularity);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <utility>
+#include <vector>
 
 #include "sched/sched.h"
 #include "sched/task_attr.h"
@@ -21,6 +24,17 @@ class g {
    */
   ~g() { detach(); }
 
+  /**
+   * moves the execution context of |other|, if any, into this object, leaving
+   * |other| empty. an execution context this represented before is detached.
+   */
+  g(g&& other) = default;
+  g& operator=(g&& other) {
+    detach();
+    _handle = std::move(other._handle);
+    return *this;
+  }
+
   /**
    * creates a new execution context running |function| which will be passed
    * all of the args in |args...|
@@ -30,6 +44,14 @@ class g {
   template <typename Function, typename... Args>
   explicit g(Function&& function, Args&&... args);
 
+  /**
+   * creates |n| execution contexts in one batch, the i-th of which runs
+   * `function(i)`. they share one copy of |function|. see
+   * `gthread::sched::spawn_n()`.
+   */
+  template <typename Function>
+  static std::vector<g> spawn_many(size_t n, Function&& function);
+
   /**
    * blocks until the underlying execution context has finished running
    *
@@ -37,6 +59,14 @@ class g {
    */
   inline void join();
 
+  /**
+   * blocks until each of |gs| has finished running, and cleans them all up
+   * together. see `gthread::sched::join_all()`.
+   *
+   * each must have an associated execution context
+   */
+  inline static void join_all(std::vector<g>& gs);
+
   /**
    * lets the execution context know that nothing will `join()` it
    *
@@ -67,6 +97,14 @@ class self {
   template <class Rep, class Period>
   inline static void sleep_for(
       const std::chrono::duration<Rep, Period>& sleep_duration);
+
+  /**
+   * changes how much processor time this execution context gets relative to
+   * others, like `nice(2)`. see `gthread::sched::set_nice()`.
+   */
+  inline static void set_nice(int nice);
+
+  inline static int nice();
 };
 }  // namespace gthread
 
@@ -2,7 +2,10 @@
 
 #include "gthread.h"
 
+#include <atomic>
+#include <memory>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 #include "sched/sched.h"
@@ -26,6 +29,58 @@ g::g(Function&& function, Args&&... args) {
                          static_cast<void*>(closure.release()));
 }
 
+/**
+ * what the execution contexts made by `g::spawn_many()` share. the last one
+ * to finish deletes it.
+ */
+template <typename Function>
+struct g_many_closure {
+  struct slot {
+    g_many_closure* closure;
+    size_t index;
+  };
+
+  Function function;
+  std::atomic<size_t> running;
+  std::unique_ptr<slot[]> slots;
+};
+
+template <typename Function>
+void* g_many_start(void* arg) {
+  auto* s = static_cast<typename g_many_closure<Function>::slot*>(arg);
+  auto* closure = s->closure;
+  closure->function(s->index);
+  if (closure->running.fetch_sub(1) == 1) delete closure;
+  return nullptr;
+}
+
+template <typename Function>
+std::vector<g> g::spawn_many(size_t n, Function&& function) {
+  using closure_t = g_many_closure<std::decay_t<Function>>;
+
+  std::vector<g> gs(n);
+  if (n == 0) return gs;
+
+  std::unique_ptr<closure_t> closure(
+      new closure_t{std::forward<Function>(function), {n},
+                    std::make_unique<typename closure_t::slot[]>(n)});
+  std::vector<void*> args(n);
+  for (size_t i = 0; i < n; ++i) {
+    closure->slots[i] = {closure.get(), i};
+    args[i] = &closure->slots[i];
+  }
+
+  std::vector<sched::handle> handles(n);
+  sched::spawn_n(k_light_attr, g_many_start<std::decay_t<Function>>,
+                 args.data(), n, handles.data());
+  closure.release();
+
+  for (size_t i = 0; i < n; ++i) {
+    gs[i]._handle = std::move(handles[i]);
+  }
+  return gs;
+}
+
 void g::join() {
   if (branch_unexpected(!_handle)) {
     throw std::logic_error("no execution context to join");
@@ -33,6 +88,20 @@ void g::join() {
   sched::join(&_handle, nullptr);
 }
 
+void g::join_all(std::vector<g>& gs) {
+  std::vector<sched::handle> handles;
+  handles.reserve(gs.size());
+  for (auto& x : gs) {
+    if (branch_unexpected(!x._handle)) {
+      throw std::logic_error("no execution context to join");
+    }
+  }
+  for (auto& x : gs) {
+    handles.push_back(std::move(x._handle));
+  }
+  sched::join_all(handles.data(), handles.size(), nullptr);
+}
+
 void g::detach() {
   if (!_handle) return;
   sched::detach(&_handle);
@@ -40,6 +109,10 @@ void g::detach() {
 
 void self::yield() { sched::yield(); }
 
+void self::set_nice(int nice) { sched::set_nice(nice); }
+
+int self::nice() { return sched::get_nice(); }
+
 template <class Rep, class Period>
 void self::sleep_for(const std::chrono::duration<Rep, Period>& sleep_duration) {
   sched::sleep_for(sleep_duration);
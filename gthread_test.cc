@@ -22,6 +22,18 @@ TEST(gthread, g_join) {
   }).join();
 }
 
+TEST(gthread, g_spawn_many) {
+  constexpr size_t k_n = 100;
+  std::atomic<size_t> index_sum{0};
+  auto gs = gthread::g::spawn_many(
+      k_n, [&index_sum](size_t i) { index_sum.fetch_add(i); });
+  ASSERT_EQ(gs.size(), k_n);
+
+  gthread::g::join_all(gs);
+  EXPECT_EQ(index_sum.load(), k_n * (k_n - 1) / 2);
+  for (auto& x : gs) EXPECT_FALSE(x);
+}
+
 TEST(gthread, g_detach) {
   int i = 0;
   std::atomic<bool> done = false;
@@ -0,0 +1,279 @@
+#include "io/buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <sys/mman.h>
+
+#include "sched/preempt.h"
+#include "sched/sched.h"
+#include "util/compiler.h"
+#include "util/log.h"
+
+namespace gthread {
+namespace io {
+namespace {
+constexpr size_t k_region_buffers = 64;
+constexpr size_t k_node_cache = 256;
+
+// the most regions told apart (e.g. as io_uring fixed buffers). the rest are
+// all marked `k_max_regions`.
+constexpr unsigned k_max_regions = 1024;
+
+/**
+ * the free buffers a node keeps for itself
+ */
+struct cache {
+  buffer* free = nullptr;
+  size_t count = 0;
+};
+
+std::atomic<cache*> g_caches[sched::k_max_concurrency];
+
+std::mutex g_depot_mu;
+buffer* g_depot = nullptr;
+unsigned g_regions = 0;
+iovec g_region_iovs[k_max_regions];
+}  // namespace
+
+/**
+ * the buffers, carved from regions of `k_region_buffers` that are mapped as
+ * they are needed and never unmapped. each node caches free buffers of its
+ * own, which its tasks take and give without locking since they do so where
+ * they can't be preempted. a node with too many free gives half of them to a
+ * depot shared by all, which a node with none takes from.
+ */
+class buffer_pool {
+ public:
+  static buffer* take();
+  static void give(buffer* b);
+  static unsigned region(const buffer& b, iovec* region);
+
+ private:
+  /**
+   * the current node's cache. must hold the `preempt_mutex`.
+   */
+  static cache& node_cache();
+
+  /**
+   * moves up to |n| buffers from the depot to |c|, mapping a new region if
+   * the depot is empty
+   */
+  static void refill(cache& c, size_t n);
+
+  /**
+   * puts |b| in the depot. must hold `g_depot_mu`.
+   */
+  static void deposit(buffer* b) {
+    b->_next = g_depot;
+    g_depot = b;
+  }
+};
+
+cache& buffer_pool::node_cache() {
+  auto& slot = g_caches[preempt_mutex::get().node().index()];
+  auto* c = slot.load(std::memory_order_acquire);
+  if (branch_unexpected(c == nullptr)) {
+    // only ever set by the node's own tasks
+    c = new cache();
+    slot.store(c, std::memory_order_release);
+  }
+  return *c;
+}
+
+void buffer_pool::refill(cache& c, size_t n) {
+  std::lock_guard<std::mutex> l(g_depot_mu);
+  if (g_depot == nullptr) {
+    auto size = k_region_buffers * k_buffer_capacity;
+    auto* base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (branch_unexpected(base == MAP_FAILED)) {
+      gthread_log_fatal("could not map a region of I/O buffers");
+    }
+    auto region = g_regions < k_max_regions ? g_regions : k_max_regions;
+    if (region < k_max_regions) g_region_iovs[region] = {base, size};
+    ++g_regions;
+
+    auto* headers = new buffer[k_region_buffers];
+    for (size_t i = 0; i < k_region_buffers; ++i) {
+      headers[i]._storage = static_cast<char*>(base) + i * k_buffer_capacity;
+      headers[i]._region = region;
+      deposit(&headers[i]);
+    }
+  }
+
+  for (size_t i = 0; i < n && g_depot != nullptr; ++i) {
+    auto* b = g_depot;
+    g_depot = b->_next;
+    b->_next = c.free;
+    c.free = b;
+    ++c.count;
+  }
+}
+
+buffer* buffer_pool::take() {
+  buffer* b;
+  if (sched_node::current() == nullptr) {
+    // a thread hosting no node goes straight to the depot
+    cache local;
+    refill(local, 1);
+    b = local.free;
+  } else {
+    std::lock_guard<preempt_mutex> l(preempt_mutex::get());
+    auto& c = node_cache();
+    if (branch_unexpected(c.free == nullptr)) refill(c, k_node_cache / 2);
+    b = c.free;
+    c.free = b->_next;
+    --c.count;
+  }
+
+  b->_begin = b->_end = 0;
+  b->_next = nullptr;
+  return b;
+}
+
+void buffer_pool::give(buffer* b) {
+  if (sched_node::current() == nullptr) {
+    std::lock_guard<std::mutex> l(g_depot_mu);
+    deposit(b);
+    return;
+  }
+
+  std::lock_guard<preempt_mutex> l(preempt_mutex::get());
+  auto& c = node_cache();
+  b->_next = c.free;
+  c.free = b;
+  if (++c.count < k_node_cache) return;
+
+  // a node that gives back more than it takes hands the surplus on
+  std::lock_guard<std::mutex> dl(g_depot_mu);
+  while (c.count > k_node_cache / 2) {
+    auto* spare = c.free;
+    c.free = spare->_next;
+    --c.count;
+    deposit(spare);
+  }
+}
+
+unsigned buffer_pool::region(const buffer& b, iovec* region) {
+  *region = b._region < k_max_regions ? g_region_iovs[b._region]
+                                      : iovec{nullptr, 0};
+  return b._region;
+}
+
+buffer_chain::buffer_chain(buffer_chain&& other)
+    : _head(other._head), _tail(other._tail), _length(other._length) {
+  other._head = other._tail = nullptr;
+  other._length = 0;
+}
+
+buffer_chain& buffer_chain::operator=(buffer_chain&& other) {
+  if (this != &other) {
+    clear();
+    std::swap(_head, other._head);
+    std::swap(_tail, other._tail);
+    std::swap(_length, other._length);
+  }
+  return *this;
+}
+
+size_t buffer_chain::size() const {
+  size_t n = 0;
+  for (auto& b : *this) n += b.size();
+  return n;
+}
+
+size_t buffer_chain::room() const {
+  // the room in the last buffer holding data, and in every buffer after it
+  size_t n = 0;
+  for (auto& b : *this) n = b.size() > 0 ? b.room() : n + b.room();
+  return n;
+}
+
+buffer& buffer_chain::append() {
+  auto* b = buffer_pool::take();
+  if (_tail != nullptr) {
+    _tail->_next = b;
+  } else {
+    _head = b;
+  }
+  _tail = b;
+  ++_length;
+  return *b;
+}
+
+void buffer_chain::append(buffer_chain&& other) {
+  if (other._head == nullptr) return;
+  if (_tail != nullptr) {
+    _tail->_next = other._head;
+  } else {
+    _head = other._head;
+  }
+  _tail = other._tail;
+  _length += other._length;
+  other._head = other._tail = nullptr;
+  other._length = 0;
+}
+
+void buffer_chain::append(const void* data, size_t n) {
+  reserve(n);
+
+  // the room starts in the last buffer holding data
+  auto* b = _head;
+  for (auto* it = _head; it != nullptr; it = it->_next) {
+    if (it->size() > 0) b = it;
+  }
+  auto* from = static_cast<const char*>(data);
+  for (; n > 0; b = b->_next) {
+    auto m = std::min(n, b->room());
+    std::memcpy(b->tail(), from, m);
+    b->commit(m);
+    from += m;
+    n -= m;
+  }
+}
+
+void buffer_chain::reserve(size_t n) {
+  for (auto r = room(); r < n; r += k_buffer_capacity) append();
+}
+
+void buffer_chain::consume(size_t n) {
+  // empty buffers ahead of data (e.g. room left behind by a chain appended
+  // to) are given back along the way
+  while (_head != nullptr && n > 0) {
+    auto m = std::min(n, _head->size());
+    _head->consume(m);
+    n -= m;
+    if (_head->size() > 0) break;
+
+    // the last buffer is kept as room, all of it once it's empty
+    if (_head->_next == nullptr) {
+      _head->_begin = _head->_end = 0;
+      break;
+    }
+    auto* b = _head;
+    _head = b->_next;
+    --_length;
+    buffer_pool::give(b);
+  }
+}
+
+void buffer_chain::clear() {
+  while (_head != nullptr) {
+    auto* b = _head;
+    _head = b->_next;
+    buffer_pool::give(b);
+  }
+  _tail = nullptr;
+  _length = 0;
+}
+}  // namespace io
+
+namespace internal {
+unsigned buffer_region(const io::buffer& b, iovec* region) {
+  return io::buffer_pool::region(b, region);
+}
+}  // namespace internal
+}  // namespace gthread
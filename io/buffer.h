@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include <sys/uio.h>
+
+namespace gthread {
+namespace io {
+/**
+ * how many bytes each pooled buffer has room for
+ */
+constexpr size_t k_buffer_capacity = 16 << 10;
+
+/**
+ * a fixed-size buffer from a pool kept by each node, so that taking one and
+ * giving it back doesn't touch the heap once the pool has grown to what is
+ * in use. a buffer belongs to one `buffer_chain` at a time, which returns it
+ * to the pool of whatever node drops it.
+ *
+ * the data held is a span of its storage: bytes are written after the end
+ * (into `tail()`, and then `commit()`ed) and consumed from the front.
+ */
+class buffer {
+ public:
+  buffer(const buffer&) = delete;
+  buffer& operator=(const buffer&) = delete;
+
+  char* data() { return _storage + _begin; }
+  const char* data() const { return _storage + _begin; }
+  size_t size() const { return _end - _begin; }
+
+  /**
+   * where more data goes, and how much room there is for it
+   */
+  char* tail() { return _storage + _end; }
+  size_t room() const { return k_buffer_capacity - _end; }
+
+  /**
+   * appends the |n| bytes written to `tail()`. |n| mustn't exceed `room()`.
+   */
+  void commit(size_t n) { _end += static_cast<uint32_t>(n); }
+
+  /**
+   * drops the first |n| bytes. |n| mustn't exceed `size()`.
+   */
+  void consume(size_t n) { _begin += static_cast<uint32_t>(n); }
+
+  buffer* next() { return _next; }
+  const buffer* next() const { return _next; }
+
+ private:
+  friend class buffer_chain;
+  friend class buffer_pool;
+
+  buffer()
+      : _storage(nullptr), _begin(0), _end(0), _next(nullptr), _region(0) {}
+
+  char* _storage;
+  uint32_t _begin;
+  uint32_t _end;
+  buffer* _next;
+
+  // which of the pool's regions |_storage| is in
+  unsigned _region;
+};
+
+/**
+ * a sequence of pooled buffers holding a stream of bytes, e.g. a message
+ * being framed, which `io::readv()` reads into and `io::writev()` writes out
+ * of without copying it into one contiguous string. the room after the data
+ * is the rest of the last buffer holding any, and the empty buffers after it.
+ */
+class buffer_chain {
+ public:
+  template <typename Buffer>
+  class basic_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Buffer;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Buffer*;
+    using reference = Buffer&;
+
+    explicit basic_iterator(Buffer* b) : _b(b) {}
+    Buffer& operator*() const { return *_b; }
+    Buffer* operator->() const { return _b; }
+    basic_iterator& operator++() {
+      _b = _b->next();
+      return *this;
+    }
+    bool operator==(const basic_iterator& other) const {
+      return _b == other._b;
+    }
+    bool operator!=(const basic_iterator& other) const {
+      return _b != other._b;
+    }
+
+   private:
+    Buffer* _b;
+  };
+  using iterator = basic_iterator<buffer>;
+  using const_iterator = basic_iterator<const buffer>;
+
+  buffer_chain() : _head(nullptr), _tail(nullptr), _length(0) {}
+  buffer_chain(buffer_chain&& other);
+  buffer_chain& operator=(buffer_chain&& other);
+  ~buffer_chain() { clear(); }
+
+  buffer_chain(const buffer_chain&) = delete;
+  buffer_chain& operator=(const buffer_chain&) = delete;
+
+  iterator begin() { return iterator(_head); }
+  iterator end() { return iterator(nullptr); }
+  const_iterator begin() const { return const_iterator(_head); }
+  const_iterator end() const { return const_iterator(nullptr); }
+
+  /**
+   * the number of buffers, and of bytes held in them
+   */
+  size_t length() const { return _length; }
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  /**
+   * the room after the data, which `reserve()` makes more of
+   */
+  size_t room() const;
+
+  /**
+   * adds an empty buffer from the current node's pool at the end
+   */
+  buffer& append();
+
+  /**
+   * moves |other|'s buffers to the end, leaving it empty
+   */
+  void append(buffer_chain&& other);
+
+  /**
+   * copies |n| bytes from |data| to the end, adding buffers as needed
+   */
+  void append(const void* data, size_t n);
+
+  /**
+   * adds empty buffers until there is room for at least |n| more bytes
+   */
+  void reserve(size_t n);
+
+  /**
+   * drops the first |n| bytes (or all of them, if there are fewer), giving
+   * back the buffers that empties or passes empty except the last, which is
+   * kept as room
+   */
+  void consume(size_t n);
+
+  /**
+   * gives back every buffer
+   */
+  void clear();
+
+ private:
+  buffer* _head;
+  buffer* _tail;
+  size_t _length;
+};
+}  // namespace io
+
+namespace internal {
+/**
+ * the region of the buffer pool that |b| was carved from, which io_uring
+ * registers as one fixed buffer, and its index among them
+ */
+unsigned buffer_region(const io::buffer& b, iovec* region);
+}  // namespace internal
+}  // namespace gthread
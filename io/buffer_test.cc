@@ -0,0 +1,156 @@
+#include "io/buffer.h"
+
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "gthread.h"
+
+using namespace gthread;
+
+namespace {
+/**
+ * the bytes |chain| holds, in order
+ */
+std::string contents(const io::buffer_chain& chain) {
+  std::string s;
+  for (auto& b : chain) s.append(b.data(), b.size());
+  return s;
+}
+}  // namespace
+
+TEST(gthread_io_buffer, append_and_consume) {
+  io::buffer_chain chain;
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(chain.length(), 0u);
+  EXPECT_EQ(chain.room(), 0u);
+
+  chain.append("hello, ", 7);
+  chain.append("world", 5);
+  EXPECT_EQ(chain.length(), 1u);
+  EXPECT_EQ(chain.size(), 12u);
+  EXPECT_EQ(chain.room(), io::k_buffer_capacity - 12);
+  EXPECT_EQ(contents(chain), "hello, world");
+
+  chain.consume(7);
+  EXPECT_EQ(contents(chain), "world");
+
+  // the last buffer stays as room once everything is consumed
+  chain.consume(100);
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(chain.length(), 1u);
+  EXPECT_EQ(chain.room(), io::k_buffer_capacity);
+}
+
+TEST(gthread_io_buffer, spans_buffers) {
+  std::string data(io::k_buffer_capacity * 2 + 10, '\0');
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>(i % 251);
+  }
+
+  io::buffer_chain chain;
+  chain.append(data.data(), data.size());
+  EXPECT_EQ(chain.length(), 3u);
+  EXPECT_EQ(contents(chain), data);
+
+  // buffers that are emptied go back to the pool
+  chain.consume(io::k_buffer_capacity + 5);
+  EXPECT_EQ(chain.length(), 2u);
+  EXPECT_EQ(contents(chain), data.substr(io::k_buffer_capacity + 5));
+}
+
+TEST(gthread_io_buffer, consumes_past_empty_buffers) {
+  // [empty]["ab"], with the room a consumed chain keeps at the front
+  io::buffer_chain chain;
+  chain.append("x", 1);
+  chain.consume(1);
+  io::buffer_chain ab;
+  ab.append("ab", 2);
+  chain.append(std::move(ab));
+
+  // ["ab"][empty]["cd"], with room reserved in the middle
+  chain.reserve(io::k_buffer_capacity);
+  io::buffer_chain cd;
+  cd.append("cd", 2);
+  chain.append(std::move(cd));
+  EXPECT_EQ(chain.length(), 4u);
+  EXPECT_EQ(contents(chain), "abcd");
+
+  chain.consume(1);
+  EXPECT_EQ(contents(chain), "bcd");
+  EXPECT_EQ(chain.length(), 3u);
+  chain.consume(2);
+  EXPECT_EQ(contents(chain), "d");
+  EXPECT_EQ(chain.length(), 1u);
+  chain.consume(1);
+  EXPECT_TRUE(chain.empty());
+}
+
+TEST(gthread_io_buffer, reserve_and_commit) {
+  io::buffer_chain chain;
+  chain.append("x", 1);
+  chain.reserve(io::k_buffer_capacity * 2);
+  EXPECT_EQ(chain.length(), 3u);
+  EXPECT_GE(chain.room(), io::k_buffer_capacity * 2);
+
+  // the room starts after the data
+  auto& first = *chain.begin();
+  std::memcpy(first.tail(), "yz", 2);
+  first.commit(2);
+  EXPECT_EQ(contents(chain), "xyz");
+  EXPECT_EQ(chain.room(), io::k_buffer_capacity * 3 - 3);
+}
+
+TEST(gthread_io_buffer, moves) {
+  io::buffer_chain a;
+  a.append("abc", 3);
+  io::buffer_chain b(std::move(a));
+  EXPECT_EQ(a.length(), 0u);
+  EXPECT_EQ(contents(b), "abc");
+
+  io::buffer_chain c;
+  c.append("def", 3);
+  c = std::move(b);
+  EXPECT_EQ(contents(c), "abc");
+
+  io::buffer_chain d;
+  d.append("xyz", 3);
+  c.append(std::move(d));
+  EXPECT_EQ(d.length(), 0u);
+  EXPECT_EQ(c.length(), 2u);
+  EXPECT_EQ(contents(c), "abcxyz");
+}
+
+TEST(gthread_io_buffer, reuses_buffers) {
+  // a buffer given back is the next one taken on the same node, unless the
+  // task was moved to another node in between
+  g task([]() {
+    const io::buffer* first;
+    auto* node = sched_node::current();
+    {
+      io::buffer_chain chain;
+      first = &chain.append();
+    }
+    io::buffer_chain chain;
+    auto* again = &chain.append();
+    if (sched_node::current() == node) {
+      EXPECT_EQ(again, first);
+    }
+  });
+  task.join();
+}
+
+TEST(gthread_io_buffer, many_tasks) {
+  auto tasks = g::spawn_many(64, [](size_t i) {
+    std::string data(io::k_buffer_capacity + i,
+                     static_cast<char>('a' + i % 26));
+    for (int round = 0; round < 16; ++round) {
+      io::buffer_chain chain;
+      chain.append(data.data(), data.size());
+      sched::yield();
+      EXPECT_EQ(contents(chain), data);
+    }
+  });
+  for (auto& t : tasks) t.join();
+}
@@ -0,0 +1,182 @@
+#include "io/internal/epoll_reactor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "sched/trace.h"
+#include "util/compiler.h"
+#include "util/log.h"
+
+namespace gthread {
+namespace internal {
+namespace {
+// the events that end a wait in either direction
+constexpr uint32_t k_read_events = EPOLLIN | EPOLLHUP | EPOLLERR;
+constexpr uint32_t k_write_events = EPOLLOUT | EPOLLHUP | EPOLLERR;
+
+// cleared once the kernel turns out to predate `epoll_pwait2()`, after which
+// timeouts are rounded up to whole milliseconds
+std::atomic<bool> g_have_pwait2{true};
+
+/**
+ * `epoll_wait()` with a nanosecond |timeout| (a negative one waits
+ * indefinitely)
+ */
+int wait(int epoll_fd, epoll_event* events, int max_events,
+         std::chrono::nanoseconds timeout) {
+#ifdef SYS_epoll_pwait2
+  if (g_have_pwait2.load(std::memory_order_relaxed)) {
+    timespec ts;
+    timespec* tsp = nullptr;
+    if (timeout >= std::chrono::nanoseconds::zero()) {
+      auto s = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+      ts.tv_sec = static_cast<time_t>(s.count());
+      ts.tv_nsec = static_cast<long>((timeout - s).count());
+      tsp = &ts;
+    }
+    auto n = static_cast<int>(syscall(SYS_epoll_pwait2, epoll_fd, events,
+                                      max_events, tsp, nullptr, 0));
+    if (n >= 0 || errno != ENOSYS) return n;
+    g_have_pwait2.store(false, std::memory_order_relaxed);
+  }
+#endif
+
+  int ms = -1;
+  if (timeout >= std::chrono::nanoseconds::zero()) {
+    auto rounded = std::chrono::ceil<std::chrono::milliseconds>(timeout);
+    ms = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+        rounded.count(), INT_MAX));
+  }
+  return epoll_wait(epoll_fd, events, max_events, ms);
+}
+}  // namespace
+
+epoll_reactor* epoll_reactor::get(sched_node& node) {
+  if (auto* p = node.get_poller()) return static_cast<epoll_reactor*>(p);
+
+  auto* r = new epoll_reactor(&node);
+  if (r->init() != 0) {
+    delete r;
+    return nullptr;
+  }
+  node.set_poller(r);
+  return r;
+}
+
+epoll_reactor::epoll_reactor(sched_node* node)
+    : _node(node), _epoll_fd(-1), _wake_fd(-1), _fds(), _parked(0) {}
+
+epoll_reactor::~epoll_reactor() {
+  if (_wake_fd >= 0) close(_wake_fd);
+  if (_epoll_fd >= 0) close(_epoll_fd);
+}
+
+int epoll_reactor::init() {
+  _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll_fd < 0) return errno;
+  _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (_wake_fd < 0) return errno;
+
+  // unlike the fds tasks wait on, this stays armed
+  epoll_event e{};
+  e.events = EPOLLIN;
+  e.data.fd = _wake_fd;
+  return epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &e) < 0 ? errno : 0;
+}
+
+int epoll_reactor::arm(int fd, const waiters& w) {
+  epoll_event e{};
+  e.events = EPOLLONESHOT;
+  if (!w.readers.empty()) e.events |= EPOLLIN;
+  if (!w.writers.empty()) e.events |= EPOLLOUT;
+  e.data.fd = fd;
+
+  // an fd seen before is usually still registered, though disarmed. if it
+  // was closed since, the kernel has forgotten it (and its number may now
+  // belong to another file).
+  if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &e) == 0) return 0;
+  if (errno != ENOENT) return errno;
+  return epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &e) < 0 ? errno : 0;
+}
+
+int epoll_reactor::park(int fd, uint32_t events) {
+  auto* current = task::current();
+  auto& w = _fds[fd];
+  auto& v = (events & EPOLLOUT) ? w.writers : w.readers;
+  v.push_back(current);
+  if (auto err = arm(fd, w)) {
+    v.pop_back();
+    return err;
+  }
+
+  ++_parked;
+  current->run_state = task::WAITING;
+  gthread_trace(*_node, park, current, nullptr);
+  _node->yield();
+  return 0;
+}
+
+void epoll_reactor::poll() {
+  // a node with no one waiting has nothing to look for, and `wait_for()`
+  // picks up any `interrupt()`
+  if (_parked == 0) return;
+  dispatch(wait(_epoll_fd, _events, k_max_events,
+                std::chrono::nanoseconds::zero()));
+}
+
+void epoll_reactor::wait_for(std::chrono::nanoseconds timeout) {
+  dispatch(wait(_epoll_fd, _events, k_max_events, timeout));
+}
+
+void epoll_reactor::dispatch(int n) {
+  auto unpark = [this](std::vector<task*>& v) {
+    for (auto* t : v) {
+      t->run_state = task::SUSPENDED;
+      gthread_trace(*_node, unpark, task::current(), t);
+      t->node->schedule(t);
+    }
+    _parked -= static_cast<unsigned>(v.size());
+    v.clear();
+  };
+
+  for (int i = 0; i < n; ++i) {
+    auto fd = _events[i].data.fd;
+    auto events = _events[i].events;
+    if (fd == _wake_fd) {
+      uint64_t count;
+      while (read(_wake_fd, &count, sizeof(count)) > 0) {
+      }
+      continue;
+    }
+
+    auto it = _fds.find(fd);
+    if (it == _fds.end()) continue;
+    auto& w = it->second;
+    if (events & k_read_events) unpark(w.readers);
+    if (events & k_write_events) unpark(w.writers);
+
+    // the rest wait for what didn't happen. if the fd can't be armed again
+    // (e.g. it was closed), they are woken to find out for themselves.
+    if ((!w.readers.empty() || !w.writers.empty()) && arm(fd, w) != 0) {
+      unpark(w.readers);
+      unpark(w.writers);
+    }
+  }
+}
+
+void epoll_reactor::interrupt() {
+  uint64_t one = 1;
+  if (branch_unexpected(write(_wake_fd, &one, sizeof(one)) < 0 &&
+                        errno != EAGAIN)) {
+    gthread_log_fatal("could not signal a node's epoll instance");
+  }
+}
+}  // namespace internal
+}  // namespace gthread
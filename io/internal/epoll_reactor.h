@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "sched/poller.h"
+#include "sched/sched_node.h"
+#include "sched/task.h"
+
+namespace gthread {
+namespace internal {
+/**
+ * a node's epoll instance, which its tasks park on until an fd is ready, like
+ * Go's netpoller. the node collects the readiness events in batches when it
+ * picks its next task, and waits in `epoll_wait()` (with its next timer as the
+ * timeout) when it runs out of work (see `poller`).
+ *
+ * an fd is armed one-shot for as long as tasks here wait on it, so nothing
+ * has to be unregistered when it is closed. closing an fd that a task is
+ * waiting on leaves the task waiting, since the kernel drops the fd from the
+ * epoll instance without an event.
+ */
+class epoll_reactor final : public poller {
+ public:
+  /**
+   * the reactor of |node|, set up on first use, or nullptr if it can't be.
+   * must be called on |node|'s kernel-managed thread, holding the
+   * `preempt_mutex`.
+   */
+  static epoll_reactor* get(sched_node& node);
+
+  /**
+   * parks the current task until |fd| is ready for |events| (`EPOLLIN` or
+   * `EPOLLOUT`), or has hung up or failed. returns 0, or an errno value if
+   * |fd| can't be waited on (e.g. `EPERM` for a regular file, which is always
+   * ready). must hold the `preempt_mutex`, which is still held when it
+   * returns, though perhaps on another node.
+   */
+  int park(int fd, uint32_t events);
+
+  void poll() override;
+  void wait_for(std::chrono::nanoseconds timeout) override;
+  void interrupt() override;
+
+ private:
+  explicit epoll_reactor(sched_node* node);
+  ~epoll_reactor();
+
+  /**
+   * sets up the epoll instance and the eventfd that `interrupt()` signals.
+   * returns 0 or an errno value.
+   */
+  int init();
+
+  /**
+   * the tasks waiting on an fd, by direction
+   */
+  struct waiters {
+    std::vector<task*> readers;
+    std::vector<task*> writers;
+  };
+
+  /**
+   * arms |fd| for what its |w| are waiting on. returns 0 or an errno value.
+   */
+  int arm(int fd, const waiters& w);
+
+  /**
+   * schedules the tasks that the |n| events in `_events` are ready for
+   */
+  void dispatch(int n);
+
+  static constexpr int k_max_events = 128;
+
+  sched_node* _node;
+  int _epoll_fd;
+  int _wake_fd;
+
+  // only touched on the node's kernel-managed thread. entries are kept once
+  // made so their vectors' storage is reused.
+  std::unordered_map<int, waiters> _fds;
+  unsigned _parked;
+
+  epoll_event _events[k_max_events];
+};
+}  // namespace internal
+}  // namespace gthread
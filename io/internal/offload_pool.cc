@@ -0,0 +1,133 @@
+#include "io/internal/offload_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <thread>
+
+#include "sched/preempt.h"
+#include "sched/sched.h"
+#include "util/compiler.h"
+
+namespace gthread {
+namespace internal {
+offload_pool& offload_pool::get() {
+  // never destroyed, since its threads never stop
+  static auto* pool = new offload_pool();
+  return *pool;
+}
+
+offload_pool::offload_pool()
+    : _mu(), _ready_cv(), _ready(), _devices(), _threads(0), _idle_threads(0) {}
+
+void offload_pool::run(offload_op* op) {
+  // the op is only handed over once the task is committed to parking, so the
+  // worker finds it parked (or about to be) when the call returns. `_mu` is
+  // taken where the task can't be preempted, or another task on its node
+  // could wait on it forever.
+  op->w.park_if([this, op]() {
+    std::lock_guard<preempt_mutex> l(preempt_mutex::get());
+    submit(op);
+    return true;
+  });
+}
+
+void offload_pool::set_queue_depth(dev_t dev, unsigned depth) {
+  if (branch_unexpected(depth == 0)) {
+    throw std::domain_error("|depth| must be at least 1");
+  }
+
+  std::lock_guard<std::mutex> l(_mu);
+  auto& d = device_for(dev);
+  d.depth = depth;
+
+  // a deeper queue lets more of what is queued go now
+  while (d.in_flight < d.depth && !d.queued.empty()) {
+    _ready.push_back(d.queued.front());
+    d.queued.pop_front();
+    ++d.in_flight;
+  }
+  _ready_cv.notify_all();
+}
+
+offload_pool::device& offload_pool::device_for(dev_t dev) {
+  auto it = _devices.find(dev);
+  if (it == _devices.end()) {
+    it = _devices.emplace(dev, device{k_default_queue_depth, 0, {}}).first;
+  }
+  return it->second;
+}
+
+void offload_pool::submit(offload_op* op) {
+  bool start = false;
+  {
+    std::lock_guard<std::mutex> l(_mu);
+    auto& d = device_for(op->dev);
+    if (d.in_flight >= d.depth) {
+      d.queued.push_back(op);
+      return;
+    }
+    ++d.in_flight;
+    _ready.push_back(op);
+
+    if (_idle_threads > 0) {
+      _ready_cv.notify_one();
+    } else if (_threads < k_max_threads) {
+      ++_threads;
+      start = true;
+    }
+  }
+  if (start) sched::start_thread([this]() { work(); });
+}
+
+void offload_pool::work() {
+  offload_op* batch[k_max_batch];
+  std::unique_lock<std::mutex> l(_mu);
+  while (true) {
+    while (_ready.empty()) {
+      ++_idle_threads;
+      _ready_cv.wait(l);
+      --_idle_threads;
+    }
+
+    // the calls ready are shared out among the idle workers, so a batch
+    // doesn't make calls in turn that others could be making at once
+    size_t n = std::min<size_t>(
+        (_ready.size() + _idle_threads) / (_idle_threads + 1), k_max_batch);
+    for (size_t i = 0; i < n; ++i) {
+      batch[i] = _ready.front();
+      _ready.pop_front();
+    }
+    l.unlock();
+
+    for (size_t i = 0; i < n; ++i) {
+      auto* op = batch[i];
+      op->result = op->fn(op->arg);
+      op->error = op->result < 0 ? errno : 0;
+    }
+
+    l.lock();
+    bool queued = false;
+    for (size_t i = 0; i < n; ++i) {
+      auto& d = device_for(batch[i]->dev);
+      if (d.queued.empty() || d.in_flight > d.depth) {
+        --d.in_flight;
+      } else {
+        _ready.push_back(d.queued.front());
+        d.queued.pop_front();
+        queued = true;
+      }
+    }
+    if (queued) _ready_cv.notify_all();
+    l.unlock();
+
+    // a task is only unparked once it has finished parking
+    for (size_t i = 0; i < n; ++i) {
+      while (!batch[i]->w.unpark()) std::this_thread::yield();
+    }
+
+    l.lock();
+  }
+}
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "concur/internal/waiter.h"
+
+namespace gthread {
+namespace internal {
+/**
+ * a call that a task hands to the `offload_pool`
+ */
+struct offload_op {
+  // makes the call with |arg|, returning what it does
+  int64_t (*fn)(const void* arg);
+  const void* arg;
+
+  // the device the call is queued for
+  dev_t dev;
+
+  // what the call returned, and its `errno` if that was negative
+  int64_t result;
+  int error;
+
+  waiter w;
+};
+
+/**
+ * a small pool of kernel-managed threads that hosts no nodes and makes calls
+ * that would block a node on a slow disk (e.g. `pread()` or `fsync()` on a
+ * regular file, which epoll can't wait for). the calling task parks on its
+ * op's `waiter` and is unparked into its node's runqueue when the call
+ * returns.
+ *
+ * each device gets at most its queue depth of calls in flight, so a slow one
+ * can't hold up the calls to the others. the rest queue up in order. a worker
+ * takes the calls that are ready in batches and unparks their tasks together,
+ * which the nodes' inboxes collect so that each node is woken once a batch.
+ */
+class offload_pool {
+ public:
+  /**
+   * the most kernel-managed threads the pool starts, which it does as calls
+   * come in
+   */
+  static constexpr unsigned k_max_threads = 16;
+
+  /**
+   * the most calls a worker takes at once
+   */
+  static constexpr unsigned k_max_batch = 8;
+
+  /**
+   * the queue depth of a device that wasn't given one
+   */
+  static constexpr unsigned k_default_queue_depth = 4;
+
+  static offload_pool& get();
+
+  /**
+   * makes |op|'s call on a worker, parking the current task until it returns.
+   * must be called from a task.
+   */
+  void run(offload_op* op);
+
+  /**
+   * sets how many calls to |dev| may be in flight at once. throws
+   * `std::domain_error` if |depth| is 0.
+   */
+  void set_queue_depth(dev_t dev, unsigned depth);
+
+ private:
+  offload_pool();
+
+  struct device {
+    unsigned depth;
+    unsigned in_flight;
+    std::deque<offload_op*> queued;
+  };
+
+  /**
+   * the queue |dev| is tracked in, which is set up with the default depth.
+   * must hold `_mu`.
+   */
+  device& device_for(dev_t dev);
+
+  /**
+   * queues |op| to be made by a worker, starting one if none is free
+   */
+  void submit(offload_op* op);
+
+  /**
+   * runs on each of the pool's threads
+   */
+  void work();
+
+  // guards the rest
+  std::mutex _mu;
+  std::condition_variable _ready_cv;
+
+  // calls that may be made now, in the order they were queued
+  std::deque<offload_op*> _ready;
+  std::unordered_map<dev_t, device> _devices;
+
+  unsigned _threads;
+  unsigned _idle_threads;
+};
+}  // namespace internal
+}  // namespace gthread
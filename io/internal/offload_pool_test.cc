@@ -0,0 +1,77 @@
+#include "io/internal/offload_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gthread.h"
+
+using namespace gthread;
+using namespace gthread::internal;
+
+namespace {
+std::atomic<int> g_in_flight{0};
+std::atomic<int> g_most_in_flight{0};
+
+/**
+ * takes a while, like a read from a slow disk, and notes how many calls were
+ * in flight along with it
+ */
+int64_t slow_call(const void* arg) {
+  auto n = g_in_flight.fetch_add(1) + 1;
+  auto most = g_most_in_flight.load();
+  while (n > most && !g_most_in_flight.compare_exchange_weak(most, n)) {
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds{2});
+  g_in_flight.fetch_sub(1);
+  return *static_cast<const int*>(arg);
+}
+}  // namespace
+
+TEST(gthread_offload_pool, returns_each_result_to_its_task) {
+  constexpr int k_tasks = 32;
+  std::vector<int64_t> results(k_tasks, -1);
+  auto tasks = g::spawn_many(k_tasks, [&](size_t i) {
+    int value = static_cast<int>(i);
+    offload_op op{slow_call, &value, 1, 0, 0, {}};
+    offload_pool::get().run(&op);
+    results[i] = op.result;
+  });
+  for (auto& t : tasks) t.join();
+
+  for (int i = 0; i < k_tasks; ++i) EXPECT_EQ(results[i], i);
+}
+
+TEST(gthread_offload_pool, keeps_to_each_devices_queue_depth) {
+  offload_pool::get().set_queue_depth(2, 2);
+  g_most_in_flight.store(0);
+
+  auto tasks = g::spawn_many(16, [](size_t) {
+    int value = 0;
+    offload_op op{slow_call, &value, 2, 0, 0, {}};
+    offload_pool::get().run(&op);
+    EXPECT_EQ(op.result, 0);
+  });
+  for (auto& t : tasks) t.join();
+
+  EXPECT_EQ(g_most_in_flight.load(), 2);
+}
+
+TEST(gthread_offload_pool, reports_errno) {
+  int value = -1;
+  offload_op op{[](const void* arg) -> int64_t {
+                  errno = EIO;
+                  return *static_cast<const int*>(arg);
+                },
+                &value, 3, 0, 0, {}};
+  offload_pool::get().run(&op);
+  EXPECT_EQ(op.result, -1);
+  EXPECT_EQ(op.error, EIO);
+}
+
+TEST(gthread_offload_pool, queue_depth_must_be_positive) {
+  EXPECT_THROW(offload_pool::get().set_queue_depth(4, 0), std::domain_error);
+}
@@ -0,0 +1,162 @@
+#include "io/internal/uring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util/compiler.h"
+
+namespace gthread {
+namespace internal {
+static_assert(sizeof(std::atomic<unsigned>) == sizeof(unsigned) &&
+                  alignof(std::atomic<unsigned>) == alignof(unsigned),
+              "the rings' indices are shared with the kernel as plain words");
+
+namespace {
+template <typename T>
+T* at(void* base, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+}  // namespace
+
+uring::~uring() {
+  if (_sqes != nullptr) munmap(_sqes, _sqes_size);
+  if (_cq_map != nullptr && _cq_map != _sq_map) munmap(_cq_map, _cq_map_size);
+  if (_sq_map != nullptr) munmap(_sq_map, _sq_map_size);
+  if (_fd >= 0) close(_fd);
+}
+
+int uring::init(unsigned entries) {
+  io_uring_params p;
+  std::memset(&p, 0, sizeof(p));
+  _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+  if (_fd < 0) return errno;
+
+  // waiting with a timeout (`IORING_ENTER_EXT_ARG`) came last of what is used
+  // here, so it stands in for the rest (e.g. `IORING_OP_SEND`)
+  if (branch_unexpected(!(p.features & IORING_FEAT_EXT_ARG))) return ENOSYS;
+
+  _sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  _cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  bool single_map = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_map) {
+    _sq_map_size = _cq_map_size = std::max(_sq_map_size, _cq_map_size);
+  }
+
+  _sq_map = mmap(nullptr, _sq_map_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+  if (_sq_map == MAP_FAILED) {
+    _sq_map = nullptr;
+    return errno;
+  }
+  if (single_map) {
+    _cq_map = _sq_map;
+  } else {
+    _cq_map = mmap(nullptr, _cq_map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+    if (_cq_map == MAP_FAILED) {
+      _cq_map = nullptr;
+      return errno;
+    }
+  }
+  _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+  auto* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) return errno;
+  _sqes = static_cast<io_uring_sqe*>(sqes);
+
+  _sq_head = at<std::atomic<unsigned>>(_sq_map, p.sq_off.head);
+  _sq_tail = at<std::atomic<unsigned>>(_sq_map, p.sq_off.tail);
+  _sq_mask = *at<unsigned>(_sq_map, p.sq_off.ring_mask);
+  _sq_entries = p.sq_entries;
+  _sq_array = at<unsigned>(_sq_map, p.sq_off.array);
+  _cq_head = at<std::atomic<unsigned>>(_cq_map, p.cq_off.head);
+  _cq_tail = at<std::atomic<unsigned>>(_cq_map, p.cq_off.tail);
+  _cq_mask = *at<unsigned>(_cq_map, p.cq_off.ring_mask);
+  _cqes = at<io_uring_cqe>(_cq_map, p.cq_off.cqes);
+
+  _sq_local_tail = _sq_submitted = _sq_tail->load(std::memory_order_relaxed);
+  return 0;
+}
+
+io_uring_sqe* uring::get_sqe() {
+  if (_sq_local_tail - _sq_head->load(std::memory_order_acquire) >=
+      _sq_entries) {
+    return nullptr;
+  }
+
+  auto index = _sq_local_tail & _sq_mask;
+  ++_sq_local_tail;
+  _sq_array[index] = index;
+  auto* sqe = &_sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+int uring::submit() {
+  auto n = unsubmitted();
+  if (n == 0) return 0;
+  return enter(n, 0, 0, nullptr, 0);
+}
+
+void uring::wait_for(std::chrono::nanoseconds timeout) {
+  __kernel_timespec ts;
+  io_uring_getevents_arg arg;
+  std::memset(&arg, 0, sizeof(arg));
+  if (timeout >= std::chrono::nanoseconds::zero()) {
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    ts.tv_sec = secs.count();
+    ts.tv_nsec = (timeout - secs).count();
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+
+  // a signal (like the preemption alarm) ends the wait early, which callers
+  // handle by looking again
+  enter(unsubmitted(), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+        sizeof(arg));
+}
+
+int uring::register_buffers(unsigned n) {
+  // empty slots are allowed in a table registered this way
+  std::vector<iovec> empty(n, iovec{nullptr, 0});
+  io_uring_rsrc_register r;
+  std::memset(&r, 0, sizeof(r));
+  r.nr = n;
+  r.data = reinterpret_cast<uint64_t>(empty.data());
+  auto res = syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS2, &r,
+                     sizeof(r));
+  return res < 0 ? errno : 0;
+}
+
+int uring::update_buffer(unsigned index, const iovec& iov) {
+  io_uring_rsrc_update2 u;
+  std::memset(&u, 0, sizeof(u));
+  u.offset = index;
+  u.data = reinterpret_cast<uint64_t>(&iov);
+  u.nr = 1;
+  auto res = syscall(__NR_io_uring_register, _fd,
+                     IORING_REGISTER_BUFFERS_UPDATE, &u, sizeof(u));
+  return res < 0 ? errno : 0;
+}
+
+int uring::enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+                 const void* arg, size_t arg_size) {
+  // the entries are published before the kernel is told to look at them
+  if (to_submit > 0) _sq_tail->store(_sq_local_tail, std::memory_order_release);
+
+  auto r = syscall(__NR_io_uring_enter, _fd, to_submit, min_complete, flags,
+                   arg, arg_size);
+  if (r < 0) return -errno;
+
+  // the kernel consumes every entry it was handed, unless it ran short of
+  // memory, in which case the rest are handed over again next time
+  _sq_submitted += static_cast<unsigned>(r);
+  return static_cast<int>(r);
+}
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace gthread {
+namespace internal {
+/**
+ * an io_uring instance, set up and driven through the raw system calls. its
+ * submission queue is filled and its completion queue drained by one thread
+ * (though that thread may change, with the rings handed over safely).
+ */
+class uring {
+ public:
+  uring() = default;
+  ~uring();
+
+  uring(const uring&) = delete;
+  uring& operator=(const uring&) = delete;
+
+  /**
+   * sets up a ring with room for |entries| submissions. returns 0, or an
+   * errno value if the kernel doesn't support io_uring (or forbids it) or
+   * lacks the features this relies on.
+   */
+  int init(unsigned entries);
+
+  /**
+   * a zeroed submission queue entry to fill in, or nullptr if the queue is
+   * full. it goes to the kernel on the next `submit()` or `wait_for()`.
+   */
+  io_uring_sqe* get_sqe();
+
+  /**
+   * hands the entries gotten since the last call to the kernel. returns the
+   * number it took, or a negative errno value.
+   */
+  int submit();
+
+  /**
+   * submits like `submit()` and then blocks until a completion is ready or
+   * |timeout| passes (a negative |timeout| waits indefinitely). a signal may
+   * end the wait early.
+   */
+  void wait_for(std::chrono::nanoseconds timeout);
+
+  /**
+   * calls |f| with each completion that is ready, then frees their slots.
+   * returns how many there were.
+   */
+  template <typename F>
+  unsigned reap(F&& f);
+
+  /**
+   * the number of entries gotten and not yet submitted
+   */
+  unsigned unsubmitted() const { return _sq_local_tail - _sq_submitted; }
+
+  int fd() const { return _fd; }
+
+  /**
+   * sets up a table of |n| fixed buffers, all empty, for
+   * `IORING_OP_READ_FIXED` and `IORING_OP_WRITE_FIXED` to name by index.
+   * returns 0 or an errno value (e.g. `EINVAL` on a kernel that predates
+   * updating the table in place).
+   */
+  int register_buffers(unsigned n);
+
+  /**
+   * puts |iov| in slot |index| of the fixed buffer table, pinning its pages.
+   * returns 0 or an errno value.
+   */
+  int update_buffer(unsigned index, const iovec& iov);
+
+ private:
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+            const void* arg, size_t arg_size);
+
+  int _fd = -1;
+
+  void* _sq_map = nullptr;
+  size_t _sq_map_size = 0;
+  void* _cq_map = nullptr;
+  size_t _cq_map_size = 0;
+  io_uring_sqe* _sqes = nullptr;
+  size_t _sqes_size = 0;
+
+  // the kernel's view of the rings, through the shared mappings
+  std::atomic<unsigned>* _sq_head = nullptr;
+  std::atomic<unsigned>* _sq_tail = nullptr;
+  unsigned _sq_mask = 0;
+  unsigned _sq_entries = 0;
+  unsigned* _sq_array = nullptr;
+  std::atomic<unsigned>* _cq_head = nullptr;
+  std::atomic<unsigned>* _cq_tail = nullptr;
+  unsigned _cq_mask = 0;
+  io_uring_cqe* _cqes = nullptr;
+
+  // entries are published to the kernel in batches
+  unsigned _sq_local_tail = 0;
+  unsigned _sq_submitted = 0;
+};
+
+/**
+ * fills in |sqe| for the common shape of operation, like liburing's
+ * `io_uring_prep_rw()`
+ */
+inline void prep_rw(io_uring_sqe* sqe, uint8_t opcode, int fd,
+                    const void* addr, uint32_t len, uint64_t off) {
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(addr);
+  sqe->len = len;
+  sqe->off = off;
+}
+}  // namespace internal
+}  // namespace gthread
+
+#include "io/internal/uring_impl.h"
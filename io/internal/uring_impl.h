@@ -0,0 +1,18 @@
+#pragma once
+
+#include "io/internal/uring.h"
+
+namespace gthread {
+namespace internal {
+template <typename F>
+unsigned uring::reap(F&& f) {
+  auto head = _cq_head->load(std::memory_order_relaxed);
+  auto tail = _cq_tail->load(std::memory_order_acquire);
+  for (auto i = head; i != tail; ++i) f(_cqes[i & _cq_mask]);
+
+  // the slots go back to the kernel only after |f| is done with them
+  _cq_head->store(tail, std::memory_order_release);
+  return tail - head;
+}
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,159 @@
+#include "io/internal/uring_reactor.h"
+
+#include <atomic>
+#include <cerrno>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "sched/trace.h"
+#include "util/compiler.h"
+#include "util/log.h"
+
+namespace gthread {
+namespace internal {
+namespace {
+// the errno value the kernel refused to set up a ring with for good (it
+// predates the features used or a seccomp policy forbids io_uring), so it
+// isn't asked again on each node
+std::atomic<int> g_refusal{0};
+
+bool refuses_for_good(int err) {
+  return err == ENOSYS || err == EPERM || err == EACCES || err == EINVAL;
+}
+
+// marks the poll on the wake eventfd, which no task waits on
+constexpr uint64_t k_wake_data = 0;
+}  // namespace
+
+uring_reactor* uring_reactor::get(sched_node& node) {
+  if (auto* p = node.get_poller()) return static_cast<uring_reactor*>(p);
+  if (g_refusal.load(std::memory_order_relaxed) != 0) return nullptr;
+
+  auto* r = new uring_reactor(&node);
+  if (auto err = r->init()) {
+    delete r;
+    if (refuses_for_good(err)) g_refusal.store(err, std::memory_order_relaxed);
+    return nullptr;
+  }
+  node.set_poller(r);
+  return r;
+}
+
+int uring_reactor::probe() {
+  if (auto err = g_refusal.load(std::memory_order_relaxed)) return err;
+  uring r;
+  auto err = r.init(1);
+  if (refuses_for_good(err)) g_refusal.store(err, std::memory_order_relaxed);
+  return err;
+}
+
+uring_reactor::uring_reactor(sched_node* node)
+    : _node(node),
+      _ring(),
+      _wake_fd(-1),
+      _wake_armed(false),
+      _fixed_tried(false),
+      _fixed_slots() {}
+
+uring_reactor::~uring_reactor() {
+  if (_wake_fd >= 0) close(_wake_fd);
+}
+
+int uring_reactor::init() {
+  if (auto err = _ring.init(k_entries)) return err;
+  _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  return _wake_fd < 0 ? errno : 0;
+}
+
+io_uring_sqe* uring_reactor::get_sqe() {
+  // a full queue is handed to the kernel to make room. if even that fails
+  // (e.g. while completions are backed up), finished tasks are reaped first.
+  io_uring_sqe* sqe;
+  while ((sqe = _ring.get_sqe()) == nullptr) {
+    if (_ring.submit() <= 0) poll();
+  }
+  return sqe;
+}
+
+bool uring_reactor::fixed_buffer(unsigned index, const iovec& region) {
+  if (!_fixed_tried) {
+    _fixed_tried = true;
+    if (_ring.register_buffers(k_fixed_buffers) == 0) {
+      _fixed_slots.assign(k_fixed_buffers, k_slot_empty);
+    }
+  }
+  if (index >= _fixed_slots.size()) return false;
+
+  auto& slot = _fixed_slots[index];
+  if (slot == k_slot_empty) {
+    slot = _ring.update_buffer(index, region) == 0 ? k_slot_filled
+                                                   : k_slot_refused;
+  }
+  return slot == k_slot_filled;
+}
+
+int32_t uring_reactor::park(io_uring_sqe* sqe) {
+  auto* current = task::current();
+  op o{current, 0};
+  sqe->user_data = reinterpret_cast<uint64_t>(&o);
+
+  // the entry is submitted with the node's next batch, once this task has
+  // switched away
+  current->run_state = task::WAITING;
+  gthread_trace(*_node, park, current, nullptr);
+  _node->yield();
+
+  return o.result;
+}
+
+void uring_reactor::poll() {
+  if (_ring.unsubmitted() > 0) _ring.submit();
+
+  _ring.reap([this](const io_uring_cqe& cqe) {
+    if (cqe.user_data == k_wake_data) {
+      uint64_t n;
+      while (read(_wake_fd, &n, sizeof(n)) > 0) {
+      }
+      _wake_armed = false;
+      return;
+    }
+
+    // |o| lives on its task's stack, and isn't touched once it is scheduled
+    auto* o = reinterpret_cast<op*>(cqe.user_data);
+    o->result = cqe.res;
+    auto* t = o->t;
+    t->run_state = task::SUSPENDED;
+    gthread_trace(*_node, unpark, task::current(), t);
+    t->node->schedule(t);
+  });
+}
+
+void uring_reactor::wait_for(std::chrono::nanoseconds timeout) {
+  if (!_wake_armed) {
+    auto* sqe = _ring.get_sqe();
+    if (sqe == nullptr) {
+      // without the poll, an `interrupt()` could go unnoticed, so make room
+      // and let the node look again
+      _ring.submit();
+      return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _wake_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = k_wake_data;
+    _wake_armed = true;
+  }
+  _ring.wait_for(timeout);
+}
+
+void uring_reactor::interrupt() {
+  uint64_t one = 1;
+  if (branch_unexpected(write(_wake_fd, &one, sizeof(one)) < 0 &&
+                        errno != EAGAIN)) {
+    gthread_log_fatal("could not signal a node's io_uring");
+  }
+}
+}  // namespace internal
+}  // namespace gthread
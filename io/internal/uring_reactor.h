@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "io/internal/uring.h"
+#include "sched/poller.h"
+#include "sched/sched_node.h"
+#include "sched/task.h"
+
+namespace gthread {
+namespace internal {
+/**
+ * a node's io_uring. its tasks submit I/O to it and park until the I/O
+ * finishes, and the node reaps the completions in batches when it picks its
+ * next task or runs out of work (see `poller`). a task's entry isn't handed
+ * to the kernel until it has parked, and only the node reaps, so a completion
+ * always finds its task parked on the node.
+ */
+class uring_reactor final : public poller {
+ public:
+  /**
+   * how many entries each node's ring has room for
+   */
+  static constexpr unsigned k_entries = 256;
+
+  /**
+   * the reactor of |node|, set up on first use, or nullptr if io_uring isn't
+   * available. must be called on |node|'s kernel-managed thread, holding the
+   * `preempt_mutex`.
+   */
+  static uring_reactor* get(sched_node& node);
+
+  /**
+   * 0 if a ring can be set up here, or the errno value the kernel refuses it
+   * with. may be called from any thread.
+   */
+  static int probe();
+
+  /**
+   * a zeroed entry for the current task to fill in and pass to `park()`.
+   * must hold the `preempt_mutex`.
+   */
+  io_uring_sqe* get_sqe();
+
+  /**
+   * parks the current task until |sqe| completes and returns its result (a
+   * negative errno value on failure). must hold the `preempt_mutex`, which
+   * is still held when it returns, though perhaps on another node.
+   */
+  int32_t park(io_uring_sqe* sqe);
+
+  /**
+   * how many slots each ring's fixed buffer table has
+   */
+  static constexpr unsigned k_fixed_buffers = 1024;
+
+  /**
+   * whether |region| is in slot |index| of the ring's fixed buffer table,
+   * putting it there on first use, so that entries may name it in
+   * `buf_index`. false if the kernel won't have it there. must hold the
+   * `preempt_mutex`.
+   */
+  bool fixed_buffer(unsigned index, const iovec& region);
+
+  void poll() override;
+  void wait_for(std::chrono::nanoseconds timeout) override;
+  void interrupt() override;
+
+ private:
+  explicit uring_reactor(sched_node* node);
+  ~uring_reactor();
+
+  /**
+   * sets up the ring and the eventfd that `interrupt()` signals. returns 0 or
+   * an errno value.
+   */
+  int init();
+
+  /**
+   * a task waiting for its entry to complete
+   */
+  struct op {
+    task* t;
+    int32_t result;
+  };
+
+  sched_node* _node;
+  uring _ring;
+
+  // `interrupt()` signals this, and a poll on it is kept in the ring while
+  // the node waits
+  int _wake_fd;
+  bool _wake_armed;
+
+  // the fixed buffer table is set up on first use. a slot that couldn't be
+  // filled (e.g. past `RLIMIT_MEMLOCK`) isn't tried again.
+  enum slot_state : uint8_t { k_slot_empty, k_slot_filled, k_slot_refused };
+  bool _fixed_tried;
+  std::vector<slot_state> _fixed_slots;
+};
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,92 @@
+#include "io/internal/uring.h"
+
+#include <cerrno>
+#include <chrono>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+using namespace gthread::internal;
+
+TEST(gthread_uring, completes_in_submission_order) {
+  uring r;
+  auto err = r.init(4);
+  if (err == ENOSYS || err == EPERM) return;  // no io_uring here
+  ASSERT_EQ(err, 0);
+
+  // the queue holds as many entries as it was set up with
+  for (uint64_t i = 1; i <= 4; ++i) {
+    auto* sqe = r.get_sqe();
+    ASSERT_NE(sqe, nullptr);
+    prep_rw(sqe, IORING_OP_NOP, -1, nullptr, 0, 0);
+    sqe->user_data = i;
+  }
+  EXPECT_EQ(r.get_sqe(), nullptr);
+  EXPECT_EQ(r.unsubmitted(), 4u);
+
+  EXPECT_EQ(r.submit(), 4);
+  EXPECT_EQ(r.unsubmitted(), 0u);
+
+  uint64_t next = 1;
+  while (next <= 4) {
+    r.wait_for(std::chrono::seconds{1});
+    r.reap([&](const io_uring_cqe& cqe) {
+      EXPECT_EQ(cqe.user_data, next++);
+      EXPECT_EQ(cqe.res, 0);
+    });
+  }
+  EXPECT_EQ(r.reap([](const io_uring_cqe&) {}), 0u);
+}
+
+TEST(gthread_uring, wait_times_out) {
+  uring r;
+  auto err = r.init(4);
+  if (err == ENOSYS || err == EPERM) return;  // no io_uring here
+  ASSERT_EQ(err, 0);
+
+  auto start = std::chrono::steady_clock::now();
+  r.wait_for(std::chrono::milliseconds{10});
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds{5});
+}
+
+TEST(gthread_uring, reports_errors_in_completions) {
+  uring r;
+  auto err = r.init(4);
+  if (err == ENOSYS || err == EPERM) return;  // no io_uring here
+  ASSERT_EQ(err, 0);
+
+  char c;
+  prep_rw(r.get_sqe(), IORING_OP_READ, -1, &c, 1, 0);
+  r.wait_for(std::chrono::seconds{1});
+  int32_t res = 0;
+  EXPECT_EQ(r.reap([&](const io_uring_cqe& cqe) { res = cqe.res; }), 1u);
+  EXPECT_EQ(res, -EBADF);
+}
+
+TEST(gthread_uring, reads_into_fixed_buffers) {
+  uring r;
+  auto err = r.init(4);
+  if (err == ENOSYS || err == EPERM) return;  // no io_uring here
+  ASSERT_EQ(err, 0);
+  if (r.register_buffers(2) != 0) return;  // the kernel predates it
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(write(fds[1], "abc", 3), 3);
+
+  char buf[16] = {};
+  ASSERT_EQ(r.update_buffer(1, iovec{buf, sizeof(buf)}), 0);
+  auto* sqe = r.get_sqe();
+  prep_rw(sqe, IORING_OP_READ_FIXED, fds[0], buf, sizeof(buf), 0);
+  sqe->buf_index = 1;
+  r.wait_for(std::chrono::seconds{1});
+  int32_t res = 0;
+  EXPECT_EQ(r.reap([&](const io_uring_cqe& cqe) { res = cqe.res; }), 1u);
+  EXPECT_EQ(res, 3);
+  EXPECT_STREQ(buf, "abc");
+
+  close(fds[0]);
+  close(fds[1]);
+}
@@ -0,0 +1,604 @@
+#include "io/io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io/internal/epoll_reactor.h"
+#include "io/internal/offload_pool.h"
+#include "io/internal/uring_reactor.h"
+#include "sched/preempt.h"
+#include "sched/sched.h"
+#include "util/compiler.h"
+
+namespace gthread {
+namespace io {
+namespace {
+using internal::prep_rw;
+
+// `prep_rw()`'s offset for reading or writing at the fd's file position
+constexpr uint64_t k_file_position = ~uint64_t{0};
+
+// the backend in use, or `automatic` until one is chosen. it is fixed once
+// chosen, since each node's poller is the one reactor or the other.
+std::atomic<backend> g_backend{backend::automatic};
+std::mutex g_backend_mu;
+
+/**
+ * what |b| stands for here. throws if it is `io_uring` and that isn't
+ * available.
+ */
+backend resolve(backend b) {
+  switch (b) {
+    case backend::automatic:
+      return internal::uring_reactor::probe() == 0 ? backend::io_uring
+                                                    : backend::epoll;
+    case backend::io_uring:
+      if (auto err = internal::uring_reactor::probe()) {
+        throw std::system_error(err, std::system_category(),
+                                "io_uring is not available");
+      }
+      return b;
+    default:
+      return b;
+  }
+}
+
+/**
+ * the backend in use, chosen by `resolve()` the first time
+ */
+backend in_use() {
+  auto b = g_backend.load(std::memory_order_acquire);
+  if (branch_expected(b != backend::automatic)) return b;
+
+  std::lock_guard<std::mutex> l(g_backend_mu);
+  b = g_backend.load(std::memory_order_relaxed);
+  if (b == backend::automatic) {
+    b = resolve(backend::automatic);
+    g_backend.store(b, std::memory_order_release);
+  }
+  return b;
+}
+
+/**
+ * an entry's length is 32 bits wide. a longer read or write is cut short,
+ * which the caller has to handle anyway.
+ */
+uint32_t entry_len(size_t n) {
+  return static_cast<uint32_t>(std::min<size_t>(n, UINT32_MAX));
+}
+
+/**
+ * makes the call |blocking| makes, letting the node's other tasks run
+ * elsewhere if it blocks
+ */
+template <typename Blocking>
+int64_t blocking_call(const Blocking& blocking) {
+  // `exit_blocking()` mustn't clobber the call's `errno`
+  sched::enter_blocking();
+  auto res = blocking();
+  auto err = errno;
+  sched::exit_blocking();
+  errno = err;
+  return res;
+}
+
+/**
+ * makes the call that |prep| fills an entry in for on the current node's
+ * ring, or makes it by calling |blocking| where there is none (including on
+ * the other backends)
+ */
+template <typename Prep, typename Blocking>
+int64_t call_once(backend b, const Prep& prep, const Blocking& blocking) {
+  if (b == backend::io_uring && sched_node::current() != nullptr) {
+    auto& pmu = preempt_mutex::get();
+    std::lock_guard<preempt_mutex> l(pmu);
+    if (auto* r = internal::uring_reactor::get(pmu.node())) {
+      auto* sqe = r->get_sqe();
+      prep(sqe);
+      auto res = r->park(sqe);
+      if (res < 0) {
+        errno = -res;
+        return -1;
+      }
+      return res;
+    }
+  }
+  return blocking_call(blocking);
+}
+
+/**
+ * makes the call |blocking| makes on |fd| (e.g. a regular file) on the
+ * offload pool, parking until it returns, where there is a task to park
+ */
+template <typename Blocking>
+int64_t offload(int fd, const Blocking& blocking) {
+  struct stat st;
+  if (sched_node::current() == nullptr || fstat(fd, &st) < 0) {
+    return blocking_call(blocking);
+  }
+
+  internal::offload_op op{
+      [](const void* arg) -> int64_t {
+        return (*static_cast<const Blocking*>(arg))();
+      },
+      &blocking, st.st_dev, 0, 0, {}};
+  internal::offload_pool::get().run(&op);
+  if (op.result < 0) errno = op.error;
+  return op.result;
+}
+
+/**
+ * on the epoll backend, parks until |fd| is ready for |events|. returns 0
+ * once it is, or an errno value if it can't be waited for there (e.g. `EPERM`
+ * for a regular file, which epoll considers always ready)
+ */
+int park_until_ready(int fd, short events) {
+  if (sched_node::current() == nullptr) return ENOTSUP;
+  auto& pmu = preempt_mutex::get();
+  std::lock_guard<preempt_mutex> l(pmu);
+  auto* r = internal::epoll_reactor::get(pmu.node());
+  if (r == nullptr) return ENOTSUP;
+  return r->park(fd, events & POLLOUT ? EPOLLOUT : EPOLLIN);
+}
+
+/**
+ * waits until |fd| is ready for |events|
+ */
+int wait_ready(backend b, int fd, short events) {
+  // an fd epoll can't wait for is polled below, which for a regular file
+  // finds it ready right away
+  if (b == backend::epoll && park_until_ready(fd, events) == 0) return 0;
+
+  auto res = call_once(
+      b,
+      [fd, events](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_POLL_ADD, fd, nullptr, 0, 0);
+        sqe->poll32_events = static_cast<uint16_t>(events);
+      },
+      [fd, events]() {
+        pollfd p{fd, events, 0};
+        return ::poll(&p, 1, -1);
+      });
+  return res < 0 ? -1 : 0;
+}
+
+/**
+ * like `call_once()`, but when |fd| is nonblocking and isn't ready, waits
+ * for |events| and tries again
+ */
+template <typename Prep, typename Blocking>
+int64_t call(int fd, short events, const Prep& prep, const Blocking& blocking) {
+  auto b = in_use();
+  if (b == backend::epoll) {
+    // a blocking fd is waited for first, so the call most likely won't
+    // block. one that epoll can't wait for goes to the offload pool.
+    auto flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+      auto err = park_until_ready(fd, events);
+      if (err == EPERM) return offload(fd, blocking);
+      return blocking_call(blocking);
+    }
+    while (true) {
+      auto res = blocking();
+      if (res >= 0 || errno != EAGAIN) return res;
+      if (wait_ready(b, fd, events) < 0) return -1;
+    }
+  }
+
+  while (true) {
+    auto res = call_once(b, prep, blocking);
+    if (res >= 0 || errno != EAGAIN) return res;
+    if (wait_ready(b, fd, events) < 0) return -1;
+  }
+}
+
+/**
+ * waits until |in| is readable and |out| writable, as a call that moves data
+ * from one to the other needs
+ */
+int wait_both(backend b, int in, int out) {
+  if (wait_ready(b, in, POLLIN) < 0) return -1;
+  return wait_ready(b, out, POLLOUT);
+}
+
+bool nonblocking(int fd) {
+  auto flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && (flags & O_NONBLOCK) != 0;
+}
+
+/**
+ * makes the call |blocking| makes to move data from |in| to |out|, which
+ * mustn't block on a pipe (see `SPLICE_F_NONBLOCK`). if both fds are
+ * nonblocking, it is tried first and waited for if it would block. otherwise
+ * it is waited for first, and then made inside `sched::enter_blocking()` in
+ * case either fd stops being ready in between.
+ */
+template <typename Blocking>
+int64_t transfer(backend b, int in, int out, const Blocking& blocking) {
+  bool wait_first = !nonblocking(in) || !nonblocking(out);
+  while (true) {
+    if (wait_first && wait_both(b, in, out) < 0) return -1;
+    auto res = wait_first ? blocking_call(blocking) : blocking();
+    if (res >= 0 || errno != EAGAIN) return res;
+    if (!wait_first && wait_both(b, in, out) < 0) return -1;
+  }
+}
+
+/**
+ * like `transfer()`, but on io_uring the call that |prep| fills an entry in
+ * for is submitted to the ring, and only waited for if it would block
+ */
+template <typename Prep, typename Blocking>
+int64_t submit_transfer(int in, int out, const Prep& prep,
+                        const Blocking& blocking) {
+  auto b = in_use();
+  if (b != backend::io_uring) return transfer(b, in, out, blocking);
+  while (true) {
+    auto res = call_once(b, prep, blocking);
+    if (res >= 0 || errno != EAGAIN) return res;
+    if (wait_both(b, in, out) < 0) return -1;
+  }
+}
+
+/**
+ * advances |*off| past the |res| bytes a call at it moved, as the system call
+ * would have, unless the call failed or there is no |off|
+ */
+template <typename Offset>
+void advance(Offset* off, int64_t res) {
+  if (off != nullptr && res > 0) *off += res;
+}
+
+/**
+ * like `call_once()` for a call on a file, which the offload pool makes on
+ * the epoll backend
+ */
+template <typename Prep, typename Blocking>
+int64_t file_call(int fd, const Prep& prep, const Blocking& blocking) {
+  auto b = in_use();
+  if (b == backend::epoll) return offload(fd, blocking);
+  return call_once(b, prep, blocking);
+}
+
+// the most buffers of a chain read into or written out of at once
+constexpr int k_max_iov = 64;
+
+/**
+ * reads or writes |iov|, which lies in |b|, naming |b|'s region of the pool
+ * as a fixed buffer on io_uring if the ring has it
+ */
+ssize_t buffer_call(int fd, bool write, const buffer& b, const iovec& iov) {
+  auto prep = [&](io_uring_sqe* sqe) {
+    auto len = entry_len(iov.iov_len);
+    iovec region;
+    auto index = internal::buffer_region(b, &region);
+    auto& r = *internal::uring_reactor::get(preempt_mutex::get().node());
+    if (index < internal::uring_reactor::k_fixed_buffers &&
+        r.fixed_buffer(index, region)) {
+      prep_rw(sqe, write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED, fd,
+              iov.iov_base, len, k_file_position);
+      sqe->buf_index = static_cast<uint16_t>(index);
+    } else {
+      prep_rw(sqe, write ? IORING_OP_WRITE : IORING_OP_READ, fd, iov.iov_base,
+              len, k_file_position);
+    }
+  };
+  if (write) {
+    return call(fd, POLLOUT, prep,
+                [&]() { return ::write(fd, iov.iov_base, iov.iov_len); });
+  }
+  return call(fd, POLLIN, prep,
+              [&]() { return ::read(fd, iov.iov_base, iov.iov_len); });
+}
+}  // namespace
+
+void set_backend(backend b) {
+  std::lock_guard<std::mutex> l(g_backend_mu);
+  auto current = g_backend.load(std::memory_order_relaxed);
+  if (b == backend::automatic && current != backend::automatic) return;
+  b = resolve(b);
+  if (current != backend::automatic && current != b) {
+    throw std::logic_error("another I/O backend is already in use");
+  }
+  g_backend.store(b, std::memory_order_release);
+}
+
+backend get_backend() { return in_use(); }
+
+void set_queue_depth(dev_t dev, unsigned depth) {
+  internal::offload_pool::get().set_queue_depth(dev, depth);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+  return call(
+      fd, POLLIN,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_READ, fd, buf, entry_len(count),
+                k_file_position);
+      },
+      [=]() { return ::read(fd, buf, count); });
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+  return call(
+      fd, POLLOUT,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_WRITE, fd, buf, entry_len(count),
+                k_file_position);
+      },
+      [=]() { return ::write(fd, buf, count); });
+}
+
+ssize_t readv(int fd, const iovec* iov, int iovcnt) {
+  return call(
+      fd, POLLIN,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_READV, fd, iov, static_cast<uint32_t>(iovcnt),
+                k_file_position);
+      },
+      [=]() { return ::readv(fd, iov, iovcnt); });
+}
+
+ssize_t writev(int fd, const iovec* iov, int iovcnt) {
+  return call(
+      fd, POLLOUT,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_WRITEV, fd, iov, static_cast<uint32_t>(iovcnt),
+                k_file_position);
+      },
+      [=]() { return ::writev(fd, iov, iovcnt); });
+}
+
+ssize_t readv(int fd, buffer_chain& chain) {
+  if (chain.room() == 0) chain.append();
+
+  // the room starts in the last buffer holding data
+  buffer* first = nullptr;
+  for (auto& b : chain) {
+    if (first == nullptr || b.size() > 0) first = &b;
+  }
+  // which buffer each iovec lies in. the first needn't be |first|, which may
+  // be full.
+  iovec iov[k_max_iov];
+  buffer* owner[k_max_iov];
+  int n = 0;
+  for (auto* b = first; b != nullptr && n < k_max_iov; b = b->next()) {
+    if (b->room() == 0) continue;
+    owner[n] = b;
+    iov[n++] = {b->tail(), b->room()};
+  }
+
+  auto res = n == 1 ? buffer_call(fd, false, *owner[0], iov[0])
+                    : io::readv(fd, iov, n);
+
+  // what was read fills the room in order
+  for (auto left = res; left > 0; first = first->next()) {
+    auto m = std::min<size_t>(static_cast<size_t>(left), first->room());
+    first->commit(m);
+    left -= static_cast<ssize_t>(m);
+  }
+  return res;
+}
+
+ssize_t writev(int fd, buffer_chain& chain) {
+  iovec iov[k_max_iov];
+  buffer* only = nullptr;
+  int n = 0;
+  for (auto& b : chain) {
+    if (b.size() == 0) continue;
+    if (n == k_max_iov) break;
+    iov[n++] = {b.data(), b.size()};
+    only = &b;
+  }
+  if (n == 0) return 0;
+
+  auto res = n == 1 ? buffer_call(fd, true, *only, iov[0])
+                    : io::writev(fd, iov, n);
+  if (res > 0) chain.consume(static_cast<size_t>(res));
+  return res;
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+  // the ring reads at the file position given -1
+  if (branch_unexpected(offset < 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+  return file_call(
+      fd,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_READ, fd, buf, entry_len(count),
+                static_cast<uint64_t>(offset));
+      },
+      [=]() { return ::pread(fd, buf, count, offset); });
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  if (branch_unexpected(offset < 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+  return file_call(
+      fd,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_WRITE, fd, buf, entry_len(count),
+                static_cast<uint64_t>(offset));
+      },
+      [=]() { return ::pwrite(fd, buf, count, offset); });
+}
+
+int accept(int fd, sockaddr* addr, socklen_t* addrlen, int flags) {
+  return static_cast<int>(call(
+      fd, POLLIN,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_ACCEPT, fd, addr, 0,
+                reinterpret_cast<uint64_t>(addrlen));
+        sqe->accept_flags = static_cast<uint32_t>(flags);
+      },
+      [=]() { return ::accept4(fd, addr, addrlen, flags); }));
+}
+
+int connect(int fd, const sockaddr* addr, socklen_t addrlen) {
+  auto b = in_use();
+  auto res = call_once(
+      b,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_CONNECT, fd, addr, 0, addrlen);
+      },
+      [=]() { return ::connect(fd, addr, addrlen); });
+  if (res == 0 || errno != EINPROGRESS) return static_cast<int>(res);
+
+  // a nonblocking socket connects in the background, and is writable once it
+  // has (or has failed to)
+  if (wait_ready(b, fd, POLLOUT) < 0) return -1;
+  int err;
+  socklen_t len = sizeof(err);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) return -1;
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+ssize_t recv(int fd, void* buf, size_t len, int flags) {
+  return call(
+      fd, POLLIN,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_RECV, fd, buf, entry_len(len), 0);
+        sqe->msg_flags = static_cast<uint32_t>(flags);
+      },
+      [=]() { return ::recv(fd, buf, len, flags); });
+}
+
+ssize_t send(int fd, const void* buf, size_t len, int flags) {
+  return call(
+      fd, POLLOUT,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_SEND, fd, buf, entry_len(len), 0);
+        sqe->msg_flags = static_cast<uint32_t>(flags);
+      },
+      [=]() { return ::send(fd, buf, len, flags); });
+}
+
+int fsync(int fd) {
+  return static_cast<int>(file_call(
+      fd,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_FSYNC, fd, nullptr, 0, 0);
+      },
+      [=]() { return ::fsync(fd); }));
+}
+
+int openat(int dirfd, const char* path, int flags, mode_t mode) {
+  return static_cast<int>(call_once(
+      in_use(),
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_OPENAT, dirfd, path, mode, 0);
+        sqe->open_flags = static_cast<uint32_t>(flags);
+      },
+      [=]() { return ::openat(dirfd, path, flags, mode); }));
+}
+
+ssize_t splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out,
+               size_t len, unsigned flags) {
+  // the ring takes the offsets by value (-1 for the file position), so they
+  // are only advanced once the call returns, however it was made
+  auto in_pos = off_in != nullptr ? *off_in : -1;
+  auto out_pos = off_out != nullptr ? *off_out : -1;
+  auto res = submit_transfer(
+      fd_in, fd_out,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_SPLICE, fd_out, nullptr, entry_len(len),
+                static_cast<uint64_t>(out_pos));
+        sqe->splice_off_in = static_cast<uint64_t>(in_pos);
+        sqe->splice_fd_in = fd_in;
+        sqe->splice_flags = flags;
+      },
+      [=]() {
+        auto in = in_pos;
+        auto out = out_pos;
+        return ::splice(fd_in, off_in != nullptr ? &in : nullptr, fd_out,
+                        off_out != nullptr ? &out : nullptr, len,
+                        flags | SPLICE_F_NONBLOCK);
+      });
+  advance(off_in, res);
+  advance(off_out, res);
+  return res;
+}
+
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned flags) {
+  return submit_transfer(
+      fd_in, fd_out,
+      [=](io_uring_sqe* sqe) {
+        prep_rw(sqe, IORING_OP_TEE, fd_out, nullptr, entry_len(len), 0);
+        sqe->splice_fd_in = fd_in;
+        sqe->splice_flags = flags;
+      },
+      [=]() { return ::tee(fd_in, fd_out, len, flags | SPLICE_F_NONBLOCK); });
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+  // io_uring has no such call
+  return transfer(in_use(), in_fd, out_fd, [=]() {
+    return ::sendfile(out_fd, in_fd, offset, count);
+  });
+}
+
+ssize_t copy_file_range(int fd_in, loff_t* off_in, int fd_out,
+                        loff_t* off_out, size_t len, unsigned flags) {
+  return offload(fd_in, [=]() {
+    return ::copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+  });
+}
+
+ssize_t pipe_relay(int fd_in, int fd_out) {
+  int p[2];
+  if (pipe2(p, O_NONBLOCK | O_CLOEXEC) < 0) return -1;
+
+  // whatever is read into the pipe is written out before reading more, so it
+  // never holds more than one read's worth
+  constexpr size_t k_chunk = 64 << 10;
+  ssize_t total = 0;
+  while (true) {
+    auto n = io::splice(fd_in, nullptr, p[1], nullptr, k_chunk,
+                        SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n <= 0) {
+      if (n == 0) break;
+      total = -1;
+      break;
+    }
+    for (auto left = n; left > 0;) {
+      auto m = io::splice(p[0], nullptr, fd_out, nullptr,
+                          static_cast<size_t>(left), SPLICE_F_MOVE);
+      if (m <= 0) {
+        // the pipe holds what was read, so moving none of it is a failure
+        if (m == 0) errno = EIO;
+        total = -1;
+        break;
+      }
+      left -= m;
+    }
+    if (total < 0) break;
+    total += n;
+  }
+
+  auto err = errno;
+  close(p[0]);
+  close(p[1]);
+  errno = err;
+  return total;
+}
+}  // namespace io
+}  // namespace gthread
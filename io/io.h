@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "io/buffer.h"
+
+namespace gthread {
+namespace io {
+/**
+ * how the calls below wait, which is the same for every task and node:
+ *
+ *  - `io_uring`: each call is submitted to the node's io_uring and completed
+ *    when the node next picks a task or runs out of work, which reaps every
+ *    finished call at once.
+ *  - `epoll`: a call that would block parks until the fd is ready, as the
+ *    node's epoll instance reports when it next picks a task or runs out of
+ *    work. then the system call is made. on a blocking fd, it is made inside
+ *    `sched::enter_blocking()` in case the fd stops being ready in between,
+ *    as are `openat()` and `connect()`, which can't be waited for. calls on
+ *    a regular file, which epoll can't wait for either, are made by a small
+ *    pool of kernel-managed threads instead, while the task is parked; so
+ *    are `pread()`, `pwrite()` and `fsync()`. (a nonblocking regular file
+ *    is read directly, since `O_NONBLOCK` means nothing to it.)
+ *  - `blocking`: each system call is made inside `sched::enter_blocking()`.
+ *
+ * `automatic` stands for `io_uring` where it is available (i.e. a new enough
+ * kernel and no seccomp policy against it), and `epoll` elsewhere.
+ */
+enum class backend { automatic, io_uring, epoll, blocking };
+
+/**
+ * chooses the backend. it is fixed by the first call here, to
+ * `get_backend()` or to any of the I/O calls, so this is best called before
+ * doing any I/O. throws `std::logic_error` if another backend is already in
+ * use, or a `std::system_error` if |b| is `io_uring` and the kernel refuses
+ * to set up a ring.
+ */
+void set_backend(backend b);
+
+/**
+ * the backend in use, which is never `automatic`. fixes it if it isn't yet.
+ */
+backend get_backend();
+
+/**
+ * sets how many calls the epoll backend's thread pool makes at once to the
+ * files on device |dev| (a `stat()`'s `st_dev`). the rest wait their turn.
+ * the default is 4. throws `std::domain_error` if |depth| is 0.
+ */
+void set_queue_depth(dev_t dev, unsigned depth);
+
+/**
+ * I/O that parks the calling task instead of blocking its kernel-managed
+ * thread, so the other tasks there keep running.
+ *
+ * the calls take and return what the system calls they are named for do:
+ * on failure they return -1 and set `errno`. an fd may be blocking or
+ * nonblocking; a call on a nonblocking one that would block waits for the fd
+ * to be ready rather than failing with `EAGAIN`. code written against them
+ * works the same on every backend.
+ *
+ * where the backend can't be set up on a node (e.g. it is out of fds), the
+ * system call is made directly inside `sched::enter_blocking()`. so is a call
+ * from a thread that isn't hosting a node.
+ */
+ssize_t read(int fd, void* buf, size_t count);
+ssize_t write(int fd, const void* buf, size_t count);
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
+
+ssize_t readv(int fd, const iovec* iov, int iovcnt);
+ssize_t writev(int fd, const iovec* iov, int iovcnt);
+
+/**
+ * reads into the room after |chain|'s data (adding a buffer first if there is
+ * none) and appends what was read. on io_uring, a read into one buffer uses
+ * the pool's memory as a registered fixed buffer where the kernel allows.
+ */
+ssize_t readv(int fd, buffer_chain& chain);
+
+/**
+ * writes out |chain|'s data (like `readv()`, through a fixed buffer where it
+ * can) and consumes what was written
+ */
+ssize_t writev(int fd, buffer_chain& chain);
+
+int accept(int fd, sockaddr* addr, socklen_t* addrlen, int flags = 0);
+int connect(int fd, const sockaddr* addr, socklen_t addrlen);
+
+ssize_t recv(int fd, void* buf, size_t len, int flags = 0);
+ssize_t send(int fd, const void* buf, size_t len, int flags = 0);
+
+int fsync(int fd);
+int openat(int dirfd, const char* path, int flags, mode_t mode = 0);
+
+/**
+ * calls that move data between fds in the kernel, without copying it
+ * through a buffer here. one that would block waits until |fd_in| is
+ * readable and |fd_out| writable (on io_uring, `splice()` and `tee()` are
+ * submitted to the ring instead). `copy_file_range()` goes to the thread
+ * pool that makes calls on regular files, whatever the backend.
+ */
+ssize_t splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out,
+               size_t len, unsigned flags = 0);
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned flags = 0);
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+ssize_t copy_file_range(int fd_in, loff_t* off_in, int fd_out,
+                        loff_t* off_out, size_t len, unsigned flags = 0);
+
+/**
+ * moves everything read from |fd_in| to |fd_out| until |fd_in| reaches the
+ * end, like a proxy's read/write loop but through a pipe of its own with
+ * `splice()`, so the data is never copied here. returns how many bytes it
+ * moved, or -1 and sets `errno` if a call failed (in which case some of what
+ * was read may not have been written).
+ */
+ssize_t pipe_relay(int fd_in, int fd_out);
+}  // namespace io
+}  // namespace gthread
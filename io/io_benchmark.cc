@@ -0,0 +1,189 @@
+#include "io/io.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "gthread.h"
+
+// the backend the benchmarks run on, which `io_epoll_benchmark` overrides
+#ifndef GTHREAD_IO_BENCHMARK_BACKEND
+#define GTHREAD_IO_BENCHMARK_BACKEND automatic
+#endif
+
+namespace {
+constexpr size_t k_file_size = 64 << 20;
+constexpr size_t k_block = 4096;
+constexpr int k_reads_per_task = 64;
+
+/**
+ * a local file of |k_file_size| bytes, removed along with this
+ */
+class test_file {
+ public:
+  test_file() : _path("/tmp/gthread_io_benchmark_" + std::to_string(getpid())) {
+    _fd = open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    std::vector<char> chunk(1 << 20, 'x');
+    for (size_t written = 0; written < k_file_size; written += chunk.size()) {
+      if (write(_fd, chunk.data(), chunk.size()) < 0) break;
+    }
+    fsync(_fd);
+  }
+
+  ~test_file() {
+    close(_fd);
+    unlink(_path.c_str());
+  }
+
+  int fd() const { return _fd; }
+
+ private:
+  std::string _path;
+  int _fd;
+};
+
+/**
+ * a random block-aligned offset in the file
+ */
+off_t random_offset(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return static_cast<off_t>((*state % (k_file_size / k_block)) * k_block);
+}
+}  // namespace
+
+static void bench_random_4k_pread_on_one_thread(benchmark::State& state) {
+  test_file f;
+  uint64_t rng = 88172645463325252ull;
+  char buf[k_block];
+
+  for (auto _ : state) {
+    for (int i = 0; i < k_reads_per_task; ++i) {
+      benchmark::DoNotOptimize(
+          pread(f.fd(), buf, k_block, random_offset(&rng)));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * k_reads_per_task);
+}
+
+BENCHMARK(bench_random_4k_pread_on_one_thread);
+
+static void bench_random_4k_reads(benchmark::State& state) {
+  gthread::io::set_backend(
+      gthread::io::backend::GTHREAD_IO_BENCHMARK_BACKEND);
+  test_file f;
+  auto tasks = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    auto readers = gthread::g::spawn_many(tasks, [&f](size_t i) {
+      uint64_t rng = 88172645463325252ull + i;
+      char buf[k_block];
+      for (int j = 0; j < k_reads_per_task; ++j) {
+        benchmark::DoNotOptimize(
+            gthread::io::pread(f.fd(), buf, k_block, random_offset(&rng)));
+      }
+    });
+    for (auto& r : readers) r.join();
+  }
+  state.SetItemsProcessed(state.iterations() * tasks * k_reads_per_task);
+}
+
+BENCHMARK(bench_random_4k_reads)->Range(1, 64);
+
+namespace {
+constexpr size_t k_relay_chunk = 64 << 10;
+
+/**
+ * the two ends of a socketpair, or of a pipe if |pipes|, both nonblocking as
+ * a proxy's would be
+ */
+void make_channel(bool pipes, int fds[2]) {
+  if (pipes) {
+    if (pipe2(fds, O_NONBLOCK) < 0) std::abort();
+  } else {
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0) {
+      std::abort();
+    }
+  }
+}
+
+/**
+ * what a proxy does without splicing: reads into a buffer and writes it out
+ */
+void read_write_relay(int in, int out) {
+  std::vector<char> buf(k_relay_chunk);
+  ssize_t n;
+  while ((n = gthread::io::read(in, buf.data(), buf.size())) > 0) {
+    for (ssize_t sent = 0; sent < n;) {
+      auto m = gthread::io::write(out, buf.data() + sent, n - sent);
+      if (m < 0) return;
+      sent += m;
+    }
+  }
+}
+
+/**
+ * pushes |k_relay_chunk| bytes through a relay each iteration, from one
+ * channel to another (socketpairs, or pipes if the benchmark's argument is 1)
+ */
+template <bool Splice>
+void bench_relay(benchmark::State& state) {
+  gthread::io::set_backend(
+      gthread::io::backend::GTHREAD_IO_BENCHMARK_BACKEND);
+  bool pipes = state.range(0) == 1;
+  int in[2], out[2];
+  make_channel(pipes, in);
+  make_channel(pipes, out);
+
+  gthread::g relay([&]() {
+    if (Splice) {
+      gthread::io::pipe_relay(in[0], out[1]);
+    } else {
+      read_write_relay(in[0], out[1]);
+    }
+    close(out[1]);
+  });
+  gthread::g sink([&]() {
+    std::vector<char> buf(k_relay_chunk);
+    while (gthread::io::read(out[0], buf.data(), buf.size()) > 0) {
+    }
+  });
+
+  std::vector<char> chunk(k_relay_chunk, 'x');
+  for (auto _ : state) {
+    for (size_t sent = 0; sent < chunk.size();) {
+      auto n = gthread::io::write(in[1], chunk.data() + sent,
+                                  chunk.size() - sent);
+      if (n < 0) std::abort();
+      sent += n;
+    }
+  }
+  close(in[1]);
+  relay.join();
+  sink.join();
+  close(in[0]);
+  close(out[0]);
+  state.SetBytesProcessed(state.iterations() * k_relay_chunk);
+}
+}  // namespace
+
+static void bench_relay_read_write_loop(benchmark::State& state) {
+  bench_relay<false>(state);
+}
+
+BENCHMARK(bench_relay_read_write_loop)->Arg(0)->Arg(1);
+
+static void bench_relay_pipe_relay(benchmark::State& state) {
+  bench_relay<true>(state);
+}
+
+BENCHMARK(bench_relay_pipe_relay)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN()
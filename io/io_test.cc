@@ -0,0 +1,413 @@
+#include "io/io.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "gthread.h"
+
+using namespace gthread;
+
+// the backend the tests run on, which `io_epoll_test` overrides
+#ifndef GTHREAD_IO_TEST_BACKEND
+#define GTHREAD_IO_TEST_BACKEND automatic
+#endif
+
+TEST(gthread_io, chooses_a_backend) {
+  io::set_backend(io::backend::GTHREAD_IO_TEST_BACKEND);
+  auto b = io::get_backend();
+  EXPECT_NE(b, io::backend::automatic);
+  if (io::backend::GTHREAD_IO_TEST_BACKEND != io::backend::automatic) {
+    EXPECT_EQ(b, io::backend::GTHREAD_IO_TEST_BACKEND);
+  }
+
+  // it is fixed from now on
+  EXPECT_NO_THROW(io::set_backend(b));
+  EXPECT_NO_THROW(io::set_backend(io::backend::automatic));
+  EXPECT_THROW(io::set_backend(io::backend::blocking), std::logic_error);
+  EXPECT_EQ(io::get_backend(), b);
+}
+
+TEST(gthread_io, read_waits_without_blocking_the_node) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  // the reader parks on its node, which is the only one, so the writer
+  // only gets to run if the read doesn't block it
+  char got[6] = {};
+  g reader([&]() { EXPECT_EQ(io::read(fds[0], got, 5), 5); });
+  sched::sleep_for(std::chrono::milliseconds{5});
+  EXPECT_EQ(io::write(fds[1], "hello", 5), 5);
+  reader.join();
+  EXPECT_STREQ(got, "hello");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(gthread_io, nonblocking_fds_wait_until_ready) {
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+  char c = 0;
+  g reader([&]() { EXPECT_EQ(io::read(fds[0], &c, 1), 1); });
+  sched::sleep_for(std::chrono::milliseconds{5});
+  EXPECT_EQ(io::write(fds[1], "x", 1), 1);
+  reader.join();
+  EXPECT_EQ(c, 'x');
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(gthread_io, socketpair_ping_pong) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  constexpr int k_rounds = 1000;
+  g ponger([&]() {
+    for (int i = 0; i < k_rounds; ++i) {
+      int n;
+      ASSERT_EQ(io::recv(fds[1], &n, sizeof(n)), ssize_t{sizeof(n)});
+      ++n;
+      ASSERT_EQ(io::send(fds[1], &n, sizeof(n)), ssize_t{sizeof(n)});
+    }
+  });
+  for (int i = 0; i < k_rounds; ++i) {
+    int n = 2 * i;
+    ASSERT_EQ(io::send(fds[0], &n, sizeof(n)), ssize_t{sizeof(n)});
+    ASSERT_EQ(io::recv(fds[0], &n, sizeof(n)), ssize_t{sizeof(n)});
+    EXPECT_EQ(n, 2 * i + 1);
+  }
+  ponger.join();
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(gthread_io, many_tasks_wait_at_once) {
+  sched::set_concurrency(4);
+
+  // every reader is parked before any byte is written, and their completions
+  // come back to the nodes in batches
+  constexpr int k_tasks = 100;
+  std::vector<int> fds(2 * k_tasks);
+  for (int i = 0; i < k_tasks; ++i) {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[2 * i]), 0);
+  }
+
+  std::atomic<int> done{0};
+  auto readers = g::spawn_many(k_tasks, [&](size_t i) {
+    char c;
+    EXPECT_EQ(io::recv(fds[2 * i], &c, 1), 1);
+    EXPECT_EQ(c, static_cast<char>(i));
+    done.fetch_add(1);
+  });
+  sched::sleep_for(std::chrono::milliseconds{5});
+  EXPECT_EQ(done.load(), 0);
+
+  for (int i = 0; i < k_tasks; ++i) {
+    auto c = static_cast<char>(i);
+    ASSERT_EQ(io::send(fds[2 * i + 1], &c, 1), 1);
+  }
+  for (auto& r : readers) r.join();
+  EXPECT_EQ(done.load(), k_tasks);
+
+  for (auto fd : fds) close(fd);
+}
+
+TEST(gthread_io, accept_and_connect) {
+  std::string dir = "/tmp/gthread_io_XXXXXX";
+  ASSERT_NE(mkdtemp(&dir[0]), nullptr);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  auto path = dir + "/sock";
+  std::strcpy(addr.sun_path, path.c_str());
+  auto* sa = reinterpret_cast<sockaddr*>(&addr);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  ASSERT_EQ(bind(listener, sa, sizeof(addr)), 0);
+  ASSERT_EQ(listen(listener, 8), 0);
+
+  g server([&]() {
+    int conn = io::accept(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    ASSERT_GE(conn, 0);
+    char buf[4] = {};
+    EXPECT_EQ(io::read(conn, buf, 3), 3);
+    EXPECT_STREQ(buf, "hey");
+    close(conn);
+  });
+
+  // a nonblocking client connects in the background
+  int client = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  ASSERT_GE(client, 0);
+  ASSERT_EQ(io::connect(client, sa, sizeof(addr)), 0);
+  EXPECT_EQ(io::write(client, "hey", 3), 3);
+  server.join();
+
+  close(client);
+  close(listener);
+  unlink(path.c_str());
+  rmdir(dir.c_str());
+}
+
+TEST(gthread_io, files) {
+  // tmpfs, where there is one
+  struct stat st;
+  std::string dir = stat("/dev/shm", &st) == 0 ? "/dev/shm" : "/tmp";
+  auto path = dir + "/gthread_io_test_" + std::to_string(getpid());
+
+  int fd = io::openat(AT_FDCWD, path.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                      0600);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(io::write(fd, "some data", 9), 9);
+  EXPECT_EQ(io::fsync(fd), 0);
+
+  // reads and writes go through the file position
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  char buf[10] = {};
+  EXPECT_EQ(io::read(fd, buf, sizeof(buf)), 9);
+  EXPECT_STREQ(buf, "some data");
+  EXPECT_EQ(io::read(fd, buf, sizeof(buf)), 0);
+
+  close(fd);
+  unlink(path.c_str());
+
+  EXPECT_EQ(io::openat(AT_FDCWD, path.c_str(), O_RDONLY), -1);
+  EXPECT_EQ(errno, ENOENT);
+}
+
+TEST(gthread_io, positioned_file_io) {
+  struct stat st;
+  std::string dir = stat("/dev/shm", &st) == 0 ? "/dev/shm" : "/tmp";
+  auto path = dir + "/gthread_io_test_" + std::to_string(getpid());
+  int fd = io::openat(AT_FDCWD, path.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                      0600);
+  ASSERT_GE(fd, 0);
+
+  // each task writes and then reads back its own block, all at once
+  constexpr int k_tasks = 16;
+  constexpr int k_block = 4096;
+  auto tasks = g::spawn_many(k_tasks, [&](size_t i) {
+    std::vector<char> block(k_block, static_cast<char>('a' + i));
+    auto offset = static_cast<off_t>(i * k_block);
+    EXPECT_EQ(io::pwrite(fd, block.data(), k_block, offset), k_block);
+    std::vector<char> got(k_block);
+    EXPECT_EQ(io::pread(fd, got.data(), k_block, offset), k_block);
+    EXPECT_EQ(got, block);
+  });
+  for (auto& t : tasks) t.join();
+
+  // positioned calls leave the file position alone
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+  char c;
+  EXPECT_EQ(io::pread(fd, &c, 1, k_tasks * k_block), 0);
+  EXPECT_EQ(io::pread(fd, &c, 1, -1), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  close(fd);
+  unlink(path.c_str());
+}
+
+TEST(gthread_io, splice_and_tee) {
+  int s[2], p[2], q[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, s), 0);
+  ASSERT_EQ(pipe(p), 0);
+  ASSERT_EQ(pipe(q), 0);
+
+  // the splice parks until there is something to move
+  g splicer([&]() {
+    EXPECT_EQ(io::splice(s[1], nullptr, p[1], nullptr, 5), 5);
+  });
+  sched::sleep_for(std::chrono::milliseconds{5});
+  EXPECT_EQ(io::write(s[0], "hello", 5), 5);
+  splicer.join();
+
+  // a tee leaves the data in |p| to be read there too
+  EXPECT_EQ(io::tee(p[0], q[1], 5), 5);
+  char a[6] = {}, b[6] = {};
+  EXPECT_EQ(io::read(p[0], a, 5), 5);
+  EXPECT_EQ(io::read(q[0], b, 5), 5);
+  EXPECT_STREQ(a, "hello");
+  EXPECT_STREQ(b, "hello");
+
+  for (auto fd : {s[0], s[1], p[0], p[1], q[0], q[1]}) close(fd);
+}
+
+TEST(gthread_io, sendfile_and_copy_file_range) {
+  struct stat st;
+  std::string dir = stat("/dev/shm", &st) == 0 ? "/dev/shm" : "/tmp";
+  auto path = dir + "/gthread_io_test_" + std::to_string(getpid());
+  int fd = io::openat(AT_FDCWD, path.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                      0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(io::write(fd, "0123456789", 10), 10);
+
+  int s[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, s), 0);
+  off_t offset = 2;
+  EXPECT_EQ(io::sendfile(s[0], fd, &offset, 4), 4);
+  EXPECT_EQ(offset, 6);
+  char buf[5] = {};
+  EXPECT_EQ(io::read(s[1], buf, 4), 4);
+  EXPECT_STREQ(buf, "2345");
+
+  // offsets given are advanced, and the file position is left alone
+  loff_t in = 6, out = 10;
+  EXPECT_EQ(io::copy_file_range(fd, &in, fd, &out, 4), 4);
+  EXPECT_EQ(in, 10);
+  EXPECT_EQ(out, 14);
+  char all[15] = {};
+  EXPECT_EQ(io::pread(fd, all, 14, 0), 14);
+  EXPECT_STREQ(all, "01234567896789");
+
+  loff_t splice_in = 0;
+  int p[2];
+  ASSERT_EQ(pipe(p), 0);
+  EXPECT_EQ(io::splice(fd, &splice_in, p[1], nullptr, 3), 3);
+  EXPECT_EQ(splice_in, 3);
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 10);
+
+  for (auto f : {fd, s[0], s[1], p[0], p[1]}) close(f);
+  unlink(path.c_str());
+}
+
+TEST(gthread_io, pipe_relay_moves_everything) {
+  int in[2], out[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, in), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, out), 0);
+
+  constexpr ssize_t k_bytes = 1 << 20;
+  ssize_t relayed = 0;
+  g relay([&]() {
+    relayed = io::pipe_relay(in[1], out[0]);
+    shutdown(out[0], SHUT_WR);
+  });
+
+  ssize_t got = 0;
+  bool intact = true;
+  g reader([&]() {
+    char buf[4096];
+    ssize_t n;
+    while ((n = io::read(out[1], buf, sizeof(buf))) > 0) {
+      for (ssize_t i = 0; i < n; ++i) {
+        intact &= buf[i] == static_cast<char>((got + i) % 251);
+      }
+      got += n;
+    }
+  });
+
+  std::vector<char> data(k_bytes);
+  for (ssize_t i = 0; i < k_bytes; ++i) data[i] = static_cast<char>(i % 251);
+  for (ssize_t sent = 0; sent < k_bytes;) {
+    auto n = io::write(in[0], data.data() + sent, k_bytes - sent);
+    ASSERT_GT(n, 0);
+    sent += n;
+  }
+  shutdown(in[0], SHUT_WR);
+  relay.join();
+  reader.join();
+
+  EXPECT_EQ(relayed, k_bytes);
+  EXPECT_EQ(got, k_bytes);
+  EXPECT_TRUE(intact);
+
+  for (auto fd : {in[0], in[1], out[0], out[1]}) close(fd);
+}
+
+TEST(gthread_io, readv_and_writev) {
+  int s[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, s), 0);
+
+  char hello[] = "hello, ", world[] = "world";
+  iovec out[] = {{hello, 7}, {world, 5}};
+  EXPECT_EQ(io::writev(s[0], out, 2), 12);
+
+  char a[4] = {}, b[9] = {};
+  iovec in[] = {{a, 3}, {b, 8}};
+  EXPECT_EQ(io::readv(s[1], in, 2), 11);
+  EXPECT_STREQ(a, "hel");
+  EXPECT_STREQ(b, "lo, worl");
+
+  close(s[0]);
+  close(s[1]);
+}
+
+TEST(gthread_io, buffer_chains) {
+  int s[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, s), 0);
+
+  // more than a buffer's worth goes out of several buffers at once
+  constexpr size_t k_bytes = io::k_buffer_capacity * 3 + 100;
+  std::vector<char> data(k_bytes);
+  for (size_t i = 0; i < k_bytes; ++i) data[i] = static_cast<char>(i % 251);
+  g writer([&]() {
+    io::buffer_chain out;
+    out.append(data.data(), data.size());
+    while (!out.empty()) ASSERT_GT(io::writev(s[0], out), 0);
+    EXPECT_EQ(out.length(), 1u);
+    shutdown(s[0], SHUT_WR);
+  });
+
+  // and comes in a buffer at a time, appended after what came before
+  io::buffer_chain in;
+  ssize_t n;
+  while ((n = io::readv(s[1], in)) > 0) {
+  }
+  EXPECT_EQ(n, 0);
+  writer.join();
+
+  ASSERT_EQ(in.size(), k_bytes);
+  std::vector<char> got;
+  for (auto& b : in) got.insert(got.end(), b.data(), b.data() + b.size());
+  EXPECT_EQ(got, data);
+
+  close(s[0]);
+  close(s[1]);
+}
+
+TEST(gthread_io, buffer_chain_reads_past_a_full_buffer) {
+  int p[2];
+  ASSERT_EQ(pipe(p), 0);
+
+  // a pool region's worth of full buffers, so the one the read adds is most
+  // likely from the next region
+  io::buffer_chain chain;
+  std::vector<char> fill(io::k_buffer_capacity * 64, 'x');
+  chain.append(fill.data(), fill.size());
+  ASSERT_EQ(chain.room(), 0u);
+
+  ASSERT_EQ(io::write(p[1], "hello", 5), 5);
+  EXPECT_EQ(io::readv(p[0], chain), 5);
+  EXPECT_EQ(chain.size(), fill.size() + 5);
+
+  std::string tail;
+  for (auto& b : chain) tail.assign(b.data(), b.size());
+  EXPECT_EQ(tail, "hello");
+
+  close(p[0]);
+  close(p[1]);
+}
+
+TEST(gthread_io, errors_set_errno) {
+  char c;
+  errno = 0;
+  EXPECT_EQ(io::read(-1, &c, 1), -1);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_EQ(io::fsync(-1), -1);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_EQ(io::pread(-1, &c, 1, 0), -1);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_THROW(io::set_queue_depth(0, 0), std::domain_error);
+}
@@ -1,11 +1,20 @@
 #include "platform/alarm.h"
 
+#include <cstdint>
+#include <cstdlib>
 #include <ctime>
 #include <system_error>
 
 #include <signal.h>
 #include <sys/time.h>
 
+#if defined(__linux__)
+#include <link.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
 #include "util/compiler.h"
 
 namespace gthread {
@@ -21,6 +30,47 @@ constexpr auto TIMER_TYPE = ITIMER_PROF;
 constexpr auto SIGNAL_TYPE = SIGPROF;
 
 namespace {
+#if defined(__linux__)
+// the bounds of the c library's code, found when the signal is first set
+uintptr_t g_libc_text_begin = 0;
+uintptr_t g_libc_text_end = 0;
+
+int find_libc_text(struct dl_phdr_info* info, size_t, void*) {
+  auto malloc_addr = reinterpret_cast<uintptr_t>(&::malloc);
+
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const auto& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X)) continue;
+
+    auto begin = info->dlpi_addr + phdr.p_vaddr;
+    auto end = begin + phdr.p_memsz;
+    if (malloc_addr < begin || malloc_addr >= end) continue;
+
+    // a statically linked c library is part of the executable, which can't be
+    // told apart from user code this way
+    if (info->dlpi_name != nullptr && info->dlpi_name[0] != '\0') {
+      g_libc_text_begin = begin;
+      g_libc_text_end = end;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * the c library takes locks (e.g. in `malloc()`) that the trap, or whatever it
+ * switches to on this kernel-managed thread, may need again. so the trap isn't
+ * sprung while the interrupted code is in there.
+ */
+bool interrupted_libc(void* ucontext) {
+  auto* uc = static_cast<ucontext_t*>(ucontext);
+  auto pc = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+  return pc >= g_libc_text_begin && pc < g_libc_text_end;
+}
+#else
+bool interrupted_libc(void* ucontext) { return false; }
+#endif
+
 void set_interval_internal(std::chrono::microseconds usec) {
   struct itimerval itval;
 
@@ -45,16 +95,46 @@ void alarm::clear_interval() {
   set_interval_impl(std::chrono::microseconds{0});
 }
 
+alarm::thread_id alarm::current_thread() {
+#if defined(__linux__)
+  return static_cast<thread_id>(syscall(SYS_gettid));
+#else
+  return 0;
+#endif
+}
+
+void alarm::ring(thread_id thread) {
+  // without a handler, the signal would kill the process
+  if (!_trap) return;
+
+#if defined(__linux__)
+  syscall(SYS_tgkill, getpid(), thread, SIGNAL_TYPE);
+#endif
+}
+
 /**
  * signal handler for `SIGNAL_TYPE` alarms
  */
-void alarm::alarm_handler(int signum) {
+void alarm::alarm_handler(int signum, siginfo_t*, void* ucontext) {
+  if (interrupted_libc(ucontext)) return;
+
   sigset_t sigset;
+  sigemptyset(&sigset);
   sigaddset(&sigset, SIGNAL_TYPE);
   sigprocmask(SIG_UNBLOCK, &sigset, NULL);
 
   if (_trap) _trap();
 }
 
-void alarm::set_signal() { signal(SIGNAL_TYPE, &alarm::alarm_handler); }
+void alarm::set_signal() {
+#if defined(__linux__)
+  dl_iterate_phdr(find_libc_text, nullptr);
+#endif
+
+  struct sigaction action = {};
+  action.sa_sigaction = &alarm::alarm_handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGNAL_TYPE, &action, nullptr);
+}
 }  // namespace gthread
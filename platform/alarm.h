@@ -3,6 +3,9 @@
 #include <chrono>
 #include <functional>
 
+#include <signal.h>
+#include <sys/types.h>
+
 #include "platform/clock.h"
 
 namespace gthread {
@@ -34,10 +37,28 @@ class alarm {
   template <typename Function>
   static void set_trap(Function&& f);
 
+  /**
+   * identifies a kernel-managed thread to `ring()`. `pthread_self()` can't be
+   * used since tasks repurpose the thread pointer.
+   */
+  using thread_id = pid_t;
+
+  /**
+   * returns the id of the calling kernel-managed thread
+   */
+  static thread_id current_thread();
+
+  /**
+   * springs the trap on |thread| as soon as it can be, without waiting for the
+   * interval to elapse. does nothing if no trap is set or if the platform
+   * can't signal a single kernel-managed thread.
+   */
+  static void ring(thread_id thread);
+
  private:
   static void set_interval_impl(std::chrono::microseconds);
 
-  static void alarm_handler(int signum);
+  static void alarm_handler(int signum, siginfo_t* info, void* ucontext);
   static void set_signal();
 
   static std::function<void()> _trap;
@@ -1,7 +1,9 @@
 #include "platform/alarm.h"
 
+#include <atomic>
 #include <cassert>
 #include <iostream>
+#include <thread>
 
 #include <sched.h>
 
@@ -59,3 +61,26 @@ TEST(gthread_alarm, several_intervals) {
     ;
   EXPECT_EQ(cur_traps, g_traps);
 }
+
+TEST(gthread_alarm, ring_springs_trap_on_thread) {
+  alarm::set_trap(trap);
+  alarm::clear_interval();
+
+  // the trap isn't sprung while this thread is in the c library, so the
+  // other thread keeps ringing until this one sees it outside of there
+  int cur_traps = g_traps;
+  g_last = thread_clock::now();
+  std::atomic<bool> gave_up{false};
+  std::thread ringer([&, target = alarm::current_thread()]() {
+    for (int i = 0; i < 1000 && g_traps == cur_traps; ++i) {
+      alarm::ring(target);
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    gave_up.store(true);
+  });
+
+  while (g_traps == cur_traps && !gave_up.load())
+    ;
+  ringer.join();
+  EXPECT_GT(g_traps, cur_traps);
+}
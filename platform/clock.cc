@@ -1,13 +1,23 @@
 #include "platform/clock.h"
 
 #include <cerrno>
+#include <cstdint>
 #include <ctime>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
 #include "util/compiler.h"
 
 namespace gthread {
 
 namespace {
+// 128-bit intermediates for the tick scaling (a gcc/clang extension)
+__extension__ typedef __int128 int128;
+__extension__ typedef unsigned __int128 uint128;
+
 uint64_t posix_time_from_type(clockid_t c) {
   struct timespec t;
   clock_gettime(c, &t);
@@ -19,6 +29,75 @@ uint64_t posix_time_resolution_from_type(clockid_t c) {
   clock_getres(c, &t);
   return t.tv_sec * 1000 * 1000 * 1000 + t.tv_nsec;
 }
+bool has_invariant_tsc() {
+#if defined(__x86_64__)
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return edx & (1u << 8);
+#else
+  return false;
+#endif
+}
+
+uint64_t read_tsc() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * maps timestamp counter ticks onto `std::chrono::steady_clock` time
+ */
+struct tsc_calibration {
+  bool invariant;
+
+  // a tick and the time it was read at
+  uint64_t base_tsc;
+  int64_t base_ns;
+
+  // nanoseconds per tick in 32.32 fixed point
+  uint64_t ns_per_tick;
+};
+
+/**
+ * how long the timestamp counter is measured against the steady clock. the
+ * error in the rate is about the steady clock's resolution over this.
+ */
+constexpr auto k_calibration_time = std::chrono::milliseconds{10};
+
+tsc_calibration calibrate() {
+  using steady = std::chrono::steady_clock;
+
+  tsc_calibration c{has_invariant_tsc(), 0, 0, 0};
+  if (!c.invariant) return c;
+
+  auto start = steady::now();
+  auto start_tsc = read_tsc();
+  auto end = start;
+  while ((end = steady::now()) - start < k_calibration_time) {
+  }
+  auto end_tsc = read_tsc();
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+  c.base_tsc = end_tsc;
+  c.base_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  end.time_since_epoch())
+                  .count();
+  c.ns_per_tick = static_cast<uint64_t>(
+      (static_cast<uint128>(ns.count()) << 32) /
+      (end_tsc - start_tsc));
+  return c;
+}
+
+const tsc_calibration& tsc() {
+  static const auto c = calibrate();
+  return c;
+}
 }  // namespace
 
 thread_clock::time_point thread_clock::now() noexcept {
@@ -31,4 +110,22 @@ thread_clock::duration thread_clock::resolution() noexcept {
       posix_time_resolution_from_type(CLOCK_THREAD_CPUTIME_ID)};
 }
 
+tsc_clock::time_point tsc_clock::now() noexcept {
+  const auto& c = tsc();
+  if (branch_unexpected(!c.invariant)) {
+    return time_point{std::chrono::duration_cast<duration>(
+        std::chrono::steady_clock::now().time_since_epoch())};
+  }
+
+  // another kernel-managed thread may have read the base tick a hair after
+  // this one reads its own, so the difference is signed
+  auto ticks = static_cast<int64_t>(read_tsc() - c.base_tsc);
+  auto ns = static_cast<int64_t>(
+      (static_cast<int128>(ticks) * static_cast<int128>(c.ns_per_tick)) >>
+      32);
+  return time_point{duration{c.base_ns + ns}};
+}
+
+bool tsc_clock::is_invariant() noexcept { return tsc().invariant; }
+
 }  // namespace gthread
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <ratio>
 
 namespace gthread {
@@ -24,4 +25,33 @@ class thread_clock {
   static time_point now() noexcept;
   static duration resolution() noexcept;
 };
+
+/**
+ * time read from the invariant timestamp counter, calibrated against (and
+ * with the same epoch as) `std::chrono::steady_clock`. reading it takes a
+ * few cycles, where `thread_clock` takes a syscall, but it keeps counting
+ * while the kernel-managed thread is descheduled.
+ *
+ * falls back to `std::chrono::steady_clock` if the processor's timestamp
+ * counter doesn't tick at a constant rate across power states.
+ */
+class tsc_clock {
+ public:
+  using rep = int64_t;
+  using period = std::nano;
+  using duration = std::chrono::nanoseconds;
+
+  using time_point = std::chrono::time_point<tsc_clock>;
+
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept;
+
+  /**
+   * whether `now()` reads the timestamp counter rather than falling back.
+   * calibrates the clock if it hasn't been already, which takes a few
+   * milliseconds.
+   */
+  static bool is_invariant() noexcept;
+};
 }  // namespace gthread
@@ -50,3 +50,62 @@ TEST(gthread_clock, thread_clock_no_drift) {
   }
   EXPECT_GE(thread_clock::now() - last, acc);
 }
+
+TEST(gthread_clock, tsc_clock_tracks_steady_clock) {
+  using namespace gthread;
+  using steady = std::chrono::steady_clock;
+
+  std::cout << "tsc_clock::is_invariant() => " << tsc_clock::is_invariant()
+            << std::endl;
+
+  // the clocks share an epoch, and agree to well within a percent over a
+  // longer span than calibration took
+  auto tsc_start = tsc_clock::now();
+  auto steady_start = steady::now();
+  EXPECT_LT(std::chrono::abs(tsc_start.time_since_epoch() -
+                             steady_start.time_since_epoch()),
+            milliseconds{1});
+
+  sleep_for(milliseconds{100});
+  float_sec tsc_elapsed = tsc_clock::now() - tsc_start;
+  float_sec steady_elapsed = steady::now() - steady_start;
+  EXPECT_NEAR(tsc_elapsed.count(), steady_elapsed.count(),
+              steady_elapsed.count() / 200);
+}
+
+TEST(gthread_clock, tsc_clock_is_monotonic) {
+  using namespace gthread;
+  auto last = tsc_clock::now();
+  for (int i = 0; i < 1000000; ++i) {
+    auto t = tsc_clock::now();
+    ASSERT_GE(t, last);
+    last = t;
+  }
+}
+
+/**
+ * reports how long reading |Clock| takes
+ */
+template <typename Clock>
+std::chrono::nanoseconds time_to_read() {
+  constexpr int k_reads = 100000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < k_reads; ++i) {
+    auto t = Clock::now();
+    asm volatile("" : : "r"(&t) : "memory");
+  }
+  return (std::chrono::steady_clock::now() - start) / k_reads;
+}
+
+TEST(gthread_clock, tsc_clock_is_cheaper_than_thread_clock) {
+  using namespace gthread;
+  // `tsc_clock` falls back to the steady clock, which may be no cheaper
+  if (!tsc_clock::is_invariant()) return;
+
+  auto tsc = time_to_read<tsc_clock>();
+  auto thread = time_to_read<thread_clock>();
+  std::cout << "tsc_clock::now() => " << tsc.count() << "ns, "
+            << "thread_clock::now() => " << thread.count() << "ns"
+            << std::endl;
+  EXPECT_LT(tsc, thread);
+}
@@ -3,7 +3,7 @@
 namespace gthread {
 void* tls::current_thread() {
   register void* thread __asm__("rax");
-  __asm__("mov %%fs:%P1, %0" : "=r"(thread) : "i"(16));
+  __asm__("mov %%fs:%P1, %0" : "=r"(thread) : "i"(56));
   return thread;
 }
 }  // namespace gthread
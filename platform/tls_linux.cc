@@ -34,23 +34,34 @@ struct tcbhead {
   void* self;
   dtv* thread_vector;  // maintain compatability with glibc. for our purposes,
                        // the `dtv` will be immediately after the `tcbhead`.
-  void* thread;
-
-  // `__ctype_init()` must be called upon entry to a new tls context
-  char did_ctype_init;
 
-  char padding_a[7];
+  // glibc's `struct pthread*` for the thread, which it reaches through once
+  // the process has more than one kernel-managed thread. it must always point
+  // at a tcb (for our tcbs, this one).
+  void* pthread_self;
+  int multiple_threads;
+  int gscope_flag;
 
   // more glibc required MAGIC
   void* sysinfo;
   void* stack_guard;
   void* pointer_guard;
 
-  char padding_b[1632];  // yes glibc's pthread_t is horrifically large
+  // glibc leaves these two slots unused
+  void* thread;
+  // `__ctype_init()` must be called upon entry to a new tls context
+  char did_ctype_init;
+
+  char padding_a[7];
+
+  char padding_b[1616];  // yes glibc's pthread_t is horrifically large
 
   size_t glibc_stack_size;
 };
 
+static_assert(offsetof(tcbhead, thread) == 56,
+              "`tls::current_thread()` reads the thread at %fs:56");
+
 // this is how glibc detects unallocated slots for dynamic loading
 #define TLS_DTV_UNALLOCATED ((void*)-1l)
 
@@ -138,6 +149,8 @@ tls_image* find_tls_images() {
 tls::tls() {
   tcbhead* tcb = (tcbhead*)after();
   tcb->self = tcb;
+  tcb->pthread_self = tcb;
+  tcb->multiple_threads = 1;
 
   dtv* thread_vector = new dtv[k_num_slots + 2];
   tcb->thread_vector = thread_vector;
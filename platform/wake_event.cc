@@ -0,0 +1,81 @@
+#include "platform/wake_event.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "util/compiler.h"
+#include "util/log.h"
+
+namespace gthread {
+void wake_event::prepare_wait() {
+  _state.store(k_waiting, std::memory_order_relaxed);
+
+  // orders the store before the waiter's reads of whatever it checks next. a
+  // waker does the mirror image in `notify()`, so at least one of them sees
+  // the other's write.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool wake_event::notify() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (branch_expected(_state.load(std::memory_order_relaxed) != k_waiting)) {
+    return false;
+  }
+
+  uint32_t expected = k_waiting;
+  if (!_state.compare_exchange_strong(expected, k_notified)) return false;
+
+#if defined(__linux__)
+  syscall(SYS_futex, &_state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+  return true;
+}
+
+#if defined(__linux__)
+void wake_event::wait_for(std::chrono::nanoseconds timeout) {
+  struct timespec ts;
+  struct timespec* tsp = nullptr;
+  if (timeout >= std::chrono::nanoseconds::zero()) {
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    ts.tv_sec = secs.count();
+    ts.tv_nsec = (timeout - secs).count();
+    tsp = &ts;
+  }
+
+  // a signal (like the preemption alarm) ends the wait early. that looks like
+  // a spurious wakeup, which callers already handle by checking again.
+  if (syscall(SYS_futex, &_state, FUTEX_WAIT_PRIVATE, k_waiting, tsp, nullptr,
+              0) != 0 &&
+      branch_unexpected(errno != EAGAIN && errno != ETIMEDOUT &&
+                        errno != EINTR)) {
+    gthread_log_fatal("futex wait failed");
+  }
+}
+#else
+void wake_event::wait_for(std::chrono::nanoseconds timeout) {
+  // without a futex, poll for `notify()` in short naps
+  constexpr auto k_nap = std::chrono::milliseconds{1};
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (_state.load(std::memory_order_relaxed) == k_waiting) {
+    if (timeout < std::chrono::nanoseconds::zero()) {
+      std::this_thread::sleep_for(k_nap);
+      continue;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) break;
+    std::this_thread::sleep_for(
+        std::min<std::chrono::steady_clock::duration>(deadline - now, k_nap));
+  }
+}
+#endif
+}  // namespace gthread
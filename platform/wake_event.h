@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace gthread {
+/**
+ * blocks a kernel-managed thread until another one wakes it up (or a deadline
+ * passes) without burning cpu while it waits
+ *
+ * waking is cheap when nothing is waiting. to not miss a wakeup, a waiter
+ * must call `prepare_wait()` *before* it last checks whether it has anything to
+ * do, and a waker must publish whatever it wants the waiter to see *before*
+ * calling `notify()`:
+ *
+ *   e.prepare_wait();
+ *   if (have_work()) {
+ *     e.cancel_wait();
+ *   } else {
+ *     e.wait_until(deadline);
+ *   }
+ */
+class wake_event {
+ public:
+  wake_event() : _state(k_awake) {}
+
+  wake_event(const wake_event&) = delete;
+  wake_event& operator=(const wake_event&) = delete;
+
+  /**
+   * announces that the calling thread is about to wait
+   */
+  void prepare_wait();
+
+  /**
+   * withdraws a `prepare_wait()` that isn't followed by `wait_until()`
+   */
+  void cancel_wait() { _state.store(k_awake, std::memory_order_relaxed); }
+
+  /**
+   * blocks until `notify()` is called or |deadline| passes. returns at once if
+   * `notify()` was called since `prepare_wait()`.
+   */
+  template <typename Clock, typename Duration>
+  void wait_until(const std::chrono::time_point<Clock, Duration>& deadline);
+
+  /**
+   * wakes the waiting thread. returns true if a thread was waiting (or about
+   * to) and false if there was nothing to do. may be called from any
+   * kernel-managed thread.
+   */
+  bool notify();
+
+  /**
+   * true between `prepare_wait()` and the end of the wait
+   */
+  bool waiting() const {
+    return _state.load(std::memory_order_relaxed) == k_waiting;
+  }
+
+ private:
+  enum : uint32_t { k_awake, k_waiting, k_notified };
+
+  /**
+   * blocks for at most |timeout| while `_state` is `k_waiting`. a negative
+   * |timeout| waits indefinitely.
+   */
+  void wait_for(std::chrono::nanoseconds timeout);
+
+  // a futex word where the platform has them
+  std::atomic<uint32_t> _state;
+};
+}  // namespace gthread
+
+#include "platform/wake_event_impl.h"
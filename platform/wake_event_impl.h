@@ -0,0 +1,19 @@
+#pragma once
+
+#include "platform/wake_event.h"
+
+namespace gthread {
+template <typename Clock, typename Duration>
+void wake_event::wait_until(
+    const std::chrono::time_point<Clock, Duration>& deadline) {
+  if (deadline == std::chrono::time_point<Clock, Duration>::max()) {
+    wait_for(std::chrono::nanoseconds{-1});
+  } else {
+    auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline - Clock::now());
+    if (timeout > std::chrono::nanoseconds::zero()) wait_for(timeout);
+  }
+
+  _state.store(k_awake, std::memory_order_relaxed);
+}
+}  // namespace gthread
@@ -0,0 +1,63 @@
+#include "platform/wake_event.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using namespace gthread;
+using clock_type = std::chrono::steady_clock;
+
+TEST(gthread_wake_event, times_out) {
+  wake_event e;
+  auto start = clock_type::now();
+  e.prepare_wait();
+  e.wait_until(start + std::chrono::milliseconds{20});
+  EXPECT_GE(clock_type::now() - start, std::chrono::milliseconds{20});
+  EXPECT_FALSE(e.waiting());
+}
+
+TEST(gthread_wake_event, notify_without_waiter_does_nothing) {
+  wake_event e;
+  EXPECT_FALSE(e.notify());
+  EXPECT_FALSE(e.waiting());
+}
+
+TEST(gthread_wake_event, notify_after_prepare_is_not_lost) {
+  wake_event e;
+  e.prepare_wait();
+  EXPECT_TRUE(e.waiting());
+  EXPECT_TRUE(e.notify());
+
+  // returns at once even though the notify came before the wait
+  auto start = clock_type::now();
+  e.wait_until(clock_type::time_point::max());
+  EXPECT_LT(clock_type::now() - start, std::chrono::seconds{1});
+}
+
+TEST(gthread_wake_event, wakes_waiting_thread) {
+  wake_event e;
+  std::atomic<bool> ready{false}, woken{false};
+
+  std::thread waiter([&]() {
+    e.prepare_wait();
+    ready = true;
+    e.wait_until(clock_type::time_point::max());
+    woken = true;
+  });
+
+  while (!ready) std::this_thread::yield();
+
+  // the waiter is blocked rather than spinning, so the process uses (almost)
+  // no cpu time while it waits
+  auto cpu_start = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  EXPECT_LT(std::clock() - cpu_start, CLOCKS_PER_SEC / 100);
+  EXPECT_FALSE(woken);
+
+  EXPECT_TRUE(e.notify());
+  waiter.join();
+  EXPECT_TRUE(woken);
+}
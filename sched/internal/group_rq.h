@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+
+#include "sched/task.h"
+#include "util/rb_tree.h"
+
+namespace gthread {
+namespace internal {
+struct group_rq;
+
+/**
+ * stands in for a `sched_group` in its parent's queue on one node. it is
+ * charged for the time its group's tasks run there and is queued whenever one
+ * of them is runnable there.
+ */
+struct group_entity {
+  rb_node rq_node;
+  std::chrono::nanoseconds vruntime;
+
+  // whether `rq_node` is linked into the parent's queue
+  bool queued;
+
+  // the queue of the group this stands in for
+  group_rq* q;
+};
+
+/**
+ * the runnable tasks and child groups at one level of the group hierarchy on
+ * one node, each ordered by vruntime
+ */
+struct group_rq {
+  struct task_compare {
+    constexpr bool operator()(const task* a, const task* b) const {
+      return a->vruntime < b->vruntime;
+    }
+  };
+  rb_tree<task, &task::rq_node, task_compare> tasks;
+
+  struct entity_compare {
+    constexpr bool operator()(const group_entity* a,
+                              const group_entity* b) const {
+      return a->vruntime < b->vruntime;
+    }
+  };
+  rb_tree<group_entity, &group_entity::rq_node, entity_compare> children;
+
+  /**
+   * never moves backwards. tasks and groups that become runnable start here
+   * so that they are neither starved nor favored.
+   */
+  std::chrono::nanoseconds min_vruntime{0};
+
+  bool empty() const { return tasks.empty() && children.empty(); }
+};
+
+/**
+ * a `sched_group`'s state on one node
+ */
+struct group_slot {
+  group_slot() : se{{}, std::chrono::nanoseconds{0}, false, &q}, q() {}
+
+  group_slot(const group_slot&) = delete;
+  group_slot& operator=(const group_slot&) = delete;
+
+  group_entity se;
+  group_rq q;
+};
+}  // namespace internal
+}  // namespace gthread
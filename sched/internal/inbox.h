@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "sched/task.h"
+
+namespace gthread {
+namespace internal {
+/**
+ * tasks handed to a node by other kernel-managed threads, linked through
+ * `task::inbox_next`. any number of threads may push without a lock, and the
+ * node takes everything at once, so there is no ABA to guard against. both
+ * are sequentially consistent, so a flag the pusher sets afterwards (or the
+ * node clears beforehand) can't be seen out of order with them.
+ */
+class inbox {
+ public:
+  inbox() : _head(nullptr), _size(0) {}
+
+  /**
+   * pushes the |n| tasks linked from |first| to |last|, as if |last| were
+   * pushed first. returns whether the inbox was empty, i.e. whether the
+   * caller is the one to tell the node.
+   */
+  bool push(task* first, task* last, size_t n) {
+    _size.fetch_add(n, std::memory_order_relaxed);
+    auto* head = _head.load(std::memory_order_relaxed);
+    do {
+      last->inbox_next = head;
+    } while (!_head.compare_exchange_weak(head, first));
+    return head == nullptr;
+  }
+
+  /**
+   * empties the inbox and returns its tasks, linked in the order they were
+   * pushed. must only be called by the node.
+   */
+  task* take_all() {
+    auto* t = _head.exchange(nullptr);
+    if (t == nullptr) return nullptr;
+
+    // pushes come out newest first
+    task* reversed = nullptr;
+    size_t n = 0;
+    while (t != nullptr) {
+      auto* next = t->inbox_next;
+      t->inbox_next = reversed;
+      reversed = t;
+      t = next;
+      ++n;
+    }
+    _size.fetch_sub(n, std::memory_order_relaxed);
+    return reversed;
+  }
+
+  bool empty() const { return _head.load() == nullptr; }
+
+  /**
+   * the number of tasks waiting. may be read from any kernel-managed thread
+   * (the value is only a hint then).
+   */
+  unsigned size() const {
+    return static_cast<unsigned>(_size.load(std::memory_order_relaxed));
+  }
+
+ private:
+  std::atomic<task*> _head;
+  std::atomic<size_t> _size;
+};
+}  // namespace internal
+}  // namespace gthread
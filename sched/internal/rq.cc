@@ -1,19 +1,215 @@
 #include "sched/internal/rq.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "util/log.h"
 
 namespace gthread {
 namespace internal {
-void rq::push(task* t) { _runqueue.emplace(t); }
+namespace {
+std::chrono::nanoseconds weighted(std::chrono::nanoseconds ran,
+                                  uint32_t weight) {
+  return ran * task::k_nice_0_weight / weight;
+}
+}  // namespace
+
+bool rq::replenish(task* t) {
+  auto now = task::deadline_clock::now();
+  auto left = t->dl_period_end - now;
+  if (left <= std::chrono::nanoseconds::zero() ||
+      static_cast<double>(t->dl_budget.count()) * t->dl_deadline.count() >
+          static_cast<double>(t->dl_runtime.count()) *
+              std::chrono::duration_cast<std::chrono::nanoseconds>(left)
+                  .count()) {
+    t->dl_period_end = now + t->dl_deadline;
+    t->dl_budget = t->dl_runtime;
+  }
+  return t->dl_budget > std::chrono::nanoseconds::zero();
+}
+
+void rq::push(task* t) {
+  t->runnable_since = tsc_clock::now();
+
+  if (t->is_deadline() && replenish(t)) {
+    _deadline_queue.insert(t);
+    count(t, 1);
+    return;
+  }
+
+  auto* q = queue_of(t->group);
+
+  // a deadline task out of runtime didn't accrue vruntime in step with the
+  // fair tasks, so it is placed like a task that was sleeping
+  if (t->is_deadline()) t->vruntime = std::max(t->vruntime, q->min_vruntime);
+  q->tasks.insert(t);
+
+  // a group that had nothing runnable here joins its parent's queue. like a
+  // task that was sleeping, it comes back no earlier than the parent's
+  // `min_vruntime`, so it can't make up for the time it had nothing to run.
+  for (auto* g = t->group; g != nullptr; g = g->parent()) {
+    auto& se = g->slot(_node_index).se;
+    if (se.queued) break;
+
+    auto* parent_q = queue_of(g->parent());
+    se.vruntime = std::max(se.vruntime, parent_q->min_vruntime);
+    parent_q->children.insert(&se);
+    se.queued = true;
+  }
+
+  count(t, 1);
+}
+
+void rq::erase(task* t) {
+  queue_of(t->group)->tasks.erase(t);
+
+  for (auto* g = t->group; g != nullptr; g = g->parent()) {
+    auto& slot = g->slot(_node_index);
+    if (!slot.q.empty()) break;
+
+    queue_of(g->parent())->children.erase(&slot.se);
+    slot.se.queued = false;
+  }
+
+  count(t, -1);
+}
 
 void rq::sleep_push(task* t, sleepqueue_clock::duration sleep_duration) {
   auto earliest_wake_time = sleepqueue_clock::now() + sleep_duration;
-  auto* cur = task::current();
 
-  cur->run_state = task::WAITING;
-  _sleepqueue.push(earliest_wake_time, cur);
+  t->run_state = task::WAITING;
+  _sleepqueue.insert(t, earliest_wake_time);
+  _sleepers.store(_sleepqueue.size(), std::memory_order_relaxed);
+}
+
+task* rq::try_pop() {
+  // move every sleeper whose timer has expired to the runqueue
+  if (!_sleepqueue.empty()) {
+    uint64_t woken = 0;
+    _sleepqueue.expire(sleepqueue_clock::now(), [this, &woken](task* sleeper) {
+      push(sleeper);
+      ++woken;
+    });
+    _sleepers.store(_sleepqueue.size(), std::memory_order_relaxed);
+    _timer_wakeups.store(
+        _timer_wakeups.load(std::memory_order_relaxed) + woken,
+        std::memory_order_relaxed);
+  }
+  _next_wake_time = _sleepqueue.next_ripe();
+
+  if (!_deadline_queue.empty()) {
+    auto* t = _deadline_queue.first();
+    _deadline_queue.erase(t);
+    count(t, -1);
+    record_latency(t);
+    return t;
+  }
+
+  if (_top.empty()) return nullptr;
+
+  // descend to the task with the minimum vruntime in the group (or top-level
+  // queue) with the minimum vruntime. since whatever is picked at each level
+  // a priori has the minimum vruntime there, and new tasks and groups must
+  // start with a reasonable vruntime, advance that level's `min_vruntime`.
+  auto* q = &_top;
+  while (true) {
+    auto* t = q->tasks.first();
+    auto* se = q->children.first();
+    if (se != nullptr && (t == nullptr || se->vruntime < t->vruntime)) {
+      q->min_vruntime = std::max(q->min_vruntime, se->vruntime);
+      q = se->q;
+      continue;
+    }
+
+    assert(t != nullptr && "a queued group has nothing runnable");
+    q->min_vruntime = std::max(q->min_vruntime, t->vruntime);
+    erase(t);
+    record_latency(t);
+    return t;
+  }
+}
+
+void rq::run_directly(const task* t) {
+  if (t->is_deadline() && t->dl_budget > std::chrono::nanoseconds::zero()) {
+    return;
+  }
+
+  // like `try_pop()`, but no level's minimum may pass what is still queued
+  // there
+  auto advance = [](group_rq* q, std::chrono::nanoseconds vruntime) {
+    if (auto* first = q->tasks.first()) {
+      vruntime = std::min(vruntime, first->vruntime);
+    }
+    if (auto* first = q->children.first()) {
+      vruntime = std::min(vruntime, first->vruntime);
+    }
+    q->min_vruntime = std::max(q->min_vruntime, vruntime);
+  };
+
+  advance(queue_of(t->group), t->vruntime);
+  for (auto* g = t->group; g != nullptr; g = g->parent()) {
+    advance(queue_of(g->parent()), g->slot(_node_index).se.vruntime);
+  }
+}
+
+bool rq::preempts(const task* curr, const task* t,
+                  std::chrono::nanoseconds granularity) {
+  auto in_deadline_class = [](const task* t) {
+    return t->is_deadline() && t->dl_budget > std::chrono::nanoseconds::zero();
+  };
+  if (in_deadline_class(curr)) {
+    return in_deadline_class(t) && t->dl_period_end < curr->dl_period_end;
+  }
+  if (in_deadline_class(t)) return true;
+
+  auto depth = [](sched_group* g) {
+    unsigned d = 0;
+    for (; g != nullptr; g = g->parent()) ++d;
+    return d;
+  };
+
+  // stand in for a task or group with its group until both are in the same
+  // queue
+  struct entity {
+    sched_group* g;
+    std::chrono::nanoseconds vruntime;
+    unsigned depth;
+  };
+  entity c{curr->group, curr->vruntime, depth(curr->group)};
+  entity n{t->group, t->vruntime, depth(t->group)};
+  auto up = [this](entity& e) {
+    e.vruntime = e.g->slot(_node_index).se.vruntime;
+    e.g = e.g->parent();
+    --e.depth;
+  };
+
+  while (c.depth > n.depth) up(c);
+  while (n.depth > c.depth) up(n);
+  while (c.g != n.g) {
+    up(c);
+    up(n);
+  }
+
+  return c.vruntime - n.vruntime > granularity;
+}
+
+void rq::charge(task* t, std::chrono::nanoseconds ran) {
+  if (t->is_deadline()) t->dl_budget -= ran;
+  t->vruntime += weighted(ran, t->weight);
+
+  // groups that are queued have to be relinked to move to their new place
+  for (auto* g = t->group; g != nullptr; g = g->parent()) {
+    auto& se = g->slot(_node_index).se;
+    if (!se.queued) {
+      se.vruntime += weighted(ran, g->weight());
+      continue;
+    }
+
+    auto& siblings = queue_of(g->parent())->children;
+    siblings.erase(&se);
+    se.vruntime += weighted(ran, g->weight());
+    siblings.insert(&se);
+  }
 }
 }  // namespace internal
 }  // namespace gthread
@@ -1,46 +1,248 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <set>
+#include <cstdint>
 
-#include "sched/internal/time_ordered_queue.h"
+#include "sched/internal/group_rq.h"
+#include "sched/sched_group.h"
+#include "platform/clock.h"
 #include "sched/task.h"
+#include "util/log_histogram.h"
+#include "util/timing_wheel.h"
 
 namespace gthread {
 namespace internal {
+/**
+ * a node's runnable and sleeping tasks. runnable tasks are kept in the queue
+ * of their `sched_group` (or the top-level queue), and each group that has
+ * any is queued in its parent's as one entity with a vruntime of its own.
+ */
 class rq {
  public:
+  /**
+   * |node_index| picks out the state groups keep for this node
+   */
+  explicit rq(unsigned node_index = 0) : _node_index(node_index) {}
+
   void push(task* t);
 
   using sleepqueue_clock = std::chrono::system_clock;
 
   void sleep_push(task* t, sleepqueue_clock::duration sleep_duration);
 
+  /**
+   * pops a task, first moving any sleepers whose timers have expired onto the
+   * runqueue. returns nullptr if nothing is runnable.
+   *
+   * deadline tasks with runtime left come first, earliest deadline first.
+   * otherwise, starting from the top level, picks whichever fair task or
+   * group has the minimum vruntime, descending into groups until it reaches a
+   * task.
+   */
+  task* try_pop();
+
+  /**
+   * like `try_pop()` but calls |idle_thunk| with the next time a sleeper will
+   * be ready (or `sleepqueue_clock::time_point::max()` if there are no
+   * sleepers) until something is runnable
+   */
   template <typename Thunk>
   task* pop(const Thunk& idle_thunk);
 
-  std::chrono::microseconds min_vruntime() const {
-    return _min_vruntime.load();
+  /**
+   * removes and returns the runnable task with the maximum vruntime for which
+   * |pred| returns true (or nullptr if there is none), looking at groups with
+   * the maximum vruntime first. used to hand work to another node, which
+   * should take the task that would otherwise wait the longest to run here.
+   */
+  template <typename Pred>
+  task* steal_if(const Pred& pred);
+
+  /**
+   * adds |ran| of processor time to the vruntime of |t|, which must be
+   * running on this node, and of each group it is in, scaled by their
+   * weights. a deadline task's runtime for the period is used up too.
+   */
+  void charge(task* t, std::chrono::nanoseconds ran);
+
+  /**
+   * whether |t|, which was just pushed, should run right away instead of
+   * |curr|, which is running on this node. a deadline task with runtime left
+   * preempts a fair task or one whose period ends later. a fair task preempts
+   * another when its vruntime is more than |granularity| behind, comparing
+   * the groups they are in under the queue they have in common if they
+   * aren't in the same one.
+   */
+  bool preempts(const task* curr, const task* t,
+                std::chrono::nanoseconds granularity);
+
+  /**
+   * when the next sleeper will be ready as of the last `try_pop()` (or
+   * `sleepqueue_clock::time_point::max()` if there are no sleepers)
+   */
+  sleepqueue_clock::time_point next_wake_time() const {
+    return _next_wake_time;
+  }
+
+  /**
+   * the number of tasks on the runqueue. may be read without holding the lock
+   * guarding this `rq` (the value is only a hint then).
+   */
+  unsigned size() const { return _size.load(std::memory_order_relaxed); }
+
+  /**
+   * the most tasks there have been on the runqueue at once
+   */
+  unsigned max_size() const {
+    return _max_size.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * the number of sleeping tasks, and how many have been moved to the
+   * runqueue when their timers expired. may be read without holding the lock.
+   */
+  unsigned sleepers() const {
+    return _sleepers.load(std::memory_order_relaxed);
+  }
+  uint64_t timer_wakeups() const {
+    return _timer_wakeups.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * how long tasks waited between being pushed and being popped or stolen, in
+   * nanoseconds. like `size()`, may be read without holding the lock.
+   */
+  const log_histogram& latency() const { return _latency; }
+
+  /**
+   * the number of tasks on the runqueue without an affinity, which any node
+   * could take. like `size()`, may be read without holding the lock.
+   */
+  unsigned movable() const {
+    auto size = this->size();
+    auto pinned = _pinned.load(std::memory_order_relaxed);
+    return size > pinned ? size - pinned : 0;
+  }
+
+  /**
+   * advances the `min_vruntime`s along |t|'s groups as `try_pop()` would have
+   * for |t|, which is being run without being popped (e.g. handed off to).
+   * otherwise a task that only ever runs that way leaves them behind, and
+   * tasks that become runnable start so far below it that it is starved
+   * until they catch up.
+   */
+  void run_directly(const task* t);
+
+  /**
+   * the minimum vruntime of the queue |t| would be pushed to. a task moved
+   * here or spawned here starts relative to it.
+   */
+  std::chrono::nanoseconds min_vruntime(const task* t) {
+    return queue_of(t->group)->min_vruntime;
   }
 
  private:
+  /**
+   * the queue holding |g|'s runnable tasks and child groups on this node, or
+   * the top-level queue if |g| is nullptr
+   */
+  group_rq* queue_of(sched_group* g) {
+    return g == nullptr ? &_top : &g->slot(_node_index).q;
+  }
+
+  /**
+   * unlinks |t| from its queue, along with each of its groups that is left
+   * with nothing runnable on this node
+   */
+  void erase(task* t);
+
+  /**
+   * starts a new period for deadline task |t| if its last one is over, or if
+   * what it has left of its runtime would take more than its share of the
+   * time left in the period (the constant bandwidth server rule). returns
+   * whether |t| has runtime left to run in the deadline class.
+   */
+  bool replenish(task* t);
+
+  template <typename Pred>
+  task* find_last_if(group_rq* q, const Pred& pred);
+
+  /**
+   * counts how long |t| waited since it was pushed
+   */
+  void record_latency(const task* t) {
+    auto waited = tsc_clock::now() - t->runnable_since;
+    _latency.record(std::max<int64_t>(waited.count(), 0));
+  }
+
+  /**
+   * adds |delta| to the counts of runnable tasks that |t| is in
+   */
+  void count(const task* t, int delta) {
+    auto size = _size.load(std::memory_order_relaxed) + delta;
+    _size.store(size, std::memory_order_relaxed);
+    if (size > _max_size.load(std::memory_order_relaxed)) {
+      _max_size.store(size, std::memory_order_relaxed);
+    }
+    if (t->affinity.any()) {
+      _pinned.store(_pinned.load(std::memory_order_relaxed) + delta,
+                    std::memory_order_relaxed);
+    }
+  }
+
+  unsigned _node_index;
+
   /**
    * tasks that can be switched to with the expectation that they will make
-   * progress
+   * progress, and groups that have some
    *
-   * `std::multiset` is used because it usually is built on a pretty robust
-   * red-black tree, which has good performance for a runqueue
+   * the red-black trees are intrusive (linked through `task::rq_node` and
+   * `group_entity::rq_node`), so pushing and popping never allocate, even
+   * when called from the preemption trap
    */
-  struct time_ordered_compare {
+  group_rq _top;
+
+  /**
+   * deadline tasks with runtime left, ordered by when their periods end. they
+   * are linked through `task::rq_node` too, since a task is only ever in one
+   * of the queues.
+   */
+  struct deadline_compare {
     constexpr bool operator()(const task* a, const task* b) const {
-      return a->vruntime != b->vruntime ? a->vruntime < b->vruntime : a < b;
+      return a->dl_period_end < b->dl_period_end;
     }
   };
-  std::multiset<task*, time_ordered_compare> _runqueue;
+  rb_tree<task, &task::rq_node, deadline_compare> _deadline_queue;
+
+  /**
+   * sleeping tasks, keyed on when they wake up
+   *
+   * the timing wheel arms and disarms timers in constant time without
+   * allocating, and hands over every sleeper that is ripe in one pass
+   */
+  timing_wheel<task, &task::sleep_node, sleepqueue_clock> _sleepqueue;
+
+  // when the next sleeper is ripe (written by `try_pop()`)
+  sleepqueue_clock::time_point _next_wake_time;
+
+  // the number of runnable tasks in every queue. may be read by other nodes
+  // without holding the lock.
+  std::atomic<unsigned> _size{0};
+
+  // how many of those have an affinity
+  std::atomic<unsigned> _pinned{0};
+
+  // the high-water mark of `_size`
+  std::atomic<unsigned> _max_size{0};
 
-  time_ordered_queue<task*, sleepqueue_clock> _sleepqueue;
+  // mirrors `_sleepqueue.size()` for readers without the lock, and counts the
+  // sleepers it has handed over
+  std::atomic<unsigned> _sleepers{0};
+  std::atomic<uint64_t> _timer_wakeups{0};
 
-  std::atomic<std::chrono::microseconds> _min_vruntime;
+  log_histogram _latency;
 };
 }  // namespace internal
 }  // namespace gthread
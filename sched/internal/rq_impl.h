@@ -6,35 +6,51 @@ namespace gthread {
 namespace internal {
 template <typename Thunk>
 task* rq::pop(const Thunk& idle_thunk) {
-  // NOTE: it may be more cache efficient to bulk remove items from the
-  // sleepqueue
-  if (!_sleepqueue.empty()) {
-    sleepqueue_clock::time_point next_runnable{};
-    auto* sleeper = _sleepqueue.pop(&next_runnable);
-    if (sleeper != nullptr) {
-      _runqueue.emplace(sleeper);
-    } else if (_runqueue.empty()) {
-      // XXX: remove this if there other kinds of externally wakeable tasks
-      idle_thunk(next_runnable);
-      assert(sleepqueue_clock::now() >= next_runnable);
-      _runqueue.emplace(sleeper);
-    }
-  } else if (_runqueue.empty()) {
-    gthread_log_fatal("nothing to do. deadlock?");
+  task* next_task;
+  while ((next_task = try_pop()) == nullptr) {
+    idle_thunk(_next_wake_time);
   }
+  return next_task;
+}
 
-  auto begin = _runqueue.begin();
-  task* next_task = *begin;
-  _runqueue.erase(begin);
+template <typename Pred>
+task* rq::steal_if(const Pred& pred) {
+  auto* t = find_last_if(&_top, pred);
+  if (t != nullptr) {
+    erase(t);
+    record_latency(t);
+    return t;
+  }
 
-  // the task that was just popped from the `runqueue` a priori is the task
-  // with the minimum vruntime. since new tasks must start with a reasonable
-  // vruntime, update `min_vruntime`.
-  if (_min_vruntime.load() < next_task->vruntime) {
-    _min_vruntime.store(next_task->vruntime);
+  // a deadline task is only taken when there are no fair ones, and then the
+  // one that is due last
+  for (t = _deadline_queue.last(); t != nullptr; t = _deadline_queue.prev(t)) {
+    if (pred(t)) {
+      _deadline_queue.erase(t);
+      count(t, -1);
+      record_latency(t);
+      return t;
+    }
   }
+  return nullptr;
+}
 
-  return next_task;
+template <typename Pred>
+task* rq::find_last_if(group_rq* q, const Pred& pred) {
+  // walk the tasks and the groups of |q| backwards together, in order of
+  // vruntime
+  auto* t = q->tasks.last();
+  auto* se = q->children.last();
+  while (t != nullptr || se != nullptr) {
+    if (se != nullptr && (t == nullptr || se->vruntime >= t->vruntime)) {
+      if (auto* found = find_last_if(se->q, pred)) return found;
+      se = q->children.prev(se);
+    } else {
+      if (pred(t)) return t;
+      t = q->tasks.prev(t);
+    }
+  }
+  return nullptr;
 }
 }  // namespace internal
 }  // namespace gthread
@@ -5,63 +5,67 @@
 namespace gthread {
 namespace internal {
 namespace {
-template <typename Iterable>
-task* find_task(Iterable* iterable, const attr& a) {
-  for (auto i = iterable->begin(); i != iterable->end(); ++i) {
-    if (a.stack.size == (*i)->stack_size() && a.alloc_tls == (*i)->has_tls()) {
-      task* t = *i;
-      iterable->erase(i);
+template <typename Tree>
+task* find_task(Tree* tree, const attr& a) {
+  for (task* t = tree->first(); t != nullptr; t = tree->next(t)) {
+    if (a.stack.size == t->stack_size() && a.alloc_tls == t->has_tls()) {
+      tree->erase(t);
       return t;
     }
   }
 
   return nullptr;
 }
-
-template <typename Iterable>
-void insert_task(Iterable* iterable, task* t) {
-  auto i = iterable->begin();
-  for (; i != iterable->end(); ++i) {
-    if (t->stack_size() >= (*i)->stack_size() &&
-        (t->has_tls() || !(*i)->has_tls())) {
-      iterable->insert(i, t);
-      return;
-    }
-  }
-  iterable->insert(i, t);
-}
 }  // namespace
 
 using guard = std::lock_guard<std::mutex>;
 using unique_lock = std::unique_lock<std::mutex>;
 
 task* task_freelist::make_task(const attr& a) {
-  task* t = nullptr;
+  task* t;
+  make_tasks(a, &t, 1);
+  return t;
+}
+
+void task_freelist::make_tasks(const attr& a, task** tasks, size_t n) {
+  size_t reused = 0;
   {
     guard l(_mu);
-    if (_l.size() > 0) {
-      t = find_task(&_l, a);
+    while (reused < n && _l.size() > 0 &&
+           (tasks[reused] = find_task(&_l, a)) != nullptr) {
+      ++reused;
     }
   }
 
-  if (t != nullptr) {
-    t->reset();
-  } else {
-    t = task::create(a);
+  for (size_t i = 0; i < n; ++i) {
+    auto* t = tasks[i];
+    if (i < reused) {
+      t->reset();
+    } else {
+      t = tasks[i] = task::create(a);
+    }
+    t->set_nice(a.nice);
+    t->group = a.group;
+    t->dl_runtime = a.deadline.runtime;
+    t->dl_deadline = a.deadline.deadline;
+    t->affinity = a.affinity;
   }
-  return t;
 }
 
-void task_freelist::return_task(task* t) {
+void task_freelist::return_task(task* t) { return_tasks(&t, 1); }
+
+void task_freelist::return_tasks(task* const* tasks, size_t n) {
+  size_t kept = 0;
   {
     guard l(_mu);
-    if (_l.size() < _max_size) {
-      insert_task(&_l, t);
-      return;
+    for (; kept < n && _l.size() < _max_size; ++kept) {
+      _l.insert(tasks[kept]);
     }
   }
 
-  t->destroy();
+  for (size_t i = kept; i < n; ++i) {
+    tasks[i]->destroy();
+  }
 }
 }  // namespace internal
 }  // namespace gthread
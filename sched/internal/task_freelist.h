@@ -1,10 +1,11 @@
 #pragma once
 
-#include <list>
+#include <cstddef>
 #include <mutex>
 
 #include "sched/task.h"
 #include "sched/task_attr.h"
+#include "util/rb_tree.h"
 
 namespace gthread {
 namespace internal {
@@ -14,11 +15,35 @@ class task_freelist {
 
   task* make_task(const attr& a);
 
+  /**
+   * fills |tasks| with |n| tasks made for |a|, taking the lock once for all
+   * of the ones that can be reused
+   */
+  void make_tasks(const attr& a, task** tasks, size_t n);
+
   void return_task(task* t);
 
+  /**
+   * returns the |n| tasks in |tasks|, taking the lock once
+   */
+  void return_tasks(task* const* tasks, size_t n);
+
  private:
+  /**
+   * unused tasks are linked through `task::rq_node` (they can't be on a
+   * runqueue), so returning one from the scheduler never allocates. they are
+   * ordered by stack size and then by whether they have tls.
+   */
+  struct stack_compare {
+    bool operator()(const task* a, const task* b) const {
+      return a->stack_size() != b->stack_size()
+                 ? a->stack_size() < b->stack_size()
+                 : a->has_tls() < b->has_tls();
+    }
+  };
+
   std::mutex _mu;
-  std::list<task*> _l;
+  rb_tree<task, &task::rq_node, stack_compare> _l;
   unsigned _max_size;
 };
 }  // namespace internal
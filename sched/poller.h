@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+
+namespace gthread {
+/**
+ * I/O that a node waits for along with its runqueue (see `gthread::io`). the
+ * node's kernel-managed thread calls `poll()` each time it picks a task, and
+ * blocks in `wait_for()` instead of on its `wake_event` when it runs out of
+ * work. a node's poller lives as long as the node does, i.e. forever.
+ */
+class poller {
+ public:
+  virtual ~poller() {}
+
+  /**
+   * submits the I/O queued since the last call and, without blocking,
+   * schedules the tasks whose I/O has finished. only called by the node's
+   * kernel-managed thread, which may be in its scheduler or its trap, so it
+   * must not take the `preempt_mutex`.
+   */
+  virtual void poll() = 0;
+
+  /**
+   * blocks until some I/O finishes, `interrupt()` is called or |timeout|
+   * passes (a negative |timeout| waits indefinitely). may return early. only
+   * called by the node's kernel-managed thread.
+   */
+  virtual void wait_for(std::chrono::nanoseconds timeout) = 0;
+
+  /**
+   * ends a `wait_for()` that is underway or about to begin. may be called from
+   * any kernel-managed thread.
+   */
+  virtual void interrupt() = 0;
+};
+}  // namespace gthread
@@ -24,10 +24,14 @@ void enable_timer_preemption() {
       auto& mu = preempt_mutex::get();
       if (static_cast<bool>(mu)) return;
 
+      // a task that was just switched to can't be switched away from until it
+      // has released the task it switched from
+      if (task::current()->finishing_switch()) return;
+
       // apply the preempt lock to prevent trampling (and assert that no other
       // concurrent execution context sets the `no_preempt_flag`)
       std::lock_guard<preempt_mutex> l(mu);
-      mu.node().yield();
+      mu.node().trap();
     });
   }
   alarm::set_interval(preempt_interval);
@@ -54,6 +58,16 @@ void preempt_mutex::unlock() {
   auto succ[[maybe_unused]] = cur->no_preempt_flag.compare_exchange_strong(
       expected, false, std::memory_order_release);
   assert(succ);
+
+  // a task woken here while this one couldn't be preempted should run ahead
+  // of it, or the alarm was rung then, so do what the trap would have
+  auto* node = sched_node::current();
+  if (branch_unexpected(node != nullptr && node->should_yield() &&
+                        !cur->finishing_switch())) {
+    lock();
+    node->trap();
+    unlock();
+  }
 }
 
 sched_node& preempt_mutex::node() const {
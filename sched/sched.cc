@@ -1,43 +1,484 @@
 #include "sched/sched.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cinttypes>
 #include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
 
+#include "platform/clock.h"
+#include "platform/wake_event.h"
 #include "sched/preempt.h"
+#include "sched/trace.h"
 #include "util/compiler.h"
 #include "util/log.h"
 
 namespace gthread {
+static_assert(sched::k_max_concurrency == sched_node_list::k_capacity,
+              "every node must fit in the node list");
+static_assert(sched::k_max_concurrency <= sched_group::k_max_nodes,
+              "every node must have a slot in each group");
+static_assert(sched::k_max_concurrency <= k_max_affinity_nodes,
+              "every node must be nameable in an affinity mask");
+
 namespace {
 void task_end_handler(task* task) { sched::exit(task->return_value); }
 
+/**
+ * all of one node's time, as a deadline task's share of it is measured
+ */
+constexpr uint64_t k_full_bandwidth = uint64_t{1} << 20;
+constexpr auto k_max_deadline_bandwidth = static_cast<uint64_t>(
+    sched::k_max_deadline_utilization * k_full_bandwidth);
+
+uint64_t deadline_bandwidth(std::chrono::nanoseconds runtime,
+                            std::chrono::nanoseconds deadline) {
+  return static_cast<uint64_t>(static_cast<double>(runtime.count()) /
+                               deadline.count() * k_full_bandwidth);
+}
+
+/**
+ * how often the launcher thread looks at the runqueues when the pool is
+ * elastic (backing off to `k_quiet_grow_interval` while nothing is waiting to
+ * run), and how many looks in a row have to find them deep (at least
+ * `k_grow_depth` tasks waiting per active node, with none idle) for it to add
+ * a node
+ */
+constexpr auto k_grow_interval = std::chrono::milliseconds{1};
+constexpr auto k_quiet_grow_interval = std::chrono::milliseconds{16};
+constexpr unsigned k_grow_samples = 3;
+constexpr unsigned k_grow_depth = 2;
+
+/**
+ * how often the launcher thread looks for nodes stuck in a blocking call
+ * while any task is in one, and how long one has to have been stuck for its
+ * tasks to be handed off
+ */
+constexpr auto k_stall_check_interval = std::chrono::milliseconds{1};
+constexpr auto k_stall_threshold = std::chrono::milliseconds{1};
+
 /**
  * represents the global scheduler context
  */
 struct sched_context {
   std::shared_ptr<internal::task_freelist> freelist;
-  sched_node root_node;  // TODO: add thread hosted nodes l8r
+
+  // idle nodes steal work from the others in here
+  sched_node_list nodes;
+  sched_node root_node;
+
+  std::atomic<unsigned> next_node;
+  std::atomic<uint64_t> random_state;
+
+  // how nodes are picked for tasks that leave it to the scheduler
+  std::atomic<placement_policy> placement;
+
+  // whether a task that stops switches straight to its joiner
+  std::atomic<bool> join_handoff;
+
+  // what the admitted deadline tasks reserve together, in units of
+  // `k_full_bandwidth`
+  std::atomic<uint64_t> deadline_bandwidth;
+
+  // the number of nodes the launcher thread should bring up, and the most it
+  // may grow the pool to on its own (0 unless the pool is elastic)
+  std::mutex launcher_mu;
+  wake_event launcher_event;
+  unsigned requested_nodes;
+  unsigned max_nodes;
+
+  // what `start_thread()` has asked the launcher thread to run
+  std::vector<std::function<void()>> requested_threads;
+
+  // how many tasks are in `sched::enter_blocking()`. the launcher thread
+  // watches for stalled nodes while there are any.
+  std::atomic<unsigned> blocking_calls;
 
   sched_context()
       : freelist(std::make_shared<internal::task_freelist>(64)),
-        root_node(freelist) {
+        nodes(),
+        root_node(freelist, &nodes),
+        next_node(0),
+        random_state(0),
+        placement(placement_policy::round_robin),
+        join_handoff(true),
+        deadline_bandwidth(0),
+        requested_nodes(1),
+        max_nodes(0),
+        requested_threads(),
+        blocking_calls(0) {
+    nodes.push_back(&root_node);
+
+    // glibc reaches through the thread pointer in `pthread_create()`, which
+    // is repurposed once a thread hosts tasks. so kernel-managed threads for
+    // new nodes are created from this thread, which starts before the root
+    // node takes over this one.
+    std::thread([this]() { launch_nodes(); }).detach();
+
     root_node.start_async();
     enable_timer_preemption();
     task::set_end_handler(task_end_handler);
   }
 
   /**
-   * initialized on first use
+   * body of the launcher thread. starts a kernel-managed thread hosting a new
+   * node each time more are requested. when the pool is elastic, it also
+   * watches the runqueues, and adds a node when they stay deep. while any task
+   * is in a blocking call, it hands off the tasks of nodes stuck in one.
+   */
+  void launch_nodes() {
+    unsigned deep_samples = 0;
+    std::chrono::milliseconds interval = k_grow_interval;
+    while (true) {
+      // `launcher_event` is notified after what it is woken for is published
+      launcher_event.prepare_wait();
+
+      std::chrono::milliseconds wait;
+      bool poll;
+      {
+        std::lock_guard<std::mutex> l(launcher_mu);
+        while (nodes.size() < requested_nodes) launch_node();
+        for (auto& f : requested_threads) std::thread(std::move(f)).detach();
+        requested_threads.clear();
+
+        if (max_nodes != 0) {
+          bool any_waiting;
+          deep_samples = runqueues_deep(&any_waiting) ? deep_samples + 1 : 0;
+          if (deep_samples >= k_grow_samples) {
+            deep_samples = 0;
+            grow();
+          }
+          interval = any_waiting
+                         ? k_grow_interval
+                         : std::min(2 * interval, k_quiet_grow_interval);
+        }
+
+        bool blocking = blocking_calls.load() > 0;
+        if (blocking) hand_off_stalled();
+
+        poll = blocking || max_nodes != 0;
+        wait = blocking ? std::min(interval, k_stall_check_interval) : interval;
+      }
+
+      if (poll) {
+        launcher_event.wait_until(std::chrono::steady_clock::now() + wait);
+      } else {
+        launcher_event.wait_until(std::chrono::steady_clock::time_point::max());
+      }
+    }
+  }
+
+  /**
+   * starts a kernel-managed thread hosting a new node. must hold
+   * `launcher_mu`.
+   */
+  sched_node* launch_node() {
+    auto* node = new sched_node(freelist, &nodes);
+    std::thread([node]() { node->start(); }).detach();
+    nodes.push_back(node);
+    requested_nodes = std::max(requested_nodes, nodes.size());
+    return node;
+  }
+
+  /**
+   * hands the tasks waiting on each node that has been stuck in a blocking
+   * call for `k_stall_threshold` to a spare node. must hold `launcher_mu`.
+   */
+  void hand_off_stalled() {
+    auto deadline = std::chrono::steady_clock::now() - k_stall_threshold;
+    for (unsigned i = 0, n = nodes.size(); i < n; ++i) {
+      auto* node = nodes[i];
+      if (!node->check_stalled(deadline) || node->load() == 0) continue;
+      if (auto* spare = spare_node(node)) node->hand_off(*spare);
+    }
+  }
+
+  /**
+   * the node to take over from |stalled|: an idle one, a retired one brought
+   * back, a new one if no other is available, or else the least loaded. must
+   * hold `launcher_mu`.
+   */
+  sched_node* spare_node(sched_node* stalled) {
+    auto n = nodes.size();
+    for (unsigned i = 0; i < n; ++i) {
+      auto* node = nodes[i];
+      if (node != stalled && node->available() && node->idle()) return node;
+    }
+    for (unsigned i = 0; i < n; ++i) {
+      if (nodes[i] != stalled && nodes[i]->revive()) return nodes[i];
+    }
+
+    sched_node* best = nullptr;
+    for (unsigned i = 0; i < n; ++i) {
+      auto* node = nodes[i];
+      if (node == stalled || !node->available()) continue;
+      if (best == nullptr || node->load() < best->load()) best = node;
+    }
+    if (best == nullptr && n < sched::k_max_concurrency) best = launch_node();
+    return best;
+  }
+
+  /**
+   * whether every active node is busy and they have at least `k_grow_depth`
+   * tasks each waiting to run on average. |*any_waiting| is set if any task
+   * is waiting to run at all.
+   */
+  bool runqueues_deep(bool* any_waiting) {
+    unsigned active = 0, waiting = 0;
+    for (unsigned i = 0, n = nodes.size(); i < n; ++i) {
+      if (!nodes[i]->available()) continue;
+      ++active;
+      waiting += nodes[i]->load();
+    }
+    *any_waiting = waiting > 0;
+    return nodes.idle() == 0 && waiting >= k_grow_depth * active;
+  }
+
+  /**
+   * brings back a retired node, or starts a new one, unless there are already
+   * `max_nodes` active. must hold `launcher_mu`.
+   */
+  void grow() {
+    if (nodes.active() >= max_nodes) return;
+    for (unsigned i = 0, n = nodes.size(); i < n; ++i) {
+      if (nodes[i]->revive()) return;
+    }
+    if (nodes.size() < max_nodes) {
+      requested_nodes = std::max(requested_nodes, nodes.size() + 1);
+    }
+  }
+
+  /**
+   * whether any node in |affinity| (or any node at all, if it is empty) is
+   * running
+   */
+  bool has_node_in(const affinity_mask& affinity) {
+    if (affinity.none()) return true;
+    auto n = nodes.size();
+    for (unsigned i = 0; i < n; ++i) {
+      if (affinity.test(i)) return true;
+    }
+    return false;
+  }
+
+  /**
+   * the first running node in |affinity| at or after index |i| (wrapping
+   * around), preferring one that is available. one of them must be
+   * running.
+   */
+  sched_node* eligible_node(const affinity_mask& affinity, unsigned i) {
+    auto n = nodes.size();
+    sched_node* fallback = nullptr;
+    for (unsigned j = 0; j < n; ++j) {
+      auto k = (i + j) % n;
+      if (affinity.any() && !affinity.test(k)) continue;
+      if (nodes[k]->available()) return nodes[k];
+      if (fallback == nullptr) fallback = nodes[k];
+    }
+    return fallback;
+  }
+
+  /**
+   * picks the node a new task with |affinity| should run on by |policy|
+   */
+  sched_node& next_spawn_node(const affinity_mask& affinity,
+                              placement_policy policy) {
+    if (policy == placement_policy::scheduler_default) {
+      policy = placement.load(std::memory_order_relaxed);
+    }
+
+    switch (policy) {
+      case placement_policy::local: {
+        auto* node = sched_node::current();
+        if (node != nullptr &&
+            (affinity.none() || affinity.test(node->index()))) {
+          return *node;
+        }
+        break;
+      }
+
+      case placement_policy::least_loaded: {
+        // start the scan somewhere new each time so ties are spread out
+        auto n = nodes.size();
+        auto start = next_node.fetch_add(1, std::memory_order_relaxed);
+        sched_node* best = nullptr;
+        for (unsigned i = 0; i < n; ++i) {
+          auto* node = nodes[(start + i) % n];
+          if (affinity.any() && !affinity.test(node->index())) continue;
+          if (!node->available()) continue;
+          if (best == nullptr || node->load() < best->load()) best = node;
+        }
+        if (best != nullptr) return *best;
+        break;
+      }
+
+      case placement_policy::two_choices: {
+        auto r = random();
+        auto* a = eligible_node(affinity, static_cast<uint32_t>(r));
+        auto* b = eligible_node(affinity, static_cast<uint32_t>(r >> 32));
+        return b->load() < a->load() ? *b : *a;
+      }
+
+      default:
+        break;
+    }
+
+    return *eligible_node(affinity,
+                          next_node.fetch_add(1, std::memory_order_relaxed));
+  }
+
+  /**
+   * places the |n| new tasks in |tasks|, which share |affinity| and |policy|,
+   * like |n| calls to `next_spawn_node()` would, but in contiguous runs so
+   * each node takes its share in one batch
+   */
+  void schedule_new(task* const* tasks, size_t n,
+                    const affinity_mask& affinity, placement_policy policy) {
+    size_t num_eligible = 0;
+    for (unsigned i = 0, num_nodes = nodes.size(); i < num_nodes; ++i) {
+      num_eligible += (affinity.none() || affinity.test(i)) &&
+                      nodes[i]->available();
+    }
+    num_eligible = std::max(num_eligible, size_t{1});
+
+    // the loads of the nodes picked for earlier runs are up to date by the
+    // time the next one is placed
+    auto runs = std::min(n, num_eligible);
+    for (size_t i = 0; i < runs; ++i) {
+      auto begin = n * i / runs;
+      auto end = n * (i + 1) / runs;
+      next_spawn_node(affinity, policy).schedule_new(tasks + begin,
+                                                     end - begin);
+    }
+  }
+
+  /**
+   * a cheap, well-mixed random number (splitmix64 over a shared counter)
+   */
+  uint64_t random() {
+    auto z = random_state.fetch_add(0x9e3779b97f4a7c15,
+                                    std::memory_order_relaxed);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  /**
+   * reserves |bandwidth| for a deadline task. returns false if that would
+   * leave too little for fair tasks.
+   */
+  bool admit_deadline(uint64_t bandwidth) {
+    auto reserved = deadline_bandwidth.load();
+    do {
+      if (reserved + bandwidth > k_max_deadline_bandwidth) return false;
+    } while (!deadline_bandwidth.compare_exchange_weak(reserved,
+                                                       reserved + bandwidth));
+    return true;
+  }
+
+  void release_deadline(uint64_t bandwidth) {
+    deadline_bandwidth.fetch_sub(bandwidth);
+  }
+
+  /**
+   * initialized on first use. never destroyed since hosted nodes may still be
+   * running during static destruction.
    */
   static sched_context& get() {
-    static sched_context instance;
-    return instance;
+    static auto* instance = new sched_context();
+    return *instance;
   }
 };
+
+/**
+ * throws if a task can't be spawned with |a| and |entry|. |n| tasks' worth of
+ * a deadline in |a| is reserved, and must be given back if they aren't
+ * spawned after all.
+ */
+void check_spawn(sched_context& ctx, const attr& a, task::entry_t* entry,
+                 size_t n) {
+  if (branch_unexpected(entry == nullptr)) {
+    throw std::domain_error("must supply entry function");
+  }
+  if (branch_unexpected(a.nice < k_min_nice || a.nice > k_max_nice)) {
+    throw std::domain_error("|attr.nice| must be in [k_min_nice, k_max_nice]");
+  }
+  if (branch_unexpected(!ctx.has_node_in(a.affinity))) {
+    throw std::domain_error("|attr.affinity| must include a running node");
+  }
+
+  const auto& dl = a.deadline;
+  if (dl.runtime != std::chrono::nanoseconds::zero()) {
+    if (branch_unexpected(dl.runtime < std::chrono::nanoseconds::zero() ||
+                          dl.runtime > dl.deadline)) {
+      throw std::domain_error(
+          "|attr.deadline.runtime| must be in [0, |attr.deadline.deadline|]");
+    }
+    if (branch_unexpected(!ctx.admit_deadline(
+            n * deadline_bandwidth(dl.runtime, dl.deadline)))) {
+      throw std::system_error(EBUSY, std::system_category(),
+                              "deadline tasks would reserve too much time");
+    }
+  }
+}
+
+/**
+ * gives back what `check_spawn()` reserved for |n| tasks with |a| that weren't
+ * spawned after all (e.g. since a stack couldn't be allocated)
+ */
+void release_spawn(sched_context& ctx, const attr& a, size_t n) {
+  const auto& dl = a.deadline;
+  if (dl.runtime != std::chrono::nanoseconds::zero()) {
+    ctx.release_deadline(n * deadline_bandwidth(dl.runtime, dl.deadline));
+  }
+}
+
+/**
+ * suspends the current task until |t| has stopped
+ */
+void wait_for_stop(task* t) {
+  auto* current = task::current();
+  auto& pmu = preempt_mutex::get();
+  std::unique_lock<preempt_mutex> l(pmu);
+  std::unique_lock<spin_lock> tl(t->lifecycle_lock);
+
+  if (branch_unexpected(t->joiner != nullptr)) {
+    throw std::logic_error("a thread can only be joined from one place");
+  }
+  if (t->run_state != task::STOPPED) {
+    t->joiner = current;
+    current->run_state = task::WAITING;
+    tl.unlock();
+    l.unlock();
+    sched::yield();
+  }
+}
+
+/**
+ * a stopped task may still be switching away on another kernel-managed thread.
+ * its stack can't be reused until it has.
+ */
+void wait_until_switched_out(task* t) {
+  while (t->on_cpu.load(std::memory_order_acquire)) {
+    asm("pause");
+  }
+}
 }  // namespace
 
 namespace sched {
+handle& handle::operator=(handle&& other) {
+  if (branch_unexpected(this == &other)) return *this;
+  if (branch_unexpected(t != nullptr)) {
+    gthread_log_fatal("assigned to a handle that wasn't joined or detached");
+  }
+  t = other.t;
+  other.t = nullptr;
+  return *this;
+}
+
 void yield() {
   auto* node = sched_node::current();
   if (node == nullptr) {
@@ -53,59 +494,125 @@ void yield() {
 handle spawn(const attr& attr, task::entry_t* entry, void* arg) {
   handle handle;
 
-  if (branch_unexpected(entry == nullptr)) {
-    throw std::domain_error("must supply entry function");
-  }
-
   auto& ctx = sched_context::get();
-  handle.t = ctx.freelist->make_task(attr);
+  check_spawn(ctx, attr, entry, 1);
+
+  auto& pmu = preempt_mutex::get();
+
+  // nodes use the freelist from the scheduler, so its lock must never be held
+  // by a preempted task
+  std::lock_guard<preempt_mutex> l(pmu);
+  try {
+    handle.t = ctx.freelist->make_task(attr);
+  } catch (...) {
+    release_spawn(ctx, attr, 1);
+    throw;
+  }
   handle.t->entry = entry;
   handle.t->arg = arg;
 
-  // this will start the task and immediately return control
+  // primes the task to run when a node first switches to it
   handle.t->start();
 
-  // TODO: where do we schedule when there are options?
-  auto& pmu = preempt_mutex::get();
-  std::lock_guard<preempt_mutex> l(pmu);
-  pmu.node().schedule(handle.t);
+  gthread_trace(pmu.node(), spawn, task::current(), handle.t);
+
+  // place the task on one of the nodes it may run on
+  ctx.next_spawn_node(attr.affinity, attr.placement).schedule(handle.t);
 
   return handle;
 }
 
-void join(handle* handle, void** return_value) {
-  if (branch_unexpected(handle == nullptr || !*handle)) {
-    throw std::domain_error(
-        "|handle| must be specified and must be a valid thread");
+void spawn_n(const attr& attr, task::entry_t* entry, void* const* args,
+             size_t n, handle* handles) {
+  if (n == 0) return;
+  if (branch_unexpected(args == nullptr || handles == nullptr)) {
+    throw std::domain_error("|args| and |handles| must be specified");
   }
 
-  auto* current = task::current();
+  // allocated before anything is reserved for the tasks
+  std::vector<task*> tasks(n);
+
+  auto& ctx = sched_context::get();
+  check_spawn(ctx, attr, entry, n);
+
   auto& pmu = preempt_mutex::get();
   {
-    std::unique_lock<preempt_mutex> l(pmu);
-
-    if (branch_unexpected(handle->t->joiner != nullptr)) {
-      throw std::logic_error("a thread can only be joined from one place");
+    // see `spawn()`
+    std::lock_guard<preempt_mutex> l(pmu);
+    try {
+      ctx.freelist->make_tasks(attr, tasks.data(), n);
+    } catch (...) {
+      release_spawn(ctx, attr, n);
+      throw;
     }
-    if (handle->t->run_state != task::STOPPED) {
-      handle->t->joiner = current;
-      current->run_state = task::WAITING;
-      l.unlock();
-      yield();
+    for (size_t i = 0; i < n; ++i) {
+      tasks[i]->entry = entry;
+      tasks[i]->arg = args[i];
+      tasks[i]->start();
+      gthread_trace(pmu.node(), spawn, task::current(), tasks[i]);
     }
+    ctx.schedule_new(tasks.data(), n, attr.affinity, attr.placement);
   }
 
+  for (size_t i = 0; i < n; ++i) {
+    handles[i].t = tasks[i];
+  }
+}
+
+void join(handle* handle, void** return_value) {
+  if (branch_unexpected(handle == nullptr || !*handle)) {
+    throw std::domain_error(
+        "|handle| must be specified and must be a valid thread");
+  }
+
+  wait_for_stop(handle->t);
+
+  auto& pmu = preempt_mutex::get();
   assert(handle->t->run_state == task::STOPPED);
+  wait_until_switched_out(handle->t);
 
   // take the return value of |thread| if |return_value| is given
   if (return_value != nullptr) {
     *return_value = handle->t->return_value;
   }
 
-  sched_context::get().freelist->return_task(handle->t);
+  {
+    std::lock_guard<preempt_mutex> l(pmu);
+    sched_context::get().freelist->return_task(handle->t);
+  }
   handle->t = nullptr;
 }
 
+void join_all(handle* handles, size_t n, void** return_values) {
+  if (branch_unexpected(n > 0 && handles == nullptr)) {
+    throw std::domain_error("|handles| must be specified");
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (branch_unexpected(!handles[i])) {
+      throw std::domain_error("every handle must be a valid thread");
+    }
+  }
+
+  std::vector<task*> tasks(n);
+  for (size_t i = 0; i < n; ++i) {
+    tasks[i] = handles[i].t;
+    wait_for_stop(tasks[i]);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    assert(tasks[i]->run_state == task::STOPPED);
+    wait_until_switched_out(tasks[i]);
+    if (return_values != nullptr) {
+      return_values[i] = tasks[i]->return_value;
+    }
+    handles[i].t = nullptr;
+  }
+
+  auto& pmu = preempt_mutex::get();
+  std::lock_guard<preempt_mutex> l(pmu);
+  sched_context::get().freelist->return_tasks(tasks.data(), n);
+}
+
 void detach(handle* handle) {
   if (branch_unexpected(handle == nullptr || !*handle)) {
     throw std::domain_error(
@@ -115,7 +622,7 @@ void detach(handle* handle) {
   auto& pmu = preempt_mutex::get();
   {
     std::lock_guard<preempt_mutex> l(pmu);
-    // TODO: fix race here for smp case
+    std::lock_guard<spin_lock> tl(handle->t->lifecycle_lock);
     if (handle->t->run_state != task::STOPPED) {
       handle->t->detached = true;
       handle->t = nullptr;
@@ -124,8 +631,12 @@ void detach(handle* handle) {
   }
 
   assert(handle->t->run_state == task::STOPPED);
+  wait_until_switched_out(handle->t);
 
-  sched_context::get().freelist->return_task(handle->t);
+  {
+    std::lock_guard<preempt_mutex> l(pmu);
+    sched_context::get().freelist->return_task(handle->t);
+  }
   handle->t = nullptr;
 }
 
@@ -139,14 +650,216 @@ void exit(void* return_value) {
 
   auto& pmu = preempt_mutex::get();
   std::lock_guard<preempt_mutex> l(pmu);
-  current->return_value = return_value;  // save |return_value|
-  current->run_state = task::STOPPED;    // deschedule permanently
 
-  if (current->joiner != nullptr) {
-    pmu.node().schedule(current->joiner);
+  // the reservation is given back before a joiner can see the task stop
+  if (current->is_deadline()) {
+    sched_context::get().release_deadline(
+        deadline_bandwidth(current->dl_runtime, current->dl_deadline));
+  }
+
+  task* joiner;
+  {
+    std::lock_guard<spin_lock> tl(current->lifecycle_lock);
+    current->return_value = return_value;  // save |return_value|
+    current->run_state = task::STOPPED;    // deschedule permanently
+    joiner = current->joiner;
+  }
+  gthread_trace(pmu.node(), exit, current, nullptr);
+
+  // the joiner is woken up on the node it is waiting on. if that's this node,
+  // it runs next instead of waiting its turn on the runqueue, like the task
+  // woken by `waiter::swap()`.
+  if (joiner != nullptr) {
+    auto& node = pmu.node();
+    if (joiner->node == &node &&
+        sched_context::get().join_handoff.load(std::memory_order_relaxed)) {
+      node.switch_to(joiner);  // deschedule
+      gthread_log_fatal("a stopped task was resumed");
+    }
+    joiner->node->schedule(joiner);
   }
 
   pmu.node().yield();  // deschedule
 }
+
+void enter_blocking() {
+  auto& ctx = sched_context::get();
+  if (sched_node::current() == nullptr) return;
+
+  auto* current = task::current();
+  auto& pmu = preempt_mutex::get();
+  std::lock_guard<preempt_mutex> l(pmu);
+  if (current->blocking_depth++ > 0) return;
+  current->blocking_node = &pmu.node();
+  pmu.node().enter_blocking(current);
+
+  // the launcher thread only keeps watch while a task is in a blocking call
+  if (ctx.blocking_calls.fetch_add(1) == 0) ctx.launcher_event.notify();
+}
+
+void exit_blocking() {
+  if (sched_node::current() == nullptr) return;
+
+  auto* current = task::current();
+  if (branch_unexpected(current->blocking_depth == 0)) {
+    throw std::logic_error("exit_blocking() must follow enter_blocking()");
+  }
+  if (--current->blocking_depth > 0) return;
+
+  current->blocking_node->exit_blocking(current);
+  current->blocking_node = nullptr;
+  sched_context::get().blocking_calls.fetch_sub(1);
+}
+
+void start_thread(std::function<void()> f) {
+  auto& ctx = sched_context::get();
+  {
+    std::lock_guard<std::mutex> l(ctx.launcher_mu);
+    ctx.requested_threads.push_back(std::move(f));
+  }
+  ctx.launcher_event.notify();
+}
+
+void set_concurrency(unsigned concurrency) {
+  if (branch_unexpected(concurrency == 0 ||
+                        concurrency > k_max_concurrency)) {
+    throw std::domain_error("|concurrency| must be in [1, k_max_concurrency]");
+  }
+
+  auto& ctx = sched_context::get();
+  {
+    std::lock_guard<std::mutex> l(ctx.launcher_mu);
+    if (concurrency <= ctx.requested_nodes) return;
+    ctx.requested_nodes = concurrency;
+  }
+  ctx.launcher_event.notify();
+
+  while (get_concurrency() < concurrency) {
+    yield();
+  }
+}
+
+unsigned get_concurrency() {
+  return sched_context::get().nodes.size();
+}
+
+void set_elastic_concurrency(unsigned min, unsigned max,
+                             std::chrono::nanoseconds linger) {
+  if (branch_unexpected(min == 0 || min > max || max > k_max_concurrency)) {
+    throw std::domain_error(
+        "must have 1 <= |min| <= |max| <= k_max_concurrency");
+  }
+  if (branch_unexpected(linger < std::chrono::nanoseconds::zero())) {
+    throw std::domain_error("|linger| must not be negative");
+  }
+
+  auto& ctx = sched_context::get();
+  ctx.nodes.set_retirement(min, linger);
+  {
+    std::lock_guard<std::mutex> l(ctx.launcher_mu);
+    ctx.max_nodes = max;
+    ctx.requested_nodes = std::max(ctx.requested_nodes, min);
+    for (unsigned i = 0, n = ctx.nodes.size(); i < n; ++i) {
+      if (ctx.nodes.active() >= min) break;
+      ctx.nodes[i]->revive();
+    }
+  }
+  ctx.launcher_event.notify();
+
+  while (get_concurrency() < min) {
+    yield();
+  }
+}
+
+unsigned get_active_concurrency() {
+  return sched_context::get().nodes.active();
+}
+
+std::vector<node_stats> stats() {
+  auto& ctx = sched_context::get();
+  std::vector<node_stats> s;
+  auto n = ctx.nodes.size();
+  s.reserve(n);
+  for (unsigned i = 0; i < n; ++i) s.push_back(ctx.nodes[i]->stats());
+  return s;
+}
+
+log_histogram scheduling_latency() {
+  auto& ctx = sched_context::get();
+  log_histogram h;
+  for (unsigned i = 0, n = ctx.nodes.size(); i < n; ++i) {
+    h.add(ctx.nodes[i]->latency());
+  }
+  return h;
+}
+
+void write_trace(std::ostream& out) {
+  auto& ctx = sched_context::get();
+  std::vector<std::vector<trace::event>> events;
+  auto n = ctx.nodes.size();
+  events.reserve(n);
+  for (unsigned i = 0; i < n; ++i) {
+    events.push_back(ctx.nodes[i]->trace_events());
+  }
+  trace::write_chrome_json(out, events,
+                           tsc_clock::now().time_since_epoch().count());
+}
+
+void set_nice(int nice) {
+  if (branch_unexpected(nice < k_min_nice || nice > k_max_nice)) {
+    throw std::domain_error("|nice| must be in [k_min_nice, k_max_nice]");
+  }
+
+  // make sure the scheduler is running so there is a node to account to
+  sched_context::get();
+
+  auto& pmu = preempt_mutex::get();
+  std::lock_guard<preempt_mutex> l(pmu);
+  pmu.node().set_nice(nice);
+}
+
+int get_nice() {
+  sched_context::get();
+  return task::current()->nice;
+}
+
+void set_placement(placement_policy policy) {
+  if (branch_unexpected(policy == placement_policy::scheduler_default)) {
+    throw std::domain_error("|policy| must name a policy");
+  }
+  sched_context::get().placement.store(policy, std::memory_order_relaxed);
+}
+
+placement_policy get_placement() {
+  return sched_context::get().placement.load(std::memory_order_relaxed);
+}
+
+void set_join_handoff(bool handoff) {
+  sched_context::get().join_handoff.store(handoff, std::memory_order_relaxed);
+}
+
+bool get_join_handoff() {
+  return sched_context::get().join_handoff.load(std::memory_order_relaxed);
+}
+
+void set_vruntime_clock(vruntime_clock_source source) {
+  // doesn't start the scheduler, so it can be called before the first node
+  sched_node::set_vruntime_clock(source);
+}
+
+vruntime_clock_source get_vruntime_clock() {
+  return sched_node::vruntime_clock();
+}
+
+void set_wakeup_granularity(std::chrono::nanoseconds granularity) {
+  if (branch_unexpected(granularity < std::chrono::nanoseconds::zero())) {
+    throw std::domain_error("|granularity| must not be negative");
+  }
+  sched_node::set_wakeup_granularity(granularity);
+}
+
+std::chrono::nanoseconds get_wakeup_granularity() {
+  return sched_node::wakeup_granularity();
+}
 }  // namespace sched
 }  // namespace gthread
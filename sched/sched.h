@@ -1,13 +1,21 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <list>
 #include <map>
+#include <ostream>
 #include <set>
+#include <vector>
 
 #include "sched/internal/task_freelist.h"
+#include "sched/sched_group.h"
+#include "sched/sched_node.h"
 #include "sched/task.h"
 #include "sched/task_attr.h"
+#include "util/log_histogram.h"
 
 namespace gthread {
 namespace sched {
@@ -23,13 +31,25 @@ namespace sched {
 class handle {
  public:
   constexpr handle() : t(nullptr) {}
+
+  /**
+   * a task has exactly one handle, so handles can only be moved. a moved-from
+   * handle is empty. a handle can only be assigned to while it is empty (e.g.
+   * once it has been joined or detached), since its task would be lost.
+   */
+  handle(handle&& other) : t(other.t) { other.t = nullptr; }
+  handle& operator=(handle&& other);
+
   constexpr operator bool() const { return t != nullptr; }
 
  private:
   task* t;
 
   friend handle spawn(const attr& attr, task::entry_t* entry, void* arg);
+  friend void spawn_n(const attr& attr, task::entry_t* entry,
+                      void* const* args, size_t n, handle* handles);
   friend void join(handle* handle, void** return_value);
+  friend void join_all(handle* handles, size_t n, void** return_values);
   friend void detach(handle* handle);
   friend void exit(void* return_value);
 };
@@ -47,9 +67,24 @@ void yield();
  * spawns a gthread, storing a handle in |handle|, where |entry| will be
  * invoked with argument |arg|. `gthread::sched::join()` must be called
  * eventually to clean up the called thread when it finishes
+ *
+ * throws `std::domain_error` if |a| is invalid, or `std::system_error` if it
+ * asks for a deadline the scheduler can't admit.
  */
 handle spawn(const attr& a, task::entry_t entry, void* arg);
 
+/**
+ * spawns |n| gthreads, storing their handles in |handles|, where the i-th one
+ * invokes |entry| with argument |args[i]|. the tasks are made, started and
+ * put on the runqueues in one batch, which costs less than calling `spawn()`
+ * |n| times. `gthread::sched::join_all()` can clean them up together.
+ *
+ * throws like `spawn()` (a deadline in |a| is admitted for all |n| tasks at
+ * once), in which case none are spawned.
+ */
+void spawn_n(const attr& a, task::entry_t entry, void* const* args, size_t n,
+             handle* handles);
+
 /**
  * detaches from |task|, making it unjoinable. |task| will return its
  * resources upon completion.
@@ -65,6 +100,15 @@ void detach(handle* task);
  */
 void join(handle* task, void** return_value);
 
+/**
+ * joins each of the |n| tasks in |tasks| when they finish running, and then
+ * cleans them up together
+ *
+ * |return_values| can be NULL. when it is not, `return_values[i]` will
+ * contain the return value of `tasks[i]`.
+ */
+void join_all(handle* tasks, size_t n, void** return_values);
+
 /**
  * ends the current task with return value |return_value|
  *
@@ -73,6 +117,199 @@ void join(handle* task, void** return_value);
  */
 void exit(void* return_value);
 
+/**
+ * brackets a call that may block the kernel-managed thread under the current
+ * task (e.g. `read()` on a pipe, `fsync()` or `getaddrinfo()`):
+ *
+ *   gthread::sched::enter_blocking();
+ *   auto n = read(fd, buf, sizeof(buf));
+ *   gthread::sched::exit_blocking();
+ *
+ * every other task waiting on that thread would otherwise wait out the call
+ * too. while any task is in one, a monitor checks every millisecond or so for
+ * a thread that has been stuck in one since the last check, and hands the
+ * tasks waiting there to another thread, like Go hands off the processor of
+ * a thread in a system call: an idle one, else a retired one, else a new one
+ * if no other is running (so `get_concurrency()` may grow), else the least
+ * loaded. tasks woken there go elsewhere until the call returns. sleeping
+ * tasks and ones that may only run there stay.
+ *
+ * calls may nest, and the task may move to another thread before the call.
+ * `exit_blocking()` throws `std::logic_error` if the current task isn't in
+ * `enter_blocking()`.
+ */
+void enter_blocking();
+void exit_blocking();
+
+/**
+ * runs |f| on a new kernel-managed thread that hosts no node, e.g. one that
+ * makes blocking calls on behalf of tasks. glibc's `pthread_create()` can't be
+ * called from a task, so the launcher thread starts it. returns once it is
+ * asked to, perhaps before |f| starts.
+ */
+void start_thread(std::function<void()> f);
+
+/**
+ * the most kernel-managed threads (each hosting a scheduler node) that
+ * `set_concurrency()` will accept
+ */
+constexpr unsigned k_max_concurrency = 256;
+
+/**
+ * sets the number of kernel-managed threads that tasks are multiplexed onto.
+ * the thread that first uses the scheduler is always one of them. the default
+ * is 1.
+ *
+ * this only ever starts threads (see `set_elastic_concurrency()` to let idle
+ * ones retire). throws `std::domain_error` if |concurrency| is 0 or more than
+ * `k_max_concurrency`.
+ */
+void set_concurrency(unsigned concurrency);
+
+/**
+ * returns the number of kernel-managed threads tasks are multiplexed onto
+ * (including retired ones; see `set_elastic_concurrency()`)
+ */
+unsigned get_concurrency();
+
+/**
+ * the `linger` of `set_elastic_concurrency()` if none is given
+ */
+constexpr std::chrono::nanoseconds k_default_linger =
+    std::chrono::milliseconds{100};
+
+/**
+ * lets the scheduler size the pool of kernel-managed threads with the load,
+ * keeping between |min| and |max| of them active. when the runqueues stay
+ * deep with no thread idle, a retired thread is brought back or a new one is
+ * started. a thread with nothing to do for |linger| retires: it blocks until
+ * work is scheduled on it, and tasks woken there move to active threads they
+ * may run on. so the process uses few cores when it is quiet and more in a
+ * burst, without tuning `set_concurrency()` for either.
+ *
+ * threads are never destroyed, so `get_concurrency()` only grows and
+ * `attr::affinity` indices stay valid (a task pinned to retired threads brings
+ * one back). throws `std::domain_error` unless 1 <= |min| <= |max| <=
+ * `k_max_concurrency` and |linger| isn't negative.
+ */
+void set_elastic_concurrency(
+    unsigned min, unsigned max,
+    std::chrono::nanoseconds linger = k_default_linger);
+
+/**
+ * returns the number of kernel-managed threads that haven't retired
+ */
+unsigned get_active_concurrency();
+
+/**
+ * returns a snapshot of each node's counters (see `node_stats`), indexed like
+ * `attr::affinity`. the nodes keep running while they are read, so it is
+ * cheap enough to poll.
+ */
+std::vector<node_stats> stats();
+
+/**
+ * how long tasks have waited between being made runnable (spawned, woken or
+ * preempted) and running, in nanoseconds, over every node. e.g.
+ * `percentile(0.99)` is the p99 scheduling latency (`stats()` has each node's
+ * p50, p99 and p999). a copy taken before some work can be subtracted from
+ * one taken after to leave just that work's.
+ */
+log_histogram scheduling_latency();
+
+/**
+ * writes the events on every node's trace ring as Chrome trace-event JSON (see
+ * `trace::write_chrome_json()`), which chrome://tracing and Perfetto show as a
+ * timeline of every task. the nodes keep running while they are read.
+ *
+ * events are only recorded when the scheduler is built with `GTHREAD_TRACE`
+ * (`--define gthread_trace=1`). otherwise the trace is empty.
+ */
+void write_trace(std::ostream& out);
+
+/**
+ * the most of one kernel-managed thread's time that deadline tasks (see
+ * `attr::deadline`) may reserve together. `spawn()` throws a
+ * `std::system_error` with `EBUSY` rather than admit a deadline task that
+ * would go over it, so fair tasks are never starved.
+ */
+constexpr double k_max_deadline_utilization = 0.95;
+
+/**
+ * sets the nice value of the current task, which weighs its share of the
+ * processor against the other tasks on its node like `nice(2)`. tasks start
+ * with the nice value in the `attr` they were spawned with.
+ *
+ * throws `std::domain_error` if |nice| is not in [`k_min_nice`,
+ * `k_max_nice`].
+ */
+void set_nice(int nice);
+
+/**
+ * returns the nice value of the current task
+ */
+int get_nice();
+
+/**
+ * sets how `spawn()` picks the node a task starts on when its
+ * `attr::placement` is `placement_policy::scheduler_default`. the default is
+ * `placement_policy::round_robin`.
+ *
+ * throws `std::domain_error` if |policy| is
+ * `placement_policy::scheduler_default`.
+ */
+void set_placement(placement_policy policy);
+
+/**
+ * returns the scheduler's placement policy
+ */
+placement_policy get_placement();
+
+/**
+ * sets whether a task that stops while its joiner waits on the same node
+ * switches straight to the joiner (the default). that makes a fork/join or a
+ * request/response round trip as quick as a context switch. without it, the
+ * joiner is woken onto the runqueue and waits its turn behind the other
+ * runnable tasks, which keeps the processor shared fairly between them.
+ */
+void set_join_handoff(bool handoff);
+
+/**
+ * returns whether stopping tasks hand off to their joiners
+ */
+bool get_join_handoff();
+
+/**
+ * picks the clock that nodes charge tasks' running time with (see
+ * `vruntime_clock_source`). the default is
+ * `vruntime_clock_source::thread_cpu`.
+ *
+ * a node keeps the clock it started with, so this should be called before the
+ * scheduler is first used (which starts the node on the calling
+ * kernel-managed thread) and before `set_concurrency()` starts any others.
+ */
+void set_vruntime_clock(vruntime_clock_source source);
+
+/**
+ * returns the clock nodes started from now on will use
+ */
+vruntime_clock_source get_vruntime_clock();
+
+/**
+ * sets how far behind the running task's vruntime a woken task's has to be
+ * for it to preempt that task rather than wait its turn. the default is
+ * `sched_node::k_default_wakeup_granularity` (1ms), and
+ * `std::chrono::nanoseconds::max()` turns wakeup preemption off.
+ *
+ * throws `std::domain_error` if |granularity| is negative.
+ */
+void set_wakeup_granularity(std::chrono::nanoseconds granularity);
+
+/**
+ * returns the wakeup preemption granularity
+ */
+std::chrono::nanoseconds get_wakeup_granularity();
+
 /**
  * sleeps the current task until |sleep_duration| has passed
  */
@@ -1,10 +1,14 @@
 #include "sched/sched.h"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <thread>
 
 #include <benchmark/benchmark.h>
 
+#include "sched/preempt.h"
+
 static void benchmark_std_thread(benchmark::State& state) {
   std::vector<std::thread> threads(state.range(0));
   std::vector<uint64_t> shared(state.range(0), 0);
@@ -68,4 +72,358 @@ static void benchmark_sched_light_attr(benchmark::State& state) {
 
 BENCHMARK(benchmark_sched_light_attr)->Range(1 << 3, 1 << 11);
 
+/**
+ * the same tasks as `benchmark_sched_light_attr`, spawned and joined in one
+ * batch each
+ */
+static void benchmark_sched_spawn_n(benchmark::State& state) {
+  std::vector<gthread::sched::handle> threads(state.range(0));
+  std::vector<uint64_t> shared(state.range(0), 0);
+  std::vector<void*> args(state.range(0));
+  for (size_t i = 0; i < args.size(); ++i) {
+    args[i] = reinterpret_cast<void*>(shared.data() + i);
+  }
+
+  for (auto _ : state) {
+    gthread::sched::spawn_n(gthread::k_light_attr, something, args.data(),
+                            args.size(), threads.data());
+    gthread::sched::join_all(threads.data(), threads.size(), nullptr);
+  }
+}
+
+BENCHMARK(benchmark_sched_spawn_n)->Range(1 << 3, 1 << 11);
+
+void* yielder(void* arg) {
+  auto* stop = static_cast<std::atomic<bool>*>(arg);
+  while (!stop->load(std::memory_order_relaxed)) {
+    gthread::sched::yield();
+  }
+  return nullptr;
+}
+
+struct yield_loop_args {
+  benchmark::State& state;
+  std::atomic<bool> stop;
+};
+
+void* yield_loop_driver(void* arg) {
+  auto* args = static_cast<yield_loop_args*>(arg);
+  for (auto _ : args->state) {
+    gthread::sched::yield();
+  }
+
+  // stop the others from here. the spawning task built up vruntime spawning
+  // them, so it may not run again until they have caught up.
+  args->stop = true;
+  return nullptr;
+}
+
+/**
+ * measures a `yield()` with |state.range(0)| other tasks on the runqueue, each
+ * of which also yields once per iteration
+ *
+ * the loop runs in a task spawned along with the others, so it starts out with
+ * the same vruntime as them
+ */
+static void benchmark_sched_yield_loop(benchmark::State& state) {
+  // small stacks without guard pages keep 100k tasks under the mapping limit
+  constexpr gthread::attr k_tiny_attr = {{nullptr, 16 * 1024, 0}, false};
+
+  yield_loop_args args{state, {false}};
+  std::vector<gthread::sched::handle> threads(state.range(0));
+
+  auto driver = gthread::sched::spawn(k_tiny_attr, yield_loop_driver, &args);
+
+  // if this task were preempted while spawning, the new tasks would all have
+  // to catch up to its vruntime before it could continue
+  gthread::disable_timer_preemption();
+  for (auto& t : threads) {
+    t = gthread::sched::spawn(k_tiny_attr, yielder, &args.stop);
+  }
+  gthread::enable_timer_preemption();
+
+  gthread::sched::join(&driver, nullptr);
+  for (auto& t : threads) {
+    gthread::sched::join(&t, nullptr);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (state.range(0) + 1));
+}
+
+BENCHMARK(benchmark_sched_yield_loop)->Arg(10)->Arg(1000)->Arg(100000);
+
+constexpr auto k_nap = std::chrono::microseconds{100};
+
+struct sleep_loop_args {
+  benchmark::State& state;
+  std::atomic<bool> stop;
+  std::atomic<uint64_t> wakeups;
+};
+
+void* sleeper(void* arg) {
+  auto* args = static_cast<sleep_loop_args*>(arg);
+  while (!args->stop) {
+    gthread::sched::sleep_for(k_nap);
+    args->wakeups.fetch_add(1, std::memory_order_relaxed);
+  }
+  return nullptr;
+}
+
+void* sleep_loop_driver(void* arg) {
+  auto* args = static_cast<sleep_loop_args*>(arg);
+  for (auto _ : args->state) {
+    gthread::sched::sleep_for(k_nap);
+  }
+  args->stop = true;
+  return nullptr;
+}
+
+/**
+ * measures a short `sleep_for()` with |state.range(0)| other tasks sleeping
+ * just as briefly over and over, so the sleepqueue is always full and most of
+ * it is ripe at once. items are wakeups of the other tasks.
+ */
+static void benchmark_sched_sleep_loop(benchmark::State& state) {
+  constexpr gthread::attr k_tiny_attr = {{nullptr, 16 * 1024, 0}, false};
+
+  sleep_loop_args args{state, {false}, {0}};
+  std::vector<gthread::sched::handle> threads(state.range(0));
+
+  auto driver = gthread::sched::spawn(k_tiny_attr, sleep_loop_driver, &args);
+
+  gthread::disable_timer_preemption();
+  for (auto& t : threads) {
+    t = gthread::sched::spawn(k_tiny_attr, sleeper, &args);
+  }
+  gthread::enable_timer_preemption();
+
+  gthread::sched::join(&driver, nullptr);
+  for (auto& t : threads) {
+    gthread::sched::join(&t, nullptr);
+  }
+
+  state.SetItemsProcessed(args.wakeups.load());
+}
+
+BENCHMARK(benchmark_sched_sleep_loop)->Arg(10)->Arg(1000)->Arg(100000);
+
+/**
+ * a spawn tree where one child of each task gets most of the remaining depth,
+ * so nodes that spawned small subtrees go idle unless they steal work
+ */
+void* imbalanced_tree(void* arg) {
+  auto depth = reinterpret_cast<uintptr_t>(arg);
+
+  // stand-in for a small amount of real work per task
+  volatile uint64_t sink = 0;
+  for (int i = 0; i < 1000; ++i) sink = sink + i;
+
+  if (depth == 0) return nullptr;
+
+  auto deep = gthread::sched::spawn(gthread::k_light_attr, imbalanced_tree,
+                                    reinterpret_cast<void*>(depth - 1));
+  auto shallow = gthread::sched::spawn(gthread::k_light_attr, imbalanced_tree,
+                                       reinterpret_cast<void*>(depth / 4));
+  gthread::sched::join(&deep, nullptr);
+  gthread::sched::join(&shallow, nullptr);
+  return nullptr;
+}
+
+static void benchmark_sched_imbalanced_tree(benchmark::State& state) {
+  // the node pool only grows, so the args must be increasing
+  gthread::sched::set_concurrency(state.range(0));
+
+  for (auto _ : state) {
+    auto root = gthread::sched::spawn(gthread::k_light_attr, imbalanced_tree,
+                                      reinterpret_cast<void*>(16));
+    gthread::sched::join(&root, nullptr);
+  }
+}
+
+BENCHMARK(benchmark_sched_imbalanced_tree)
+    ->RangeMultiplier(2)
+    ->Range(1, 1 << 3)
+    ->UseRealTime();
+
+void* uneven_work(void* arg) {
+  // most tasks in a burst are quick, and a few take much longer
+  auto i = reinterpret_cast<uintptr_t>(arg);
+  volatile uint64_t sink = 0;
+  for (uintptr_t j = 0, n = i % 16 == 0 ? 50000 : 500; j < n; ++j) {
+    sink = sink + j;
+  }
+  return nullptr;
+}
+
+/**
+ * bursts of tasks with uneven amounts of work fanned out from one task, with
+ * each placement policy in turn
+ */
+static void benchmark_sched_fan_out(benchmark::State& state) {
+  // as many nodes as `benchmark_sched_imbalanced_tree` leaves running
+  gthread::sched::set_concurrency(1 << 3);
+
+  constexpr size_t k_burst = 256;
+  constexpr const char* k_names[] = {"", "local", "round_robin",
+                                     "least_loaded", "two_choices"};
+
+  auto a = gthread::k_light_attr;
+  a.placement = static_cast<gthread::placement_policy>(state.range(0));
+  state.SetLabel(k_names[state.range(0)]);
+
+  std::vector<gthread::sched::handle> threads(k_burst);
+  std::vector<void*> args(k_burst);
+  for (size_t i = 0; i < k_burst; ++i) args[i] = reinterpret_cast<void*>(i);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < k_burst; ++i) {
+      threads[i] = gthread::sched::spawn(a, uneven_work, args[i]);
+    }
+    gthread::sched::join_all(threads.data(), k_burst, nullptr);
+  }
+  state.SetItemsProcessed(state.iterations() * k_burst);
+}
+
+BENCHMARK(benchmark_sched_fan_out)
+    ->DenseRange(static_cast<int>(gthread::placement_policy::local),
+                 static_cast<int>(gthread::placement_policy::two_choices))
+    ->UseRealTime();
+
+void* hog(void* arg) {
+  auto* stop = static_cast<std::atomic<bool>*>(arg);
+  volatile uint64_t sink = 0;
+  while (!stop->load(std::memory_order_relaxed)) sink = sink + 1;
+  return nullptr;
+}
+
+void* handler(void* arg) {
+  auto* stop = static_cast<std::atomic<bool>*>(arg);
+  while (!stop->load(std::memory_order_relaxed)) {
+    gthread::sched::sleep_for(k_nap);
+
+    // stand-in for handling a request
+    volatile uint64_t sink = 0;
+    for (int i = 0; i < 1000; ++i) sink = sink + i;
+  }
+  return nullptr;
+}
+
+/**
+ * reports the p50, p99 and p999 scheduling latency (see
+ * `gthread::sched::scheduling_latency()`) of tasks that nap and then handle a
+ * request, sharing the nodes with |state.range(0)| tasks that never block
+ */
+static void benchmark_sched_latency_mixed(benchmark::State& state) {
+  gthread::sched::set_concurrency(1 << 3);
+
+  constexpr size_t k_handlers = 64;
+  std::atomic<bool> stop{false};
+  std::vector<gthread::sched::handle> hogs(state.range(0));
+  std::vector<gthread::sched::handle> handlers(k_handlers);
+
+  auto before = gthread::sched::scheduling_latency();
+  for (auto& t : hogs) {
+    t = gthread::sched::spawn(gthread::k_light_attr, hog, &stop);
+  }
+  for (auto& t : handlers) {
+    t = gthread::sched::spawn(gthread::k_light_attr, handler, &stop);
+  }
+
+  for (auto _ : state) {
+    gthread::sched::sleep_for(k_nap);
+  }
+
+  stop = true;
+  for (auto& t : hogs) gthread::sched::join(&t, nullptr);
+  for (auto& t : handlers) gthread::sched::join(&t, nullptr);
+
+  auto latency = gthread::sched::scheduling_latency();
+  latency.subtract(before);
+  state.counters["p50_ns"] = latency.percentile(0.5);
+  state.counters["p99_ns"] = latency.percentile(0.99);
+  state.counters["p999_ns"] = latency.percentile(0.999);
+}
+
+BENCHMARK(benchmark_sched_latency_mixed)
+    ->Arg(0)
+    ->Arg(8)
+    ->Arg(32)
+    ->UseRealTime();
+
+/**
+ * measures spawning a task and joining it, with |state.range(0)| other tasks
+ * yielding on the same node. with the join handoff (|state.range(1)|), the
+ * joiner runs as soon as the child stops instead of after the yielders.
+ */
+static void benchmark_sched_spawn_join_latency(benchmark::State& state) {
+  // everything runs on this node, so idle ones don't steal the child
+  auto a = gthread::k_light_attr;
+  a.affinity.set(0);
+
+  auto handoff = gthread::sched::get_join_handoff();
+  gthread::sched::set_join_handoff(state.range(1));
+  state.SetLabel(state.range(1) ? "handoff" : "runqueue");
+
+  std::atomic<bool> stop{false};
+  std::vector<gthread::sched::handle> yielders(state.range(0));
+  for (auto& t : yielders) t = gthread::sched::spawn(a, yielder, &stop);
+
+  uint64_t shared = 0;
+  for (auto _ : state) {
+    auto t = gthread::sched::spawn(a, something, &shared);
+    gthread::sched::join(&t, nullptr);
+  }
+
+  stop = true;
+  for (auto& t : yielders) gthread::sched::join(&t, nullptr);
+  gthread::sched::set_join_handoff(handoff);
+}
+
+BENCHMARK(benchmark_sched_spawn_join_latency)
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({16, 0})
+    ->Args({16, 1});
+
+void* remote_spawner(void* arg) {
+  auto rounds = reinterpret_cast<uintptr_t>(arg);
+
+  // the children and their joiner's wakeups all cross between nodes
+  auto a = gthread::k_light_attr;
+  a.affinity.set(0);
+  uint64_t shared = 0;
+  for (uintptr_t i = 0; i < rounds; ++i) {
+    auto t = gthread::sched::spawn(a, something, &shared);
+    gthread::sched::join(&t, nullptr);
+  }
+  return nullptr;
+}
+
+/**
+ * |state.range(0)| tasks on other nodes each spawn and join tasks on node 0
+ * in a loop, so node 0 takes spawns and wakeups from all of them at once
+ */
+static void benchmark_sched_remote_wakeups(benchmark::State& state) {
+  gthread::sched::set_concurrency(1 << 3);
+
+  constexpr uintptr_t k_rounds = 256;
+  std::vector<gthread::sched::handle> spawners(state.range(0));
+  for (auto _ : state) {
+    for (size_t i = 0; i < spawners.size(); ++i) {
+      auto a = gthread::k_light_attr;
+      a.affinity.set(i + 1);
+      spawners[i] = gthread::sched::spawn(a, remote_spawner,
+                                          reinterpret_cast<void*>(k_rounds));
+    }
+    gthread::sched::join_all(spawners.data(), spawners.size(), nullptr);
+  }
+  state.SetItemsProcessed(state.iterations() * spawners.size() * k_rounds);
+}
+
+BENCHMARK(benchmark_sched_remote_wakeups)
+    ->Arg(1)
+    ->Arg(3)
+    ->Arg(7)
+    ->UseRealTime();
+
 BENCHMARK_MAIN()
@@ -0,0 +1,119 @@
+#include "sched/sched.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+#include "platform/clock.h"
+
+using namespace gthread;
+
+constexpr unsigned k_max_nodes = 4;
+constexpr auto k_linger = std::chrono::milliseconds{20};
+
+void* spinner(void* arg) {
+  // about 2ms of work, in slices that don't yield so they aren't counted
+  // against the other tasks
+  for (int i = 0; i < 100; ++i) {
+    for (auto start = thread_clock::now();
+         thread_clock::now() - start < std::chrono::microseconds{20};) {
+    }
+    sched::yield();
+  }
+  return arg;
+}
+
+/**
+ * runs a burst of tasks that keeps the runqueues deep, returning the most
+ * active nodes seen during it
+ */
+unsigned burst() {
+  constexpr size_t k_tasks = 64;
+  sched::handle threads[k_tasks];
+  void* args[k_tasks] = {};
+  sched::spawn_n(k_light_attr, spinner, args, k_tasks, threads);
+
+  unsigned most = sched::get_active_concurrency();
+  for (auto& t : threads) {
+    sched::join(&t, nullptr);
+    most = std::max(most, sched::get_active_concurrency());
+  }
+  return most;
+}
+
+/**
+ * waits for the pool to shrink to |n| active nodes. returns false if it
+ * doesn't in a while.
+ */
+bool shrinks_to(unsigned n) {
+  for (int i = 0; i < 100; ++i) {
+    if (sched::get_active_concurrency() == n) return true;
+    sched::sleep_for(k_linger);
+  }
+  return false;
+}
+
+TEST(gthread_sched_elastic, checks_bounds) {
+  EXPECT_THROW(sched::set_elastic_concurrency(0, 1), std::domain_error);
+  EXPECT_THROW(sched::set_elastic_concurrency(2, 1), std::domain_error);
+  EXPECT_THROW(
+      sched::set_elastic_concurrency(1, sched::k_max_concurrency + 1),
+      std::domain_error);
+  EXPECT_THROW(
+      sched::set_elastic_concurrency(1, 1, std::chrono::nanoseconds{-1}),
+      std::domain_error);
+}
+
+TEST(gthread_sched_elastic, grows_and_shrinks) {
+  sched::set_elastic_concurrency(1, k_max_nodes, k_linger);
+  EXPECT_EQ(sched::get_concurrency(), 1u);
+
+  // deep runqueues bring up more nodes, but no more than the maximum
+  auto most = burst();
+  EXPECT_GT(most, 1u);
+  EXPECT_LE(most, k_max_nodes);
+  EXPECT_LE(sched::get_concurrency(), k_max_nodes);
+
+  // once they have lingered with nothing to do, they retire down to the
+  // minimum
+  EXPECT_TRUE(shrinks_to(1));
+  auto started = sched::get_concurrency();
+  auto stats = sched::stats();
+  unsigned retired = 0;
+  for (auto& s : stats) retired += s.retired;
+  EXPECT_EQ(retired, started - 1);
+
+  // the next burst brings retired nodes back before starting more
+  EXPECT_GT(burst(), 1u);
+  EXPECT_LE(sched::get_concurrency(), k_max_nodes);
+  EXPECT_TRUE(shrinks_to(1));
+}
+
+void* report_thread(void* arg) { return arg; }
+
+TEST(gthread_sched_elastic, pinned_tasks_revive_nodes) {
+  sched::set_elastic_concurrency(1, k_max_nodes, k_linger);
+  sched::set_concurrency(2);
+  ASSERT_TRUE(shrinks_to(1));
+
+  // one of the two nodes has retired. a task pinned to each still runs.
+  for (unsigned i = 0; i < 2; ++i) {
+    auto a = k_light_attr;
+    a.affinity.set(i);
+    auto h = sched::spawn(a, report_thread, reinterpret_cast<void*>(i + 1));
+    void* ret;
+    sched::join(&h, &ret);
+    EXPECT_EQ(ret, reinterpret_cast<void*>(i + 1));
+  }
+  EXPECT_TRUE(shrinks_to(1));
+}
+
+TEST(gthread_sched_elastic, minimum_stays_active) {
+  sched::set_elastic_concurrency(3, k_max_nodes, k_linger);
+  EXPECT_GE(sched::get_active_concurrency(), 3u);
+  sched::sleep_for(5 * k_linger);
+  EXPECT_EQ(sched::get_active_concurrency(), 3u);
+
+  sched::set_elastic_concurrency(1, k_max_nodes, k_linger);
+  EXPECT_TRUE(shrinks_to(1));
+}
@@ -0,0 +1,16 @@
+#include "sched/sched_group.h"
+
+#include <stdexcept>
+
+#include "util/compiler.h"
+
+namespace gthread {
+sched_group::sched_group(int nice, sched_group* parent)
+    : _parent(parent), _nice(nice), _weight(), _slots() {
+  if (branch_unexpected(nice < k_min_nice || nice > k_max_nice)) {
+    throw std::domain_error("|nice| must be in [k_min_nice, k_max_nice]");
+  }
+  _weight = task::weight_of(nice);
+  _slots.reset(new internal::group_slot[k_max_nodes]);
+}
+}  // namespace gthread
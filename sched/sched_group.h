@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "sched/internal/group_rq.h"
+#include "sched/task_attr.h"
+
+namespace gthread {
+/**
+ * a set of tasks that share one weight's worth of processor time, however many
+ * of them there are. the scheduler first picks the group (or lone task) that
+ * has had the least time for its weight, and then a task within it, so a
+ * group with many tasks gets no more than a group with one.
+ *
+ * groups nest: a group competes with its siblings for its parent's share.
+ * tasks are spawned into a group through `attr::group`.
+ *
+ * example: ```
+ *   gthread::sched_group tenant;
+ *   auto a = gthread::k_default_attr;
+ *   a.group = &tenant;
+ *   auto h = gthread::sched::spawn(a, serve, conn);
+ * ```
+ */
+class sched_group {
+ public:
+  /**
+   * the most nodes a group keeps state for. a group allocates all of it up
+   * front, since the scheduler can't allocate.
+   */
+  static constexpr unsigned k_max_nodes = 256;
+
+  /**
+   * a group with the weight of |nice| in |parent|, or at the top level if
+   * |parent| is nullptr. |parent| must outlive it.
+   *
+   * throws `std::domain_error` if |nice| is not in [`k_min_nice`,
+   * `k_max_nice`].
+   */
+  explicit sched_group(int nice = 0, sched_group* parent = nullptr);
+
+  sched_group(const sched_group&) = delete;
+  sched_group& operator=(const sched_group&) = delete;
+
+  sched_group* parent() const { return _parent; }
+
+  int nice() const { return _nice; }
+
+  uint32_t weight() const { return _weight; }
+
+  /**
+   * the group's state on the node at |node_index|. only touched under that
+   * node's lock.
+   */
+  internal::group_slot& slot(unsigned node_index) {
+    return _slots[node_index];
+  }
+
+ private:
+  sched_group* _parent;
+  int _nice;
+  uint32_t _weight;
+  std::unique_ptr<internal::group_slot[]> _slots;
+};
+}  // namespace gthread
@@ -1,40 +1,108 @@
 #include "sched/sched_node.h"
 
+#include <algorithm>
+#include <cassert>
 #include <mutex>
-#include <thread>
 
 #include "util/log.h"
 
 namespace gthread {
 namespace {
 thread_local sched_node* g_current_sched_node = nullptr;
+
+std::atomic<std::chrono::nanoseconds::rep> g_wakeup_granularity{
+    sched_node::k_default_wakeup_granularity.count()};
+
+std::atomic<vruntime_clock_source> g_vruntime_clock{
+    vruntime_clock_source::thread_cpu};
+
+/**
+ * how long an idle node waits before trying again to steal from a node that
+ * had runnable tasks it couldn't take
+ */
+constexpr auto k_steal_retry_interval = std::chrono::milliseconds{1};
+
+/**
+ * like `wake_event::wait_until()`, but blocks in |p|, which `wake()` interrupts
+ * once it has notified |e|
+ */
+void wait_in(poller* p, wake_event& e,
+             internal::rq::sleepqueue_clock::time_point deadline) {
+  if (deadline == internal::rq::sleepqueue_clock::time_point::max()) {
+    p->wait_for(std::chrono::nanoseconds{-1});
+  } else {
+    auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline - internal::rq::sleepqueue_clock::now());
+    if (timeout > std::chrono::nanoseconds::zero()) p->wait_for(timeout);
+  }
+  e.cancel_wait();
+}
+
+template <typename T>
+class unlock_guard {
+  T& _t;
+
+ public:
+  unlock_guard(T& t) : _t(t) { _t.unlock(); }
+  ~unlock_guard() { _t.lock(); }
+};
 }  // namespace
 
 sched_node* sched_node::current() { return g_current_sched_node; }
 
+void sched_node::set_wakeup_granularity(std::chrono::nanoseconds granularity) {
+  g_wakeup_granularity.store(granularity.count(), std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds sched_node::wakeup_granularity() {
+  return std::chrono::nanoseconds{
+      g_wakeup_granularity.load(std::memory_order_relaxed)};
+}
+
+void sched_node::set_vruntime_clock(vruntime_clock_source source) {
+  g_vruntime_clock.store(source);
+}
+
+vruntime_clock_source sched_node::vruntime_clock() {
+  return g_vruntime_clock.load();
+}
+
 void sched_node::start_async() mt_no_analysis {
   g_current_sched_node = this;
 
-  _last_tick = vruntime_clock::now();
+  _last_tick = clock_now();
   _host_task.wrap_current();
+  _host_task.node = this;
+  _curr = &_host_task;
+  _thread = alarm::current_thread();
 
   bool expected = false;
   if (!_running.compare_exchange_strong(expected, true)) {
     gthread_log_fatal("sched_node was already running");
   }
+
+  start_idle_task();
 }
 
 void sched_node::start() mt_no_analysis {
   g_current_sched_node = this;
 
-  _last_tick = vruntime_clock::now();
+  _last_tick = clock_now();
   _host_task.wrap_current();
+  _host_task.node = this;
+  _curr = &_host_task;
+  _thread = alarm::current_thread();
+
+  // the host task only runs the scheduler, so it should never be preempted
+  _host_task.no_preempt_flag.store(true);
 
   bool expected = false;
   if (!_running.compare_exchange_strong(expected, true)) {
     gthread_log_fatal("sched_node was already running");
   }
 
+  start_idle_task();
+
   _host_task.run_state = task::WAITING;
   yield();  // will not resume until stopped
 
@@ -47,55 +115,307 @@ void sched_node::start() mt_no_analysis {
   }
 }
 
-template <typename T>
-class unlock_guard {
-  T& _t;
+void sched_node::start_idle_task() {
+  _idle_task = _task_freelist->make_task(k_light_attr);
+  _idle_task->entry = idle_loop;
+  _idle_task->arg = this;
+  _idle_task->node = this;
+  _idle_task->start();
 
- public:
-  unlock_guard(T& t) : _t(t) { _t.unlock(); }
-  ~unlock_guard() { _t.lock(); }
-};
+  // the idle task is only ever switched to from the scheduler
+  _idle_task->no_preempt_flag.store(true);
+}
+
+void* sched_node::idle_loop(void* arg) mt_no_analysis {
+  auto* node = static_cast<sched_node*>(arg);
+
+  while (true) {
+    task* next_task;
+    bool stole = false;
+    {
+      guard l(node->_spin_lock);
+      node->return_deferred();
+
+      // set while this node was woken to take work from a busy one
+      bool searching = false;
+
+      // when this node ran out of work, for it to retire after the linger time
+      auto idle_since = internal::rq::sleepqueue_clock::now();
+
+      // look for work locally and then on the other nodes. while there is
+      // none, unlock `_spin_lock` and block the kernel-managed thread until
+      // the next sleeper is ripe, some I/O finishes or something calls
+      // `wake()`.
+      while (true) {
+        // tasks whose I/O finished are scheduled here, which takes the lock.
+        // I/O that finishes after this ends the wait below by itself.
+        auto* poller = node->get_poller();
+        if (poller != nullptr) {
+          unlock_guard<spin_lock> u(node->_spin_lock);
+          poller->poll();
+        }
+
+        // announce the wait first so that a task scheduled after the checks
+        // below is followed by a `wake()` that ends it. a retired node isn't
+        // counted as idle, since it isn't to be woken to steal.
+        bool counted = node->_peers != nullptr && !node->retired();
+        if (counted) node->_peers->enter_idle();
+        node->_idle_event.prepare_wait();
+        node->drain_inbox();
+
+        bool missed = false;
+        if ((next_task = node->_rq.try_pop()) == nullptr && !node->retired()) {
+          next_task = node->steal(&missed);
+          stole = next_task != nullptr;
+        }
+
+        // work scheduled here while it was retired brings it back
+        if (next_task != nullptr) node->unretire();
+
+        if (searching) {
+          node->_peers->end_search();
+          searching = false;
+        }
+
+        if (next_task != nullptr) {
+          node->_idle_event.cancel_wait();
+        } else {
+          // a busy node had tasks that couldn't be taken just now. nothing
+          // will call `wake()` when they can be, so look again soon.
+          auto wake_time = node->_rq.next_wake_time();
+          if (missed) {
+            wake_time = std::min(
+                wake_time,
+                internal::rq::sleepqueue_clock::now() + k_steal_retry_interval);
+          }
+
+          auto linger = node->_peers != nullptr
+                            ? node->_peers->linger()
+                            : std::chrono::nanoseconds::max();
+          bool may_retire =
+              !node->retired() && linger != std::chrono::nanoseconds::max();
+          if (may_retire) {
+            wake_time = std::min(
+                wake_time,
+                idle_since + std::chrono::duration_cast<
+                                 internal::rq::sleepqueue_clock::duration>(
+                                 linger));
+          }
+
+          auto idle_start = std::chrono::steady_clock::now();
+          {
+            unlock_guard<spin_lock> u(node->_spin_lock);
+            if (poller != nullptr) {
+              wait_in(poller, node->_idle_event, wake_time);
+            } else {
+              node->_idle_event.wait_until(wake_time);
+            }
+            searching = node->_woken_to_search.exchange(false);
+          }
+          bump(node->_idle_sleeps);
+          bump(node->_idle_ns,
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - idle_start)
+                   .count());
+
+          if (may_retire) node->try_retire(idle_since);
+        }
+
+        if (counted) node->_peers->exit_idle();
+        if (next_task != nullptr) break;
+      }
+
+      node->_last_tick = node->clock_now();
+      node->_curr = next_task;
+      gthread_trace(*node, switch_to, nullptr, next_task);
+    }
+
+    // there may be more where that came from, so keep the idle nodes waking
+    // up one at a time until they run out
+    if (stole) node->wake_idle_peer();
+
+    next_task->switch_to(&node->_host_task,
+                         [node]() { g_current_sched_node = node; });
+  }
+
+  return nullptr;
+}
+
+node_stats sched_node::stats() const mt_no_analysis {
+  node_stats s;
+  s.voluntary_switches = _voluntary_switches.load(std::memory_order_relaxed);
+  s.involuntary_switches =
+      _involuntary_switches.load(std::memory_order_relaxed);
+  s.spawns = _spawns.load(std::memory_order_relaxed);
+  s.exits = _exits.load(std::memory_order_relaxed);
+  s.wakeups = _wakeups.load(std::memory_order_relaxed) + _rq.timer_wakeups();
+  s.idle_sleeps = _idle_sleeps.load(std::memory_order_relaxed);
+  s.idle_time =
+      std::chrono::nanoseconds{_idle_ns.load(std::memory_order_relaxed)};
+  s.rq_depth = _rq.size();
+  s.max_rq_depth = _rq.max_size();
+  s.sleepers = _rq.sleepers();
+  s.retired = retired();
+  s.stalls = _stalls.load(std::memory_order_relaxed);
+
+  const auto& latency = _rq.latency();
+  s.latency_p50 = std::chrono::nanoseconds{latency.percentile(0.5)};
+  s.latency_p99 = std::chrono::nanoseconds{latency.percentile(0.99)};
+  s.latency_p999 = std::chrono::nanoseconds{latency.percentile(0.999)};
+  return s;
+}
+
+std::vector<trace::event> sched_node::trace_events() const {
+#ifdef GTHREAD_TRACE
+  return _trace.snapshot();
+#else
+  return {};
+#endif
+}
+
+void sched_node::return_deferred() {
+  if (_deferred != nullptr) {
+    _task_freelist->return_task(_deferred);
+    _deferred = nullptr;
+  }
+}
+
+task* sched_node::steal(bool* missed) {
+  if (_peers == nullptr) return nullptr;
+
+  auto n = _peers->size();
+  for (unsigned i = 0; i < n; ++i) {
+    auto* victim = (*_peers)[(_next_victim + i) % n];
+    if (victim == this || victim->_rq.size() == 0) continue;
+
+    if (auto* t = steal_from(*victim, missed)) {
+      _next_victim = (_next_victim + i + 1) % n;
+      return t;
+    }
+  }
+  return nullptr;
+}
+
+task* sched_node::steal_from(sched_node& victim, bool* missed) mt_no_analysis {
+  // two idle nodes may try to steal from each other at once, so never wait on
+  // another node's lock while holding this one's
+  if (!victim._spin_lock.try_lock()) {
+    if (missed != nullptr) *missed = true;
+    return nullptr;
+  }
+
+  // the host task stays with the kernel-managed thread it wraps, and a task
+  // pinned to other nodes stays there. a task that is still switching out
+  // can't be resumed elsewhere yet, but can be once it has.
+  bool switching = false;
+  auto* t = victim._rq.steal_if([this, &victim, &switching](task* t) {
+    if (t == &victim._host_task || !t->may_run_on(_index)) return false;
+    if (t->on_cpu.load(std::memory_order_acquire)) {
+      switching = true;
+      return false;
+    }
+    return true;
+  });
+
+  if (t != nullptr) {
+    t->vruntime += _rq.min_vruntime(t) - victim._rq.min_vruntime(t);
+    t->node = this;
+  } else if (switching && missed != nullptr) {
+    *missed = true;
+  }
+
+  victim._spin_lock.unlock();
+  return t;
+}
+
+void sched_node::charge(task* cur) {
+  auto now = clock_now();
+  _rq.charge(cur, now - _last_tick);
+  _last_tick = now;
+}
 
 task* sched_node::get_next_task(task* cur) {
   // update virtual runtime of currently running task
-  cur->vruntime += std::chrono::duration_cast<decltype(cur->vruntime)>(
-      vruntime_clock::now() - _last_tick);
+  charge(cur);
+  drain_inbox();
 
   // if the task was in a runnable state when the scheduler was invoked, push
   // it to the runqueue
   if (cur->run_state == task::RUNNING) {
     _rq.push(cur);
-  } else if (cur->run_state == task::STOPPED && cur->detached) {
-    _deferred = cur;  // defer `return_task()` to avoid freeing this stack
+  } else if (cur->run_state == task::STOPPED) {
+    bump(_exits);
+    // defer `return_task()` to avoid freeing this stack
+    if (cur->detached) _deferred = cur;
   }
 
-  // while idling, unlock `_spin_lock` and sleep the kernel-managed thread
-  auto* next_task = _rq.pop([this](auto&& wake_time) mt_no_analysis {
-    unlock_guard<spin_lock> u(_spin_lock);
-    std::this_thread::sleep_until(wake_time);
-  });
+  // with nothing runnable here or on another node, idle on the idle task's
+  // stack instead of |cur|'s
+  auto* next_task = _rq.try_pop();
+  if (next_task == nullptr) {
+    next_task = steal();
+  }
+  if (next_task == nullptr) {
+    next_task = _idle_task;
+  }
 
-  _last_tick = vruntime_clock::now();
+  _last_tick = clock_now();
+  _curr = next_task;
+  _should_yield.store(false, std::memory_order_relaxed);
   return next_task;
 }
 
-void sched_node::yield() {
+void sched_node::wake_idle_peer() {
+  if (_peers == nullptr || _peers->idle() == 0) return;
+
+  // waking every idle node for each task would cost more than it gains, so
+  // only one searches at a time
+  if (!_peers->try_start_search()) return;
+
+  auto n = _peers->size();
+  for (unsigned i = 0; i < n; ++i) {
+    auto* peer = (*_peers)[i];
+    if (peer == this || !peer->available()) continue;
+
+    // the peer ends the search once it has looked for work
+    peer->_woken_to_search.store(true);
+    if (peer->wake()) return;
+    peer->_woken_to_search.store(false);
+  }
+
+  _peers->end_search();
+}
+
+void sched_node::reschedule(bool preempted) {
   if (!_running.load()) return;
 
+  // tasks whose I/O has finished compete with the rest for this node. (this
+  // may be the one switching away, if its I/O was quick.)
+  if (auto* p = get_poller()) p->poll();
+
+  // with a backlog here, an idle node could run some of it sooner. a single
+  // waiting task is left to run here next, since handing every task to
+  // another kernel-managed thread costs more than it saves.
+  if (has_work_to_spare()) wake_idle_peer();
+
   guard l(_spin_lock);
 
   // if we deferred returning a task, do it now
-  if (_deferred != nullptr) {
-    _task_freelist->return_task(_deferred);
-    _deferred = nullptr;
-  }
+  return_deferred();
 
   auto* cur = task::current();
   auto* next_task = get_next_task(cur);
 
   if (next_task != cur) {
+    bump(preempted ? _involuntary_switches : _voluntary_switches);
+    gthread_trace(*this, switch_to, cur,
+                  next_task != _idle_task ? next_task : nullptr);
     unlock_guard<spin_lock> u(_spin_lock);
-    next_task->switch_to([this]() { g_current_sched_node = this; });
+    next_task->switch_to(&_host_task,
+                         [this]() { g_current_sched_node = this; });
+  } else {
+    // |cur| could have been woken up before it got the chance to suspend
+    cur->run_state = task::RUNNING;
   }
 }
 
@@ -106,52 +426,281 @@ void sched_node::yield_for(internal::rq::sleepqueue_clock::duration duration) {
     guard l(_spin_lock);
     current->run_state = task::WAITING;
     _rq.sleep_push(current, duration);
+    gthread_trace(*this, sleep, current, nullptr);
   }
 
   yield();
 }
 
-bool sched_node::spin_lock::try_lock() {
-  bool expected = false;
-  return _flag.compare_exchange_strong(expected, true,
-                                       std::memory_order_acquire);
+void sched_node::schedule(task* t) {
+  assert(t->may_run_on(_index));
+
+  // the host task can only run here, and a new task was placed here on
+  // purpose. a woken one that can move doesn't bring this node back.
+  if (branch_unexpected(!available()) && t != &_host_task &&
+      t->vruntime != std::chrono::nanoseconds{0} && redirect(t)) {
+    return;
+  }
+
+  if (current() != this) {
+    t->node = this;
+    post(t, t, 1);
+    return;
+  }
+
+  std::unique_lock<spin_lock> l(_spin_lock);
+  bool is_new = enqueue(t);
+
+  bool preempt = false;
+  if (!is_new && _curr != nullptr && _curr != _idle_task) {
+    // the caller's own vruntime is brought up to date to compare against
+    if (_curr == task::current()) charge(_curr);
+    preempt = _rq.preempts(_curr, t, wakeup_granularity());
+  }
+  l.unlock();
+
+  if (wake()) return;
+
+  // the caller yields when it releases the `preempt_mutex`
+  if (preempt) _should_yield.store(true, std::memory_order_relaxed);
+
+  // if this node is busy and has a backlog, another one may be idle and able
+  // to run |t| sooner
+  if (has_work_to_spare()) wake_idle_peer();
 }
 
-void sched_node::spin_lock::lock() {
-  // low level spin utilizing pause instruction between tries
-  bool expected = false;
-  while (
-      !_flag.compare_exchange_weak(expected, true, std::memory_order_acquire)) {
-    asm("pause");
-    expected = false;
+void sched_node::schedule_new(task* const* tasks, size_t n) {
+  if (n == 0) return;
+
+  if (current() != this) {
+    // linked last to first, since the inbox hands back the last link first
+    for (size_t i = 0; i < n; ++i) {
+      tasks[i]->node = this;
+      tasks[i]->inbox_next = i > 0 ? tasks[i - 1] : nullptr;
+    }
+    post(tasks[n - 1], tasks[0], n);
+    return;
+  }
+
+  {
+    guard l(_spin_lock);
+    for (size_t i = 0; i < n; ++i) enqueue(tasks[i]);
   }
+
+  if (!wake() && has_work_to_spare()) wake_idle_peer();
 }
 
-void sched_node::spin_lock::unlock() {
-  _flag.store(false, std::memory_order_release);
+void sched_node::switch_to(task* t) {
+  {
+    guard l(_spin_lock);
+    auto* cur = task::current();
+    charge(cur);
+    bump(_voluntary_switches);
+    if (cur->run_state == task::STOPPED) bump(_exits);
+    gthread_trace(*this, switch_to, cur, t);
+    t->node = this;
+    _rq.run_directly(t);
+    _curr = t;
+    _should_yield.store(false, std::memory_order_relaxed);
+  }
+
+  t->switch_to(&_host_task, [this]() { g_current_sched_node = this; });
 }
 
-void sched_node::schedule(task* t) {
+void sched_node::set_nice(int nice) {
   guard l(_spin_lock);
+  auto* cur = task::current();
+  charge(cur);
+  cur->set_nice(nice);
+}
+
+void sched_node::post(task* first, task* last, size_t n) {
+  // whoever finds the inbox empty tells the node. the rest of the tasks are
+  // drained along with theirs.
+  if (!_inbox.push(first, last, n) || wake()) return;
 
-  // initialize the vruntime if |t| is a new task
-  if (t->vruntime == std::chrono::microseconds{0}) {
-    t->vruntime = _rq.min_vruntime();
+  // a busy node would otherwise only drain the inbox when it next picks a
+  // task, which may be a whole tick away. its alarm is rung once until it has
+  // drained the inbox.
+  if (_running.load(std::memory_order_relaxed) && !_inbox_rung.exchange(true)) {
+    alarm::ring(_thread);
+  }
+}
+
+bool sched_node::enqueue(task* t) {
+  t->node = this;
+
+  // initialize the vruntime if |t| is a new task. a new task doesn't preempt
+  // the running one, or a task spawning many would switch to each in turn.
+  bool is_new = t->vruntime == std::chrono::nanoseconds{0};
+  if (is_new) {
+    t->vruntime = _rq.min_vruntime(t);
+    bump(_spawns);
+  } else {
+    bump(_wakeups);
   }
 
   _rq.push(t);
+  return is_new;
 }
 
-void sched_node::switch_to(task* t) {
+bool sched_node::drain_inbox(task* curr) {
+  // cleared first so that a push after the inbox is emptied rings again
+  if (_inbox_rung.load(std::memory_order_relaxed)) _inbox_rung.store(false);
+  if (_inbox.empty()) return false;
+
+  bool preempt = false;
+  for (auto* t = _inbox.take_all(); t != nullptr;) {
+    auto* next = t->inbox_next;
+    t->inbox_next = nullptr;
+    bool is_new = enqueue(t);
+    if (!is_new && curr != nullptr && !preempt) {
+      preempt = _rq.preempts(curr, t, wakeup_granularity());
+    }
+    t = next;
+  }
+  return preempt;
+}
+
+bool sched_node::try_retire(
+    internal::rq::sleepqueue_clock::time_point idle_since) {
+  // a node with sleepers has to be there to wake them
+  if (internal::rq::sleepqueue_clock::now() - idle_since < _peers->linger() ||
+      _rq.size() > 0 || _rq.sleepers() > 0 || !_inbox.empty()) {
+    return false;
+  }
+  if (!_peers->try_retire()) return false;
+
+  _retired.store(true);
+  return true;
+}
+
+bool sched_node::redirect(task* t) mt_no_analysis {
+  auto n = _peers->size();
+  for (unsigned i = 1; i < n; ++i) {
+    auto* peer = (*_peers)[(_index + i) % n];
+    if (!peer->available() || !t->may_run_on(peer->_index)) continue;
+
+    // like `steal_from()`, but neither node's lock is held already. a retired
+    // or stalled node's is never held for long, so it's taken first.
+    {
+      guard l(_spin_lock);
+      guard pl(peer->_spin_lock);
+      t->vruntime += peer->_rq.min_vruntime(t) - _rq.min_vruntime(t);
+    }
+    peer->schedule(t);
+    return true;
+  }
+  return false;
+}
+
+void sched_node::trap() {
+  if (_inbox_rung.load() && !_should_yield.load(std::memory_order_relaxed)) {
+    bool preempt;
+    {
+      guard l(_spin_lock);
+      auto* cur = task::current();
+      charge(cur);
+      preempt = drain_inbox(cur);
+    }
+
+    // the running task keeps going if nothing in the inbox is owed time. (a
+    // tick that lands together with the ring is lost, but the next one isn't.)
+    if (!preempt) {
+      if (has_work_to_spare()) wake_idle_peer();
+      return;
+    }
+  }
+
+  preempt();
+}
+
+namespace {
+int64_t steady_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
+void sched_node::enter_blocking(task* t) {
+  // the task is published last, so the rest of the mark is never older
+  _blocking_switches.store(
+      _voluntary_switches.load(std::memory_order_relaxed) +
+          _involuntary_switches.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  _blocking_since.store(steady_now_ns(), std::memory_order_relaxed);
+  _blocking_task.store(t);
+}
+
+void sched_node::exit_blocking(task* t) {
+  // another task may have marked a blocking call here since |t| moved away
+  auto* expected = t;
+  if (!_blocking_task.compare_exchange_strong(expected, nullptr)) return;
+  _stalled.store(false);
+}
+
+bool sched_node::check_stalled(std::chrono::steady_clock::time_point deadline) {
+  auto* t = _blocking_task.load();
+  bool stuck =
+      t != nullptr &&
+      _blocking_since.load(std::memory_order_relaxed) <=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              deadline.time_since_epoch())
+              .count() &&
+      _voluntary_switches.load(std::memory_order_relaxed) +
+              _involuntary_switches.load(std::memory_order_relaxed) ==
+          _blocking_switches.load(std::memory_order_relaxed);
+
+  // a task that was switched away before making the call leaves its mark
+  // behind, but the node is running other tasks
+  if (!stuck) {
+    if (stalled()) _stalled.store(false);
+    return false;
+  }
+
+  if (!_stalled.exchange(true)) bump(_stalls);
+
+  // the call may have returned (and cleared `_stalled` already) in between
+  if (_blocking_task.load() != t) {
+    _stalled.store(false);
+    return false;
+  }
+  return true;
+}
+
+size_t sched_node::hand_off(sched_node& to) {
+  // the vruntimes are taken off this node's timeline and put on |to|'s
+  // separately, so neither node's lock is held while waiting on the other's
+  task* first = nullptr;
+  task* last = nullptr;
+  size_t n = 0;
   {
-    std::lock_guard<spin_lock> l(_spin_lock);
-    auto now = vruntime_clock::now();
-    auto* cur = task::current();
-    cur->vruntime +=
-        std::chrono::duration_cast<decltype(cur->vruntime)>(now - _last_tick);
-    _last_tick = now;
+    guard l(_spin_lock);
+    drain_inbox();
+    while (auto* t = _rq.steal_if([this, &to](task* t) {
+      return t != &_host_task && t->may_run_on(to._index) &&
+             !t->on_cpu.load(std::memory_order_acquire);
+    })) {
+      t->vruntime -= _rq.min_vruntime(t);
+      t->inbox_next = nullptr;
+      (last != nullptr ? last->inbox_next : first) = t;
+      last = t;
+      ++n;
+    }
+  }
+  if (n == 0) return 0;
+
+  {
+    guard l(to._spin_lock);
+    for (auto* t = first; t != nullptr; t = t->inbox_next) {
+      t->vruntime += to._rq.min_vruntime(t);
+      t->node = &to;
+    }
   }
 
-  t->switch_to([this]() { g_current_sched_node = this; });
+  // the last one stolen had the least vruntime, so it comes out first
+  to.post(first, last, n);
+  return n;
 }
 }  // namespace gthread
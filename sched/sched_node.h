@@ -1,28 +1,233 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
+#include "arch/spin_lock.h"
+#include "platform/alarm.h"
 #include "platform/clock.h"
+#include "platform/wake_event.h"
+#include "sched/internal/inbox.h"
 #include "sched/internal/rq.h"
 #include "sched/internal/task_freelist.h"
+#include "sched/poller.h"
 #include "sched/task.h"
+#include "sched/trace.h"
 #include "util/compiler.h"
+#include "util/log_histogram.h"
 
 namespace gthread {
+class sched_node;
+
+/**
+ * the clocks a node can charge tasks' running time with
+ */
+enum class vruntime_clock_source {
+  // the kernel-managed thread's processor time (`thread_clock`). only counts
+  // time the thread really ran, but reading it is a syscall.
+  thread_cpu,
+
+  // `tsc_clock`. takes a few cycles to read, but time the kernel-managed
+  // thread spends descheduled is charged to the task that was running.
+  tsc,
+};
+
+/**
+ * a snapshot of what a node has been doing since it started. the counts only
+ * grow, so the difference of two snapshots covers the time between them.
+ */
+struct node_stats {
+  // switches away from a task that yielded or blocked, and from one that was
+  // preempted (by the alarm's trap or a woken task owed time)
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+
+  // tasks made runnable here for the first time, and tasks that stopped here
+  uint64_t spawns;
+  uint64_t exits;
+
+  // tasks made runnable again here, by another task or a sleep timer
+  uint64_t wakeups;
+
+  // how many times, and for how long, the kernel-managed thread blocked for
+  // want of work
+  uint64_t idle_sleeps;
+  std::chrono::nanoseconds idle_time;
+
+  // runnable tasks waiting now and the most there have been at once
+  unsigned rq_depth;
+  unsigned max_rq_depth;
+
+  // tasks waiting on a sleep timer now
+  unsigned sleepers;
+
+  // whether the node has retired for want of work (see
+  // `sched_node::retired()`)
+  bool retired;
+
+  // times the node was found stuck in a blocking call and its runqueue was
+  // handed to another node (see `sched_node::hand_off()`)
+  uint64_t stalls;
+
+  // percentiles of how long tasks waited to run after being made runnable
+  // here (see `sched_node::latency()`)
+  std::chrono::nanoseconds latency_p50;
+  std::chrono::nanoseconds latency_p99;
+  std::chrono::nanoseconds latency_p999;
+};
+
+/**
+ * a fixed-capacity list of nodes that can be read from any kernel-managed
+ * thread without a lock. nodes are only ever appended, but a node that has had
+ * nothing to do for a while may retire (see `sched_node::retired()`) until
+ * there is work for it again.
+ */
+class sched_node_list {
+ public:
+  static constexpr unsigned k_capacity = 256;
+
+  sched_node_list()
+      : _nodes(),
+        _size(0),
+        _active(0),
+        _min_active(1),
+        _linger_ns(std::chrono::nanoseconds::max().count()),
+        _idle(0),
+        _searching(false) {}
+
+  /**
+   * publishes |node|, which starts out active. must not be called
+   * concurrently with itself.
+   */
+  void push_back(sched_node* node) {
+    auto i = _size.load(std::memory_order_relaxed);
+    _nodes[i].store(node, std::memory_order_release);
+    _active.fetch_add(1, std::memory_order_relaxed);
+    _size.store(i + 1, std::memory_order_release);
+  }
+
+  unsigned size() const { return _size.load(std::memory_order_acquire); }
+
+  sched_node* operator[](unsigned i) const {
+    return _nodes[i].load(std::memory_order_acquire);
+  }
+
+  /**
+   * the number of nodes waiting for work. nodes with work to spare only look
+   * for one to wake when this is nonzero.
+   */
+  unsigned idle() const { return _idle.load(std::memory_order_relaxed); }
+
+  void enter_idle() { _idle.fetch_add(1); }
+  void exit_idle() { _idle.fetch_sub(1, std::memory_order_relaxed); }
+
+  /**
+   * claims the right to wake an idle node to look for work. returns false if
+   * one already is.
+   */
+  bool try_start_search() {
+    return !_searching.load(std::memory_order_relaxed) &&
+           !_searching.exchange(true);
+  }
+
+  void end_search() { _searching.store(false); }
+
+  /**
+   * the number of nodes that haven't retired
+   */
+  unsigned active() const { return _active.load(std::memory_order_relaxed); }
+
+  /**
+   * how long a node has to have had nothing to do before it retires, and how
+   * many nodes are kept active regardless. nodes never retire by default.
+   */
+  void set_retirement(unsigned min_active, std::chrono::nanoseconds linger) {
+    _min_active.store(min_active, std::memory_order_relaxed);
+    _linger_ns.store(linger.count(), std::memory_order_relaxed);
+  }
+
+  std::chrono::nanoseconds linger() const {
+    return std::chrono::nanoseconds{
+        _linger_ns.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * claims the right for a node to retire. returns false if that would leave
+   * fewer than the minimum active.
+   */
+  bool try_retire() {
+    auto active = _active.load(std::memory_order_relaxed);
+    do {
+      if (active <= _min_active.load(std::memory_order_relaxed)) return false;
+    } while (!_active.compare_exchange_weak(active, active - 1));
+    return true;
+  }
+
+  void unretire() { _active.fetch_add(1, std::memory_order_relaxed); }
+
+ private:
+  std::array<std::atomic<sched_node*>, k_capacity> _nodes;
+  std::atomic<unsigned> _size;
+  std::atomic<unsigned> _active;
+  std::atomic<unsigned> _min_active;
+  std::atomic<std::chrono::nanoseconds::rep> _linger_ns;
+  std::atomic<unsigned> _idle;
+  std::atomic<bool> _searching;
+};
+
 class sched_node {
  public:
-  sched_node(std::shared_ptr<internal::task_freelist> task_freelist)
+  /**
+   * when |peers| is given, this node steals runnable tasks from the other
+   * nodes in it rather than idling. it must then be pushed onto |peers| before
+   * another node is, since its index there picks out the state
+   * `sched_group`s keep for it.
+   */
+  sched_node(std::shared_ptr<internal::task_freelist> task_freelist,
+             sched_node_list* peers = nullptr)
       : _spin_lock(),
         _running(false),
         _deferred(nullptr),
-        _rq(),
+        _index(peers != nullptr ? peers->size() : 0),
+        _rq(_index),
+        _curr(nullptr),
+        _should_yield(false),
+        _inbox(),
+        _inbox_rung(false),
+        _retired(false),
+        _blocking_task(nullptr),
+        _blocking_since(0),
+        _blocking_switches(0),
+        _stalled(false),
+        _thread(),
+        _clock_source(vruntime_clock()),
         _task_freelist(task_freelist),
-        _host_task() {}
+        _host_task(),
+        _idle_task(nullptr),
+        _idle_event(),
+        _poller(nullptr),
+        _woken_to_search(false),
+        _peers(peers),
+        _next_victim(0) {
+    // calibrate now rather than on the first read, which may be in the trap
+    if (_clock_source == vruntime_clock_source::tsc) tsc_clock::is_invariant();
+  }
 
   /**
    * chooses a new task to run from the runqueue
    */
-  void yield() mt_locks_excluded(_spin_lock);
+  void yield() mt_locks_excluded(_spin_lock) { reschedule(false); }
+
+  /**
+   * like `yield()`, but for a task that is made to give up this node rather
+   * than asking to (counted as an involuntary switch)
+   */
+  void preempt() mt_locks_excluded(_spin_lock) { reschedule(true); }
 
   /**
    * chooses a new task to run from the runqueue and returns after at least
@@ -39,17 +244,207 @@ class sched_node {
 
   /**
    * does not put the current task on the runqueue (will not resume until
-   * stopped)
+   * stopped). this is how a node is hosted on its own kernel-managed thread.
    */
   void start() mt_locks_excluded(_spin_lock);
 
   // TODO
   // void stop();
 
+  /**
+   * makes |t| runnable on this node. may be called from any kernel-managed
+   * thread. another one doesn't take this node's lock, but pushes |t| onto
+   * the node's inbox, which the node drains into its runqueue when it next
+   * picks a task. a busy node's alarm is rung to have it drain the inbox
+   * sooner.
+   *
+   * if |t| was woken up and should run ahead of the task running here (see
+   * `internal::rq::preempts()`), that task yields as soon as it can be
+   * preempted: when it releases the `preempt_mutex` if it's the caller, or
+   * when the alarm's trap is sprung on this node's kernel-managed thread.
+   */
   void schedule(task* t) mt_locks_excluded(_spin_lock);
 
+  /**
+   * makes the |n| new tasks in |tasks| runnable on this node, taking the lock
+   * (or pushing onto the inbox, like `schedule()`) and waking the node (or a
+   * peer) once for all of them. may be called from any kernel-managed thread.
+   */
+  void schedule_new(task* const* tasks, size_t n)
+      mt_locks_excluded(_spin_lock);
+
+  /**
+   * if this node is waiting for work, makes it look at its runqueue (and its
+   * peers') again. returns false if it wasn't waiting. may be called from any
+   * kernel-managed thread, e.g. one that completed some I/O a task here is
+   * waiting on.
+   */
+  bool wake() {
+    if (!_idle_event.notify()) return false;
+    if (auto* p = _poller.load()) p->interrupt();
+    return true;
+  }
+
+  /**
+   * the I/O this node waits for along with its runqueue, or nullptr if none
+   * was set. `set_poller()` must be called on this node's kernel-managed
+   * thread, at most once, and |p| must never be destroyed.
+   */
+  poller* get_poller() const { return _poller.load(std::memory_order_relaxed); }
+  void set_poller(poller* p) { _poller.store(p); }
+
+  /**
+   * suspends the current task (or leaves it for good, if it has stopped) and
+   * runs |t| on this node. must be called from the kernel-managed thread
+   * hosting this node.
+   */
   void switch_to(task* t) mt_locks_excluded(_spin_lock);
 
+  /**
+   * whether this node has retired: once it has had nothing to do for its
+   * peers' linger time (see `sched_node_list::set_retirement()`), its
+   * kernel-managed thread blocks until there is work for it again. it isn't
+   * counted as idle, so busy peers don't wake it to steal from them, and a
+   * task woken here that may run on an active peer is moved there. may be
+   * read from any kernel-managed thread.
+   */
+  bool retired() const { return _retired.load(std::memory_order_relaxed); }
+
+  /**
+   * marks |t|, running here, as about to block this node's kernel-managed
+   * thread in a call (see `sched::enter_blocking()`), and clears the mark.
+   * `enter_blocking()` must be called on that thread, holding the
+   * `preempt_mutex`. |t| may have moved to another node by the time it calls
+   * `exit_blocking()`, which then does nothing.
+   */
+  void enter_blocking(task* t);
+  void exit_blocking(task* t);
+
+  /**
+   * whether this node has been stuck in a blocking call since before
+   * |deadline| without switching tasks. the first time it is found so, it is
+   * marked stalled, which makes it unavailable like a retired node until the
+   * call returns. may be called from any kernel-managed thread.
+   */
+  bool check_stalled(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * whether this node is stuck in a blocking call, as found by
+   * `check_stalled()`
+   */
+  bool stalled() const { return _stalled.load(std::memory_order_relaxed); }
+
+  /**
+   * whether new and woken tasks should go to this node, i.e. it is neither
+   * retired nor stalled
+   */
+  bool available() const { return !retired() && !stalled(); }
+
+  /**
+   * whether this node's kernel-managed thread is blocked waiting for work
+   */
+  bool idle() const { return _idle_event.waiting(); }
+
+  /**
+   * moves the runnable tasks waiting on this stalled node (including the ones
+   * in its inbox) that may run on |to| there, the way Go hands a processor
+   * blocked in a syscall to another thread. returns how many were moved. may
+   * be called from any kernel-managed thread.
+   */
+  size_t hand_off(sched_node& to) mt_locks_excluded(_spin_lock);
+
+  /**
+   * brings this node back from retirement to take work. returns false if it
+   * wasn't retired. may be called from any kernel-managed thread.
+   */
+  bool revive() {
+    if (!unretire()) return false;
+    wake();
+    return true;
+  }
+
+  /**
+   * runs the alarm's trap on this node's kernel-managed thread, with the
+   * `preempt_mutex` held. the running task is preempted, unless the alarm was
+   * only rung to drain the inbox and no task in it should run ahead of the
+   * running one.
+   */
+  void trap() mt_locks_excluded(_spin_lock);
+
+  /**
+   * changes the nice value of the current task, which must be running on
+   * this node. the time it has run so far is charged at its old weight.
+   */
+  void set_nice(int nice) mt_locks_excluded(_spin_lock);
+
+  /**
+   * this node's index in its peers (0 if it has none), as named in a task's
+   * `affinity`
+   */
+  unsigned index() const { return _index; }
+
+  /**
+   * the number of runnable tasks waiting on this node. may be read from any
+   * kernel-managed thread (the value is only a hint then).
+   */
+  unsigned load() const mt_no_analysis { return _rq.size() + _inbox.size(); }
+
+  /**
+   * a snapshot of this node's counters. may be read from any kernel-managed
+   * thread without stopping the node, so the counters may be slightly out of
+   * step with each other.
+   */
+  node_stats stats() const;
+
+  /**
+   * how long tasks waited between being made runnable on this node (spawned,
+   * woken or preempted) and running, in nanoseconds. may be read from any
+   * kernel-managed thread.
+   */
+  const log_histogram& latency() const mt_no_analysis { return _rq.latency(); }
+
+#ifdef GTHREAD_TRACE
+  /**
+   * records an event on this node's trace ring (see `gthread_trace()`)
+   */
+  void trace(trace::event_kind kind, const task* t, const task* other) {
+    _trace.record(kind, t, other);
+  }
+#endif
+
+  /**
+   * the events on this node's trace ring, oldest first (none unless built
+   * with `GTHREAD_TRACE`). may be called from any kernel-managed thread.
+   */
+  std::vector<trace::event> trace_events() const;
+
+  /**
+   * whether a task woken on this node should preempt the one running here, or
+   * the alarm was rung while it couldn't be to drain the inbox (either way,
+   * the task should call `trap()` once it can be preempted)
+   */
+  bool should_yield() const {
+    return _should_yield.load(std::memory_order_relaxed) ||
+           _inbox_rung.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * how far a woken task's vruntime has to be behind the running task's for
+   * it to preempt that task. a small granularity keeps wakeup latency low,
+   * and a large one saves switches. shared by every node.
+   */
+  static constexpr std::chrono::nanoseconds k_default_wakeup_granularity{
+      1000000};
+  static void set_wakeup_granularity(std::chrono::nanoseconds granularity);
+  static std::chrono::nanoseconds wakeup_granularity();
+
+  /**
+   * the clock nodes constructed from now on charge running time with. a node
+   * keeps the clock it was constructed with, so its accounting is consistent.
+   */
+  static void set_vruntime_clock(vruntime_clock_source source);
+  static vruntime_clock_source vruntime_clock();
+
   /**
    * returns the sched_node hosting the current execution context (or nullptr)
    *
@@ -58,23 +453,132 @@ class sched_node {
   static sched_node* current();
 
  private:
+  /**
+   * body of `yield()` and `preempt()`
+   */
+  void reschedule(bool preempted) mt_locks_excluded(_spin_lock);
+
   /**
    * pushes |current| to the runqueue (if running) and pops the next eligible
    * task, possibly waiting until its sleep timer has expired
    */
   task* get_next_task(task* current) mt_locks_required(_spin_lock);
 
-  // NOTE: no backoff and no fallback
-  class mt_capability("mutex") spin_lock {
-   public:
-    spin_lock() : _flag(false) {}
-    bool try_lock() mt_try_acquire(true);
-    void lock() mt_acquire();
-    void unlock() mt_release();
-
-   private:
-    std::atomic<bool> _flag;
-  };
+  /**
+   * clears `_retired` and counts this node as active again. returns false if
+   * it wasn't retired.
+   */
+  bool unretire() {
+    if (!_retired.exchange(false)) return false;
+    _peers->unretire();
+    return true;
+  }
+
+  /**
+   * whether this node has had nothing to do since |idle_since| for long enough
+   * to retire, and then claims the right to
+   */
+  bool try_retire(internal::rq::sleepqueue_clock::time_point idle_since)
+      mt_locks_required(_spin_lock);
+
+  /**
+   * schedules |t|, which was woken on this retired or stalled node, on an
+   * available peer it may run on instead, moving its vruntime onto that
+   * peer's timeline like a stolen task's. returns false if there is no such
+   * peer.
+   */
+  bool redirect(task* t) mt_locks_excluded(_spin_lock);
+
+  /**
+   * puts |t| on the runqueue, starting its vruntime at the queue's minimum if
+   * it is new. returns whether it is.
+   */
+  bool enqueue(task* t) mt_locks_required(_spin_lock);
+
+  /**
+   * moves the tasks in the inbox onto the runqueue. returns whether one that
+   * was woken up should preempt |curr| (the current task, which must have
+   * just been charged), if one is given.
+   */
+  bool drain_inbox(task* curr = nullptr) mt_locks_required(_spin_lock);
+
+  /**
+   * pushes the |n| tasks linked from |first| to |last| onto the inbox from
+   * another kernel-managed thread, and makes sure the node will see them
+   */
+  void post(task* first, task* last, size_t n);
+
+  /**
+   * the time on this node's vruntime clock
+   */
+  std::chrono::nanoseconds clock_now() const {
+    if (_clock_source == vruntime_clock_source::tsc) {
+      return tsc_clock::now().time_since_epoch();
+    }
+    return thread_clock::now().time_since_epoch();
+  }
+
+  /**
+   * charges the time since `_last_tick` to |current| and its groups, and
+   * starts the next tick
+   */
+  void charge(task* current) mt_locks_required(_spin_lock);
+
+  /**
+   * primes the idle task, which the node switches to when nothing is
+   * runnable. idling on a stack of its own means a task that stops is always
+   * switched away from, so its stack can be reused without waiting for this
+   * node to find more work.
+   */
+  void start_idle_task();
+
+  /**
+   * body of the idle task. waits for a runnable task and switches to it.
+   */
+  static void* idle_loop(void* node);
+
+  /**
+   * takes a runnable task from another node in `_peers`, or returns nullptr if
+   * none of them have one to spare. |*missed| is set if one had runnable tasks
+   * that couldn't be taken right then but could be later.
+   */
+  task* steal(bool* missed = nullptr) mt_locks_required(_spin_lock);
+
+  /**
+   * takes the runnable task from |victim| that would wait the longest to run
+   * there and that may run on this node, shifting its vruntime from
+   * |victim|'s timeline onto this node's so that it is neither starved nor
+   * favored here. |*missed| is set like in `steal()`.
+   */
+  task* steal_from(sched_node& victim, bool* missed)
+      mt_locks_required(_spin_lock);
+
+  /**
+   * whether this node has more runnable tasks than it is about to run, some
+   * of which another node could take
+   */
+  bool has_work_to_spare() const {
+    return _rq.size() > 1 && _rq.movable() > 0;
+  }
+
+  /**
+   * wakes a node in `_peers` that is waiting for work, if there is one, so it
+   * can steal some from this node
+   */
+  void wake_idle_peer();
+
+  // returns `_deferred` to the freelist if it is set
+  void return_deferred() mt_locks_required(_spin_lock);
+
+  /**
+   * adds |n| to one of the counters below. only this node's lock holder
+   * writes them, so there is no need for a read-modify-write.
+   */
+  static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+
   using guard = std::lock_guard<spin_lock>;
   spin_lock _spin_lock;
 
@@ -84,13 +588,75 @@ class sched_node {
   // running on its stack (written by `get_next_task()` and read by `yield()`)
   task* _deferred mt_guarded_by(_spin_lock);
 
+  unsigned _index;
+
   internal::rq _rq mt_guarded_by(_spin_lock);
 
-  using vruntime_clock = thread_clock;
-  vruntime_clock::time_point _last_tick mt_guarded_by(_spin_lock);
+  // the task running on this node (or the idle task)
+  task* _curr mt_guarded_by(_spin_lock);
+
+  // set when a task was woken that should preempt `_curr`, and cleared when
+  // the next task is picked
+  std::atomic<bool> _should_yield;
+
+  // tasks scheduled here from other kernel-managed threads. `_inbox_rung` is
+  // set when the alarm was rung to drain it, until `trap()` has.
+  internal::inbox _inbox;
+  std::atomic<bool> _inbox_rung;
+
+  // see `retired()`. only this node sets it, and anyone may clear it.
+  std::atomic<bool> _retired;
+
+  // the task that entered a blocking call here (or nullptr), when it did (as
+  // nanoseconds on the steady clock) and how many switches this node had made
+  // by then, so a task that was switched away before the call isn't mistaken
+  // for a stuck node
+  std::atomic<task*> _blocking_task;
+  std::atomic<int64_t> _blocking_since;
+  std::atomic<uint64_t> _blocking_switches;
+
+  // see `stalled()`
+  std::atomic<bool> _stalled;
+
+  // the kernel-managed thread hosting this node, for `alarm::ring()`
+  alarm::thread_id _thread;
+
+  vruntime_clock_source _clock_source;
+  std::chrono::nanoseconds _last_tick mt_guarded_by(_spin_lock);
 
   std::shared_ptr<internal::task_freelist> _task_freelist;
 
   task _host_task;
+
+  task* _idle_task;
+
+  // what the idle task blocks the kernel-managed thread on, unless it has a
+  // poller, which it blocks in instead (`_idle_event` still says whether it is
+  // waiting)
+  wake_event _idle_event;
+  std::atomic<poller*> _poller;
+
+  // set when `wake_idle_peer()` on another node woke this one
+  std::atomic<bool> _woken_to_search;
+
+  sched_node_list* _peers;
+
+  // where `steal()` starts looking so that victims are spread out
+  unsigned _next_victim mt_guarded_by(_spin_lock);
+
+  // see `node_stats`. written under `_spin_lock`, read by `stats()` without
+  // it.
+  std::atomic<uint64_t> _voluntary_switches{0};
+  std::atomic<uint64_t> _involuntary_switches{0};
+  std::atomic<uint64_t> _spawns{0};
+  std::atomic<uint64_t> _exits{0};
+  std::atomic<uint64_t> _wakeups{0};
+  std::atomic<uint64_t> _idle_sleeps{0};
+  std::atomic<uint64_t> _idle_ns{0};
+  std::atomic<uint64_t> _stalls{0};
+
+#ifdef GTHREAD_TRACE
+  trace::ring _trace;
+#endif
 };
 }  // namespace gthread
@@ -0,0 +1,342 @@
+#include "sched/sched.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <set>
+
+#include <poll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "platform/clock.h"
+#include "sched/preempt.h"
+
+constexpr unsigned k_concurrency = 4;
+constexpr uint64_t k_num_tasks = 1000;
+
+using namespace gthread;
+
+// `pthread_self()` is repurposed by tasks, so ask the kernel
+static long kernel_thread_id() { return syscall(SYS_gettid); }
+
+void* spinner(void* arg) {
+  for (auto start = thread_clock::now();
+       thread_clock::now() - start < std::chrono::milliseconds{1};) {
+    sched::yield();
+  }
+  return reinterpret_cast<void*>(kernel_thread_id());
+}
+
+TEST(gthread_sched_smp, vruntime_clock) {
+  EXPECT_EQ(sched::get_vruntime_clock(), vruntime_clock_source::thread_cpu);
+
+  // the nodes are started after this, so every test here accounts with the
+  // timestamp counter
+  sched::set_vruntime_clock(vruntime_clock_source::tsc);
+  EXPECT_EQ(sched::get_vruntime_clock(), vruntime_clock_source::tsc);
+  sched::set_concurrency(k_concurrency);
+}
+
+TEST(gthread_sched_smp, set_concurrency) {
+  EXPECT_THROW(sched::set_concurrency(0), std::domain_error);
+  EXPECT_THROW(sched::set_concurrency(sched::k_max_concurrency + 1),
+               std::domain_error);
+
+  sched::set_concurrency(k_concurrency);
+  EXPECT_EQ(sched::get_concurrency(), k_concurrency);
+
+  // the pool does not shrink
+  sched::set_concurrency(1);
+  EXPECT_EQ(sched::get_concurrency(), k_concurrency);
+}
+
+TEST(gthread_sched_smp, tasks_run_on_many_kernel_threads) {
+  sched::set_concurrency(k_concurrency);
+
+  for (auto a : {k_light_attr, k_default_attr}) {
+    sched::handle threads[k_num_tasks];
+    for (uint64_t i = 0; i < k_num_tasks; ++i) {
+      threads[i] = sched::spawn(a, spinner, nullptr);
+    }
+
+    std::set<long> kernel_threads;
+    for (uint64_t i = 0; i < k_num_tasks; ++i) {
+      void* ret;
+      sched::join(&threads[i], &ret);
+      kernel_threads.insert(reinterpret_cast<long>(ret));
+    }
+    // idle nodes steal work, so a node may not end up finishing any tasks
+    EXPECT_GT(kernel_threads.size(), 1u);
+    EXPECT_LE(kernel_threads.size(), k_concurrency);
+  }
+}
+
+void* sleeper(void* arg) {
+  sched::sleep_for(std::chrono::milliseconds{5});
+  return arg;
+}
+
+TEST(gthread_sched_smp, cross_node_join) {
+  sched::set_concurrency(k_concurrency);
+
+  sched::handle threads[k_num_tasks];
+  for (uint64_t i = 0; i < k_num_tasks; ++i) {
+    threads[i] = sched::spawn(k_light_attr, sleeper, (void*)i);
+  }
+  for (uint64_t i = 0; i < k_num_tasks; ++i) {
+    void* ret;
+    sched::join(&threads[i], &ret);
+    EXPECT_EQ((uint64_t)ret, i);
+  }
+}
+
+std::atomic<uint64_t> g_detached_done{0};
+
+void* detached_worker(void* _) {
+  sched::yield();
+  g_detached_done.fetch_add(1);
+  return nullptr;
+}
+
+TEST(gthread_sched_smp, cross_node_detach) {
+  sched::set_concurrency(k_concurrency);
+
+  for (uint64_t i = 0; i < k_num_tasks; ++i) {
+    auto h = sched::spawn(k_light_attr, detached_worker, nullptr);
+    sched::detach(&h);
+  }
+  while (g_detached_done.load() < k_num_tasks) {
+    sched::yield();
+  }
+}
+
+void* hopper(void* arg) {
+  auto iterations = reinterpret_cast<uint64_t>(arg);
+
+  std::set<long> kernel_threads{kernel_thread_id()};
+  for (uint64_t i = 0; i < iterations; ++i) {
+    for (auto start = thread_clock::now();
+         thread_clock::now() - start < std::chrono::microseconds{20};) {
+    }
+    sched::yield();
+    kernel_threads.insert(kernel_thread_id());
+  }
+  return reinterpret_cast<void*>(kernel_threads.size());
+}
+
+TEST(gthread_sched_smp, idle_nodes_steal_work) {
+  sched::set_concurrency(k_concurrency);
+
+  // nodes get uneven amounts of work, leaving some of them idle while others
+  // still have tasks waiting to run
+  constexpr uint64_t k_hoppers = 4 * k_concurrency;
+  sched::handle threads[k_hoppers];
+  for (uint64_t i = 0; i < k_hoppers; ++i) {
+    threads[i] = sched::spawn(k_light_attr, hopper, (void*)(50 * (i + 1)));
+  }
+
+  bool migrated = false;
+  for (uint64_t i = 0; i < k_hoppers; ++i) {
+    void* ret;
+    sched::join(&threads[i], &ret);
+    migrated |= reinterpret_cast<uint64_t>(ret) > 1;
+  }
+  EXPECT_TRUE(migrated);
+}
+
+TEST(gthread_sched_smp, affinity_pins_tasks) {
+  sched::set_concurrency(k_concurrency);
+
+  auto a = k_light_attr;
+  a.affinity.set(k_max_affinity_nodes - 1);
+  EXPECT_THROW(sched::spawn(a, hopper, nullptr), std::domain_error);
+
+  // the other nodes are idle, so they would steal these if they could
+  a = k_light_attr;
+  a.affinity.set(2);
+  constexpr uint64_t k_pinned = 4 * k_concurrency;
+  sched::handle threads[k_pinned];
+  for (uint64_t i = 0; i < k_pinned; ++i) {
+    threads[i] = sched::spawn(a, hopper, (void*)50);
+  }
+  for (uint64_t i = 0; i < k_pinned; ++i) {
+    void* ret;
+    sched::join(&threads[i], &ret);
+    EXPECT_EQ(reinterpret_cast<uint64_t>(ret), 1u);
+  }
+
+  // and these only ever run on one of two nodes
+  a.affinity.set(1);
+  std::set<long> kernel_threads;
+  for (uint64_t i = 0; i < k_pinned; ++i) {
+    threads[i] = sched::spawn(a, spinner, nullptr);
+  }
+  for (uint64_t i = 0; i < k_pinned; ++i) {
+    void* ret;
+    sched::join(&threads[i], &ret);
+    kernel_threads.insert(reinterpret_cast<long>(ret));
+  }
+  EXPECT_LE(kernel_threads.size(), 2u);
+}
+
+void* report_thread(void* _) {
+  return reinterpret_cast<void*>(kernel_thread_id());
+}
+
+TEST(gthread_sched_smp, placement_policies) {
+  sched::set_concurrency(k_concurrency);
+
+  EXPECT_THROW(sched::set_placement(placement_policy::scheduler_default),
+               std::domain_error);
+  EXPECT_EQ(sched::get_placement(), placement_policy::round_robin);
+
+  // a lone task placed locally is run by this node once this task waits
+  auto a = k_light_attr;
+  a.placement = placement_policy::local;
+  for (int i = 0; i < 100; ++i) {
+    auto h = sched::spawn(a, report_thread, nullptr);
+    void* ret;
+    sched::join(&h, &ret);
+    EXPECT_EQ(reinterpret_cast<long>(ret), kernel_thread_id());
+  }
+
+  // every policy places tasks on nodes they may run on
+  a.affinity.set(1);
+  a.affinity.set(3);
+  for (auto policy :
+       {placement_policy::local, placement_policy::round_robin,
+        placement_policy::least_loaded, placement_policy::two_choices}) {
+    sched::set_placement(policy);
+    a.placement = placement_policy::scheduler_default;
+
+    sched::handle threads[k_num_tasks];
+    void* args[k_num_tasks] = {};
+    sched::spawn_n(a, report_thread, args, k_num_tasks, threads);
+    void* rets[k_num_tasks];
+    sched::join_all(threads, k_num_tasks, rets);
+
+    std::set<long> kernel_threads;
+    for (auto* ret : rets) kernel_threads.insert(reinterpret_cast<long>(ret));
+    EXPECT_LE(kernel_threads.size(), 2u);
+    EXPECT_EQ(kernel_threads.count(kernel_thread_id()), 0u);
+  }
+  sched::set_placement(placement_policy::round_robin);
+}
+
+std::atomic<bool> g_hogging{false};
+
+void* hog(void* _) {
+  while (g_hogging.load()) {
+  }
+  return nullptr;
+}
+
+void* exit_later(void* _) {
+  sched::sleep_for(std::chrono::milliseconds{10});
+  return reinterpret_cast<void*>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+void* time_join(void* arg) {
+  void* exited;
+  sched::join(static_cast<sched::handle*>(arg), &exited);
+  auto woken = std::chrono::steady_clock::now().time_since_epoch().count();
+  return reinterpret_cast<void*>(woken - reinterpret_cast<intptr_t>(exited));
+}
+
+TEST(gthread_sched_smp, remote_wakeups_preempt_busy_nodes) {
+  sched::set_concurrency(k_concurrency);
+
+  // a task on node 1 is woken from node 0 while node 1 runs a task that never
+  // yields. the waker doesn't take node 1's lock, but rings its alarm to have
+  // it take the task, which is owed time, well before the next tick.
+  auto on_0 = k_light_attr;
+  on_0.affinity.set(0);
+  auto on_1 = k_light_attr;
+  on_1.affinity.set(1);
+
+  for (int i = 0; i < 5; ++i) {
+    auto exiter = sched::spawn(on_0, exit_later, nullptr);
+    auto joiner = sched::spawn(on_1, time_join, &exiter);
+    sched::sleep_for(std::chrono::milliseconds{2});
+
+    g_hogging.store(true);
+    auto hogger = sched::spawn(on_1, hog, nullptr);
+
+    void* latency;
+    sched::join(&joiner, &latency);
+    g_hogging.store(false);
+    sched::join(&hogger, nullptr);
+
+    EXPECT_LT(std::chrono::steady_clock::duration{
+                  reinterpret_cast<intptr_t>(latency)},
+              preempt_interval / 2);
+  }
+}
+
+void* write_byte(void* arg) {
+  char c = 'x';
+  auto fd = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+  return reinterpret_cast<void*>(write(fd, &c, 1));
+}
+
+TEST(gthread_sched_smp, blocking_calls_hand_off_tasks) {
+  sched::set_concurrency(k_concurrency);
+  EXPECT_THROW(sched::exit_blocking(), std::logic_error);
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  auto stalls_before = sched::stats()[0].stalls;
+
+  // this (the root) task blocks node 0 until a task queued behind it there
+  // writes to the pipe. the writer only gets to run if it's handed off.
+  auto local = k_light_attr;
+  local.placement = placement_policy::local;
+  auto writer = sched::spawn(local, write_byte,
+                             reinterpret_cast<void*>(intptr_t{fds[1]}));
+
+  pollfd p{fds[0], POLLIN, 0};
+  sched::enter_blocking();
+  auto ready = poll(&p, 1, 2000);
+  sched::exit_blocking();
+  EXPECT_EQ(ready, 1);
+
+  void* written;
+  sched::join(&writer, &written);
+  EXPECT_EQ(reinterpret_cast<intptr_t>(written), 1);
+  EXPECT_GE(sched::stats()[0].stalls, stalls_before + 1);
+  EXPECT_FALSE(sched::stats()[0].retired);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void* noop(void* arg) { return arg; }
+
+TEST(gthread_sched_smp, idle_nodes_wake_quickly) {
+  sched::set_concurrency(k_concurrency);
+
+  // spawns land on idle nodes, and each join waits on a task finishing on
+  // another kernel-managed thread. a node that polled for work would take at
+  // least its polling interval for each round trip.
+  constexpr int k_round_trips = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < k_round_trips; ++i) {
+    auto h = sched::spawn(k_light_attr, noop, nullptr);
+    sched::join(&h, nullptr);
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds{500});
+}
+
+TEST(gthread_sched_smp, idle_nodes_use_no_cpu) {
+  sched::set_concurrency(k_concurrency);
+
+  // every node, including this one, is idle while this task sleeps
+  auto cpu_start = std::clock();
+  sched::sleep_for(std::chrono::milliseconds{100});
+  EXPECT_LT(std::clock() - cpu_start, CLOCKS_PER_SEC / 50);
+}
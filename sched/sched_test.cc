@@ -5,6 +5,7 @@
 
 #include "gtest/gtest.h"
 #include "platform/clock.h"
+#include "sched/preempt.h"
 
 constexpr uint64_t k_num_tasks = 1000;
 constexpr uint64_t k_num_stress_tasks = 10000;
@@ -24,6 +25,36 @@ TEST(gthread_sched, basic_spawn_and_join) {
   EXPECT_EQ(reinterpret_cast<intptr_t>(ret), 6);
 }
 
+void* plus_one(void* arg) {
+  return reinterpret_cast<void*>(reinterpret_cast<uint64_t>(arg) + 1);
+}
+
+TEST(gthread_sched, spawn_n_and_join_all) {
+  EXPECT_THROW(sched::spawn_n(k_light_attr, nullptr, nullptr, 1, nullptr),
+               std::domain_error);
+
+  void* args[k_num_tasks];
+  for (uint64_t i = 0; i < k_num_tasks; ++i) {
+    args[i] = reinterpret_cast<void*>(i);
+  }
+
+  sched::handle threads[k_num_tasks];
+  for (int round = 0; round < 3; ++round) {
+    sched::spawn_n(k_light_attr, plus_one, args, k_num_tasks, threads);
+
+    void* rets[k_num_tasks];
+    sched::join_all(threads, k_num_tasks, rets);
+    for (uint64_t i = 0; i < k_num_tasks; ++i) {
+      EXPECT_FALSE(threads[i]);
+      EXPECT_EQ(reinterpret_cast<uint64_t>(rets[i]), i + 1);
+    }
+  }
+
+  // nothing to do for an empty batch
+  sched::spawn_n(k_light_attr, plus_one, nullptr, 0, nullptr);
+  sched::join_all(nullptr, 0, nullptr);
+}
+
 void* test_thread(void* arg) {
   uint64_t i = (uint64_t)arg;
   for (auto start = thread_clock::now();
@@ -207,3 +238,310 @@ TEST(gthread_sched, detach_test_exit_delay) {
   auto h = sched::spawn(k_light_attr, exit_delay, nullptr);
   sched::join(&h, nullptr);
 }
+
+TEST(gthread_sched, set_nice) {
+  EXPECT_THROW(sched::set_nice(k_min_nice - 1), std::domain_error);
+  EXPECT_THROW(sched::set_nice(k_max_nice + 1), std::domain_error);
+
+  auto a = k_light_attr;
+  a.nice = k_max_nice + 1;
+  EXPECT_THROW(sched::spawn(a, exit_quick, nullptr), std::domain_error);
+
+  sched::set_nice(3);
+  EXPECT_EQ(sched::get_nice(), 3);
+  sched::set_nice(0);
+  EXPECT_EQ(sched::get_nice(), 0);
+}
+
+TEST(gthread_sched, set_wakeup_granularity) {
+  EXPECT_THROW(sched::set_wakeup_granularity(std::chrono::nanoseconds{-1}),
+               std::domain_error);
+
+  auto granularity = sched::get_wakeup_granularity();
+  EXPECT_EQ(granularity, sched_node::k_default_wakeup_granularity);
+  sched::set_wakeup_granularity(std::chrono::microseconds{100});
+  EXPECT_EQ(sched::get_wakeup_granularity(), std::chrono::microseconds{100});
+  sched::set_wakeup_granularity(granularity);
+}
+
+// runs through at least one tick of the preemption timer
+void* busy(void* _) {
+  for (auto start = thread_clock::now();
+       thread_clock::now() - start <
+       preempt_interval + std::chrono::milliseconds{10};) {
+  }
+  return nullptr;
+}
+
+TEST(gthread_sched, stats) {
+  auto before = sched::stats();
+  ASSERT_EQ(before.size(), sched::get_concurrency());
+
+  constexpr size_t k_tasks = 10;
+  sched::handle threads[k_tasks];
+  void* args[k_tasks] = {};
+  sched::spawn_n(k_light_attr, returner, args, k_tasks, threads);
+  sched::join_all(threads, k_tasks, nullptr);
+
+  // this task is alone, so the node idles while it sleeps and it is woken by
+  // its timer
+  sched::sleep_for(std::chrono::milliseconds{20});
+
+  // neither of these yields, so they only share the node by being preempted
+  auto a = sched::spawn(k_light_attr, busy, nullptr);
+  auto b = sched::spawn(k_light_attr, busy, nullptr);
+  sched::join(&a, nullptr);
+  sched::join(&b, nullptr);
+
+  auto after = sched::stats();
+  ASSERT_EQ(after.size(), before.size());
+  auto& s0 = before[0];
+  auto& s1 = after[0];
+  EXPECT_EQ(s1.spawns - s0.spawns, k_tasks + 2);
+  EXPECT_EQ(s1.exits - s0.exits, k_tasks + 2);
+  EXPECT_GE(s1.voluntary_switches - s0.voluntary_switches, k_tasks + 2);
+  EXPECT_GE(s1.involuntary_switches - s0.involuntary_switches, 1u);
+  EXPECT_GE(s1.wakeups - s0.wakeups, 1u);
+  EXPECT_GE(s1.idle_sleeps - s0.idle_sleeps, 1u);
+  EXPECT_GE(s1.idle_time - s0.idle_time, std::chrono::milliseconds{10});
+  EXPECT_GE(s1.max_rq_depth, k_tasks);
+  EXPECT_EQ(s1.rq_depth, 0u);
+  EXPECT_EQ(s1.sleepers, 0u);
+}
+
+TEST(gthread_sched, scheduling_latency) {
+  auto before = sched::scheduling_latency();
+
+  // each of these waits behind the ones spawned before it, so the tail is at
+  // least as long as the longest of them ran
+  constexpr size_t k_tasks = 3;
+  sched::handle threads[k_tasks];
+  for (auto& t : threads) t = sched::spawn(k_light_attr, busy, nullptr);
+  for (auto& t : threads) sched::join(&t, nullptr);
+
+  auto latency = sched::scheduling_latency();
+  latency.subtract(before);
+  EXPECT_GE(latency.count(), k_tasks);
+  EXPECT_LE(latency.percentile(0.5), latency.percentile(0.99));
+  EXPECT_LE(latency.percentile(0.99), latency.percentile(0.999));
+  EXPECT_GE(std::chrono::nanoseconds{latency.percentile(1)},
+            std::chrono::milliseconds{1});
+
+  auto s = sched::stats()[0];
+  EXPECT_GT(s.latency_p50, std::chrono::nanoseconds::zero());
+  EXPECT_LE(s.latency_p50, s.latency_p99);
+  EXPECT_LE(s.latency_p99, s.latency_p999);
+}
+
+std::atomic<bool> g_marked{false};
+
+void* marker(void* _) {
+  g_marked = true;
+  return nullptr;
+}
+
+TEST(gthread_sched, join_hands_off_to_joiner) {
+  EXPECT_TRUE(sched::get_join_handoff());
+
+  // |marker| is queued behind |child|, but this task is switched to as soon
+  // as |child| stops
+  g_marked = false;
+  auto child = sched::spawn(k_light_attr, returner, nullptr);
+  auto other = sched::spawn(k_light_attr, marker, nullptr);
+  void* ret;
+  sched::join(&child, &ret);
+  EXPECT_EQ(reinterpret_cast<intptr_t>(ret), 1);
+  EXPECT_FALSE(g_marked.load());
+  sched::join(&other, nullptr);
+  EXPECT_TRUE(g_marked.load());
+
+  // without the handoff, joins still complete
+  sched::set_join_handoff(false);
+  EXPECT_FALSE(sched::get_join_handoff());
+  child = sched::spawn(k_light_attr, returner, nullptr);
+  sched::join(&child, &ret);
+  EXPECT_EQ(reinterpret_cast<intptr_t>(ret), 1);
+  sched::set_join_handoff(true);
+}
+
+void* nice_getter(void* _) {
+  return reinterpret_cast<void*>(static_cast<intptr_t>(sched::get_nice()));
+}
+
+TEST(gthread_sched, spawn_with_nice) {
+  auto a = k_light_attr;
+  a.nice = -7;
+  auto h = sched::spawn(a, nice_getter, nullptr);
+  void* ret;
+  sched::join(&h, &ret);
+  EXPECT_EQ(reinterpret_cast<intptr_t>(ret), -7);
+
+  // tasks are reused, but not their nice values
+  h = sched::spawn(k_light_attr, nice_getter, nullptr);
+  sched::join(&h, &ret);
+  EXPECT_EQ(reinterpret_cast<intptr_t>(ret), 0);
+}
+
+std::atomic<bool> g_stop_counting{false};
+
+void* counter(void* arg) {
+  auto* count = static_cast<uint64_t*>(arg);
+  while (!g_stop_counting.load()) {
+    for (auto start = thread_clock::now();
+         thread_clock::now() - start < std::chrono::microseconds{10};) {
+    }
+    ++*count;
+    sched::yield();
+  }
+  return nullptr;
+}
+
+TEST(gthread_sched, nice_weighs_processor_share) {
+  // nice -5 has ~9x the weight of nice 5
+  uint64_t heavy_count = 0, light_count = 0;
+  auto heavy_attr = k_light_attr, light_attr = k_light_attr;
+  heavy_attr.nice = -5;
+  light_attr.nice = 5;
+
+  g_stop_counting = false;
+  auto heavy = sched::spawn(heavy_attr, counter, &heavy_count);
+  auto light = sched::spawn(light_attr, counter, &light_count);
+  sched::sleep_for(std::chrono::milliseconds{200});
+  g_stop_counting = true;
+  sched::join(&heavy, nullptr);
+  sched::join(&light, nullptr);
+
+  EXPECT_GT(light_count, 0u);
+  EXPECT_GT(heavy_count, 3 * light_count);
+}
+
+TEST(gthread_sched, sched_group_rejects_bad_nice) {
+  EXPECT_THROW(sched_group{k_max_nice + 1}, std::domain_error);
+}
+
+TEST(gthread_sched, sched_groups_share_processor) {
+  // one task in one group competes with many in another
+  constexpr int k_crowd = 8;
+  sched_group lonely, crowded;
+  uint64_t lonely_count = 0, crowd_counts[k_crowd] = {};
+
+  auto lonely_attr = k_light_attr, crowd_attr = k_light_attr;
+  lonely_attr.group = &lonely;
+  crowd_attr.group = &crowded;
+
+  g_stop_counting = false;
+  auto h = sched::spawn(lonely_attr, counter, &lonely_count);
+  sched::handle crowd[k_crowd];
+  for (int i = 0; i < k_crowd; ++i) {
+    crowd[i] = sched::spawn(crowd_attr, counter, &crowd_counts[i]);
+  }
+  sched::sleep_for(std::chrono::milliseconds{200});
+  g_stop_counting = true;
+  sched::join(&h, nullptr);
+
+  uint64_t crowd_count = 0;
+  for (int i = 0; i < k_crowd; ++i) {
+    sched::join(&crowd[i], nullptr);
+    crowd_count += crowd_counts[i];
+  }
+
+  // without groups, the lone task would get 1/9 of the processor
+  EXPECT_GT(crowd_count, 0u);
+  EXPECT_GT(2 * lonely_count, crowd_count);
+}
+
+TEST(gthread_sched, nested_sched_groups_split_parent_share) {
+  sched_group parent, sibling;
+  sched_group heavy_child{-5, &parent}, light_child{5, &parent};
+  uint64_t heavy_count = 0, light_count = 0, sibling_count = 0;
+
+  auto heavy_attr = k_light_attr, light_attr = k_light_attr,
+       sibling_attr = k_light_attr;
+  heavy_attr.group = &heavy_child;
+  light_attr.group = &light_child;
+  sibling_attr.group = &sibling;
+
+  g_stop_counting = false;
+  auto heavy = sched::spawn(heavy_attr, counter, &heavy_count);
+  auto light = sched::spawn(light_attr, counter, &light_count);
+  auto other = sched::spawn(sibling_attr, counter, &sibling_count);
+  sched::sleep_for(std::chrono::milliseconds{200});
+  g_stop_counting = true;
+  sched::join(&heavy, nullptr);
+  sched::join(&light, nullptr);
+  sched::join(&other, nullptr);
+
+  // the children split half of the processor ~9:1
+  EXPECT_GT(light_count, 0u);
+  EXPECT_GT(heavy_count, 3 * light_count);
+  EXPECT_GT(2 * sibling_count, heavy_count + light_count);
+  EXPECT_GT(2 * (heavy_count + light_count), sibling_count);
+}
+
+TEST(gthread_sched, deadline_rejects_bad_params) {
+  auto a = k_light_attr;
+  a.deadline = {std::chrono::milliseconds{2}, std::chrono::milliseconds{1}};
+  EXPECT_THROW(sched::spawn(a, exit_quick, nullptr), std::domain_error);
+  a.deadline = {std::chrono::milliseconds{-1}, std::chrono::milliseconds{1}};
+  EXPECT_THROW(sched::spawn(a, exit_quick, nullptr), std::domain_error);
+}
+
+TEST(gthread_sched, deadline_admission) {
+  // each reserves 40% of the processor, so only two fit at once
+  auto a = k_light_attr;
+  a.deadline = {std::chrono::milliseconds{4}, std::chrono::milliseconds{10}};
+
+  auto first = sched::spawn(a, exit_delay, nullptr);
+  auto second = sched::spawn(a, exit_delay, nullptr);
+  EXPECT_THROW(sched::spawn(a, exit_delay, nullptr), std::system_error);
+
+  // a reservation is given back when its task ends
+  sched::join(&first, nullptr);
+  auto third = sched::spawn(a, exit_delay, nullptr);
+  sched::join(&second, nullptr);
+  sched::join(&third, nullptr);
+}
+
+std::chrono::steady_clock::duration g_deadline_task_took;
+
+void* deadline_worker(void* _) {
+  // 20 slices of 200us of work, each of which takes a fair task at nice 19
+  // longer to catch up on than the spinners at nice -20 take in seconds
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 20; ++i) {
+    for (auto slice_start = thread_clock::now();
+         thread_clock::now() - slice_start < std::chrono::microseconds{200};) {
+    }
+    sched::yield();
+  }
+  g_deadline_task_took = std::chrono::steady_clock::now() - start;
+
+  g_stop_counting = true;
+  return nullptr;
+}
+
+TEST(gthread_sched, deadline_tasks_run_before_fair_tasks) {
+  constexpr int k_spinners = 4;
+  auto spinner_attr = k_light_attr;
+  spinner_attr.nice = k_min_nice;
+  auto deadline_attr = k_light_attr;
+  deadline_attr.nice = k_max_nice;
+  deadline_attr.deadline = {std::chrono::milliseconds{5},
+                            std::chrono::milliseconds{10}};
+
+  g_stop_counting = false;
+  uint64_t counts[k_spinners] = {};
+  sched::handle spinners[k_spinners];
+  for (int i = 0; i < k_spinners; ++i) {
+    spinners[i] = sched::spawn(spinner_attr, counter, &counts[i]);
+  }
+  auto h = sched::spawn(deadline_attr, deadline_worker, nullptr);
+
+  // the deadline task stops the spinners when it is done, so this task gets
+  // to run again
+  sched::join(&h, nullptr);
+  for (int i = 0; i < k_spinners; ++i) sched::join(&spinners[i], nullptr);
+
+  // 4ms of work at 5ms out of every 10ms
+  EXPECT_LT(g_deadline_task_took, std::chrono::milliseconds{100});
+}
@@ -40,9 +40,25 @@ task::task()
       return_value{nullptr},
       joiner{nullptr},
       detached{false},
+      lifecycle_lock{},
+      node{nullptr},
+      on_cpu{false},
+      inbox_next{nullptr},
+      blocking_depth{0},
+      blocking_node{nullptr},
+      runnable_since{},
       vruntime{0},
       priority_boost{0},
-      no_preempt_flag{false} {}
+      nice{0},
+      weight{k_nice_0_weight},
+      group{nullptr},
+      dl_runtime{0},
+      dl_deadline{0},
+      dl_budget{0},
+      dl_period_end{},
+      affinity{},
+      no_preempt_flag{false},
+      _switched_from{nullptr} {}
 
 namespace {
 static void* sixteen_byte_align(void* p) {
@@ -63,9 +79,25 @@ task::task(void* stack, void* stack_begin, size_t total_stack_size,
       return_value{nullptr},
       joiner{nullptr},
       detached{false},
+      lifecycle_lock{},
+      node{nullptr},
+      on_cpu{false},
+      inbox_next{nullptr},
+      blocking_depth{0},
+      blocking_node{nullptr},
+      runnable_since{},
       vruntime{0},
       priority_boost{0},
-      no_preempt_flag{false} {
+      nice{0},
+      weight{k_nice_0_weight},
+      group{nullptr},
+      dl_runtime{0},
+      dl_deadline{0},
+      dl_budget{0},
+      dl_period_end{},
+      affinity{},
+      no_preempt_flag{false},
+      _switched_from{nullptr} {
   if (alloc_tls) {
     void* tls_begin = (void*)((char*)_stack_begin - tls::postfix_bytes());
     _tls = new (tls_begin) tls();
@@ -97,21 +129,59 @@ void task::reset() {
   return_value = nullptr;
   joiner = nullptr;
   detached = false;
-  vruntime = std::chrono::microseconds{0};
+  node = nullptr;
+  blocking_depth = 0;
+  blocking_node = nullptr;
+  vruntime = std::chrono::nanoseconds{0};
   priority_boost = 0;
+  set_nice(0);
+  group = nullptr;
+  dl_runtime = dl_deadline = dl_budget = std::chrono::nanoseconds{0};
+  dl_period_end = deadline_clock::time_point{};
+  affinity.reset();
   no_preempt_flag.store(false);
 }
 
+namespace {
+/**
+ * weights for nice values from `k_min_nice` to `k_max_nice`, the same as
+ * linux's CFS uses. each step is about 1.25x, so a task one nice level
+ * lower than another gets about 10% more of the processor.
+ */
+constexpr uint32_t k_nice_to_weight[k_max_nice - k_min_nice + 1] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548,  7620,  6100,  4904,  3906,
+    /*  -5 */ 3121,  2501,  1991,  1586,  1277,
+    /*   0 */ 1024,  820,   655,   526,   423,
+    /*   5 */ 335,   272,   215,   172,   137,
+    /*  10 */ 110,   87,    70,    56,    45,
+    /*  15 */ 36,    29,    23,    18,    15,
+};
+static_assert(k_nice_to_weight[-k_min_nice] == task::k_nice_0_weight,
+              "nice 0 must have the default weight");
+}  // namespace
+
+uint32_t task::weight_of(int nice) {
+  assert(nice >= k_min_nice && nice <= k_max_nice);
+  return k_nice_to_weight[nice - k_min_nice];
+}
+
+void task::set_nice(int n) {
+  nice = n;
+  weight = weight_of(n);
+}
+
 extern "C" {
 // root of task stack trace! :)
-static void gthread_task_entry(void* arg) {
-  // swtich back to the starter to clean up
-  gthread_saved_ctx_t** from_and_to = (gthread_saved_ctx_t**)arg;
-  gthread_switch_to(from_and_to[0], from_and_to[1]);
-
-  // when we are here, tls should be set up
+static void gthread_task_entry() {
+  // when we are here, tls should be set up. the preemption trap leaves a
+  // task alone until it has finished switching, and must not find it in its
+  // `start()`ed `SUSPENDED` state after that, or it would be switched away
+  // from without being put back on a runqueue.
   auto* cur = task::current();
   cur->run_state = task::RUNNING;
+  cur->finish_switch();
   cur->stop(cur->entry(cur->arg));
 }
 }
@@ -119,12 +189,9 @@ static void gthread_task_entry(void* arg) {
 void task::start() {
   assert(branch_unexpected(run_state == STOPPED));
 
-  auto* cur = current();
-  assert(this != cur);
+  assert(this != current());
 
-  gthread_saved_ctx_t* new_and_cur[2] = {&this->_ctx, &cur->_ctx};
-  gthread_switch_to_and_spawn(&cur->_ctx, _stack_begin, gthread_task_entry,
-                              new_and_cur);
+  gthread_prime_ctx(&_ctx, _stack_begin, gthread_task_entry);
   run_state = SUSPENDED;
 }
 
@@ -136,7 +203,7 @@ void task::stop(void* return_value) {
   gthread_log_fatal("task end handler did not stop the task!");
 }
 
-void task::switch_to() { switch_to_internal<void()>(nullptr); }
+void task::switch_to() { switch_to_internal<void()>(nullptr, nullptr); }
 
 void task::set_end_handler(end_handler handler) { _end_handler = handler; }
 
@@ -144,6 +211,7 @@ void task::wrap_current() {
   // most of struct is zero-initialized
   _tls = tls::current();
   run_state = RUNNING;
+  on_cpu.store(true);
 
   _tls->set_thread(this);
 }
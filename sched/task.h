@@ -4,14 +4,20 @@
 #include <chrono>
 #include <functional>
 
+#include "arch/spin_lock.h"
 #include "arch/switch_to.h"
+#include "platform/clock.h"
 #include "platform/tls.h"
 #include "sched/task_attr.h"
 #include "util/compiler.h"
+#include "util/rb_tree.h"
+#include "util/timing_wheel.h"
 
 // TODO: create task_host
 
 namespace gthread {
+class sched_node;
+
 struct task {
  public:
   /**
@@ -43,9 +49,10 @@ struct task {
   void reset();
 
   /**
-   * quickly starts task and switches back to the caller. meant to just get
-   * things primed. it is undefined (like reaaallly undefined) as to what
-   * happens when a task is switched to that hasn't been `start()`ed.
+   * primes the task to run its entry point when it is first switched to,
+   * without switching to it now. it is undefined (like reaaallly undefined)
+   * as to what happens when a task is switched to that hasn't been
+   * `start()`ed.
    */
   void start();
 
@@ -72,6 +79,28 @@ struct task {
   template <typename Thunk>
   void switch_to(const Thunk& post_tls_switch_thunk);
 
+  /**
+   * like `switch_to(post_tls_switch_thunk)`, but if `this` doesn't have its
+   * own tls, it runs on |host|'s (the task wrapping the kernel-managed thread)
+   * instead of on whatever tls was last in use. otherwise the tls of a task
+   * could stay in use on a kernel-managed thread after the task has left it.
+   */
+  template <typename Thunk>
+  void switch_to(task* host, const Thunk& post_tls_switch_thunk);
+
+  /**
+   * must be run by a task as soon as it resumes from a context switch. clears
+   * `on_cpu` of the task that was switched away from since its context is now
+   * completely saved.
+   */
+  inline void finish_switch();
+
+  /**
+   * true while the task has been switched to but has not yet called
+   * `finish_switch()`. the task must not be preempted then.
+   */
+  bool finishing_switch() const { return _switched_from != nullptr; }
+
   using end_handler = std::function<void(task*)>;
   static void set_end_handler(end_handler handler);
 
@@ -98,9 +127,106 @@ struct task {
 
   task* joiner;
   bool detached;
-  std::chrono::microseconds vruntime;
+
+  /**
+   * guards the transition to `STOPPED` against `joiner` and `detached` being
+   * set from another kernel-managed thread
+   */
+  spin_lock lifecycle_lock;
+
+  /**
+   * the node the task is running on or is queued to run on
+   */
+  sched_node* node;
+
+  /**
+   * true from when the task is switched to until its context has been
+   * completely saved after it switches away. until then, the task must not be
+   * resumed by another kernel-managed thread and its stack must not be reused.
+   */
+  std::atomic<bool> on_cpu;
+
+  /**
+   * links the task into a runqueue while it is runnable, or into the freelist
+   * while it is unused, so neither has to allocate
+   */
+  rb_node rq_node;
+
+  /**
+   * links the task into a node's inbox while another kernel-managed thread
+   * hands it over (see `sched_node::schedule()`)
+   */
+  task* inbox_next;
+
+  /**
+   * how deeply the task is nested in `sched::enter_blocking()` calls, and the
+   * node it entered the outermost one on
+   */
+  unsigned blocking_depth;
+  sched_node* blocking_node;
+
+  /**
+   * arms the task's wakeup in a sleepqueue while it is sleeping
+   */
+  timing_wheel_node sleep_node;
+
+  /**
+   * when the task was last made runnable, for its runqueue to measure how long
+   * it waited to run
+   */
+  tsc_clock::time_point runnable_since;
+
+  std::chrono::nanoseconds vruntime;
   uint64_t priority_boost;  // TODO: remove
 
+  /**
+   * the task's nice value and the weight it maps to. vruntime accrues at
+   * `k_nice_0_weight / weight` times the rate the task actually runs, so a
+   * heavier task is picked more often.
+   */
+  int nice;
+  uint32_t weight;
+
+  static constexpr uint32_t k_nice_0_weight = 1024;
+
+  /**
+   * the weight of |nice|, which must be in [`k_min_nice`, `k_max_nice`]
+   */
+  static uint32_t weight_of(int nice);
+
+  /**
+   * sets `nice` and `weight`. |nice| must be in [`k_min_nice`, `k_max_nice`].
+   */
+  void set_nice(int nice);
+
+  /**
+   * the group the task's processor time is accounted to (or nullptr)
+   */
+  sched_group* group;
+
+  using deadline_clock = std::chrono::steady_clock;
+
+  /**
+   * the deadline class parameters from the task's `attr` (`dl_runtime` is
+   * zero for fair tasks), how much of `dl_runtime` is left in the current
+   * period, and when the period ends
+   */
+  std::chrono::nanoseconds dl_runtime;
+  std::chrono::nanoseconds dl_deadline;
+  std::chrono::nanoseconds dl_budget;
+  deadline_clock::time_point dl_period_end;
+
+  bool is_deadline() const { return dl_runtime.count() != 0; }
+
+  /**
+   * the nodes the task may run on (any of them if empty)
+   */
+  affinity_mask affinity;
+
+  bool may_run_on(unsigned node_index) const {
+    return affinity.none() || affinity.test(node_index);
+  }
+
   /**
    * signifies to the preemption alarm to not preempt this task for the time
    * being
@@ -115,7 +241,10 @@ struct task {
   task(void* stack, void* stack_begin, size_t total_stack_size, bool alloc_tls);
 
   template <typename Thunk>
-  void switch_to_internal(const Thunk* post_tls_switch_thunk);
+  void switch_to_internal(task* host, const Thunk* post_tls_switch_thunk);
+
+  // written by the task that switched to this one (read in `finish_switch()`)
+  task* _switched_from;
 
   static end_handler _end_handler;
 };
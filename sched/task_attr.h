@@ -1,8 +1,47 @@
 #pragma once
 
+#include <bitset>
+#include <chrono>
 #include <cstdlib>
 
 namespace gthread {
+class sched_group;
+
+/**
+ * the most nodes an `affinity_mask` can name
+ */
+constexpr unsigned k_max_affinity_nodes = 256;
+
+/**
+ * a set of scheduler nodes, by index: node 0 is hosted on the kernel-managed
+ * thread that first used the scheduler, and the rest are numbered in the
+ * order `sched::set_concurrency()` brings them up
+ */
+using affinity_mask = std::bitset<k_max_affinity_nodes>;
+
+/**
+ * how `sched::spawn()` picks the node a new task starts on, out of the ones
+ * its affinity allows
+ */
+enum class placement_policy {
+  // whichever policy `sched::set_placement()` chose
+  scheduler_default,
+
+  // the spawning task's node, so the new task starts with warm caches. falls
+  // back to `round_robin` if that node isn't allowed.
+  local,
+
+  // each node in turn
+  round_robin,
+
+  // the node with the fewest runnable tasks waiting
+  least_loaded,
+
+  // the less loaded of two nodes picked at random, which balances nearly as
+  // well as `least_loaded` without looking at every node
+  two_choices,
+};
+
 struct attr {
   struct stack_t {
     void* addr;
@@ -11,15 +50,66 @@ struct attr {
   } stack;
 
   bool alloc_tls;
+
+  /**
+   * weighs the task's share of the processor against the other tasks on its
+   * node like `nice(2)`: in [`k_min_nice`, `k_max_nice`], where each step up
+   * gives it about 10% less. 0 if left out of an initializer.
+   */
+  int nice;
+
+  /**
+   * the group the task shares its processor time with, or nullptr to compete
+   * with the top-level tasks and groups on its own. the group must outlive
+   * the task.
+   */
+  sched_group* group;
+
+  /**
+   * puts the task in the deadline class when `runtime` is nonzero. it may
+   * then run for up to `runtime` in every `deadline`, ahead of every task in
+   * the fair class (and every group), with the earliest deadline first. once
+   * it has used up its runtime, it runs as a fair task until its next period.
+   *
+   * `runtime` must not be more than `deadline`. spawning the task is refused
+   * if deadline tasks would reserve too much of the processor together (see
+   * `sched::k_max_deadline_utilization`).
+   */
+  struct deadline_t {
+    std::chrono::nanoseconds runtime;
+    std::chrono::nanoseconds deadline;
+  } deadline;
+
+  /**
+   * the nodes the task may run on, e.g. the one that owns the data it works
+   * on, so its caches stay warm. it is spawned on one of them and is never
+   * moved to another node. empty (the default) lets it run anywhere.
+   *
+   * spawning the task is refused unless one of the nodes is running.
+   */
+  affinity_mask affinity;
+
+  /**
+   * how the node the task starts on is picked
+   */
+  placement_policy placement;
 };
 
+constexpr int k_min_nice = -20;
+constexpr int k_max_nice = 19;
+
 /**
  * task attributes that "feel" like a kernel thread: comes with a large stack
  * and thread-local storage turned on
  */
 constexpr attr k_default_attr = {
     {nullptr, 4 * 1024 * 1024, static_cast<size_t>(-1)},
-    true  // each task gets its own thread_locals
+    true,     // each task gets its own thread_locals
+    0,        // an even share of the processor
+    nullptr,  // not in a group
+    {},       // in the fair class
+    {},       // runs on any node
+    placement_policy::scheduler_default,
 };
 
 /**
@@ -27,6 +117,11 @@ constexpr attr k_default_attr = {
  */
 constexpr attr k_light_attr = {
     {nullptr, 4 * 1024 * 1024, static_cast<size_t>(-1)},
-    false  // no TLS so no errno and shared locale things
+    false,    // no TLS so no errno and shared locale things
+    0,        // an even share of the processor
+    nullptr,  // not in a group
+    {},       // in the fair class
+    {},       // runs on any node
+    placement_policy::scheduler_default,
 };
 }  // namespace gthread
@@ -2,6 +2,8 @@
 
 #include <benchmark/benchmark.h>
 
+#include "platform/clock.h"
+
 static void* mirror(void* arg) {
   auto* t = (gthread::task*)arg;
   while (true) t->switch_to();
@@ -44,6 +46,46 @@ static void benchmark_task_switch_to_with_tls(benchmark::State& state) {
 
 BENCHMARK(benchmark_task_switch_to_with_tls);
 
+/**
+ * a switch and back, timed with |Clock| the way a node charges each task for
+ * the time it ran
+ */
+template <typename Clock>
+static void benchmark_task_switch_to_charged(benchmark::State& state) {
+  gthread::task root_task{};
+  root_task.wrap_current();
+
+  auto* t = gthread::task::create(gthread::k_light_attr);
+  t->entry = mirror;
+  t->arg = &root_task;
+  t->start();
+
+  auto last_tick = Clock::now();
+  typename Clock::duration charged{0};
+  for (auto _ : state) {
+    t->switch_to();
+    auto now = Clock::now();
+    charged += now - last_tick;
+    last_tick = now;
+  }
+  benchmark::DoNotOptimize(charged);
+
+  t->destroy();
+}
+
+BENCHMARK_TEMPLATE(benchmark_task_switch_to_charged, gthread::thread_clock);
+BENCHMARK_TEMPLATE(benchmark_task_switch_to_charged, gthread::tsc_clock);
+
+template <typename Clock>
+static void benchmark_clock_now(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Clock::now());
+  }
+}
+
+BENCHMARK_TEMPLATE(benchmark_clock_now, gthread::thread_clock);
+BENCHMARK_TEMPLATE(benchmark_clock_now, gthread::tsc_clock);
+
 static void benchmark_task_start(benchmark::State& state) {
   auto* t = gthread::task::create(gthread::k_default_attr);
 
@@ -10,7 +10,7 @@ namespace gthread {
 inline task* task::current() { return (task*)tls::current_thread(); }
 
 template <typename Thunk>
-void task::switch_to_internal(const Thunk* post_tls_switch_thunk) {
+void task::switch_to_internal(task* host, const Thunk* post_tls_switch_thunk) {
   auto* prev_task = current();
   assert(this != prev_task && "switching to current task is a logic error");
 
@@ -19,10 +19,19 @@ void task::switch_to_internal(const Thunk* post_tls_switch_thunk) {
     prev_task->run_state = SUSPENDED;
   }
 
+  // `task::current()` reports |this| as soon as the tls is switched, so the
+  // preemption trap must see |this| as still switching from then on. it would
+  // otherwise save the context it interrupts (still |prev_task|'s) as |this|'s.
+  on_cpu.store(true, std::memory_order_relaxed);
+  _switched_from = prev_task;
+
   // officially in the |task|'s context
   if (_tls != nullptr) {
     _tls->set_thread(this);
     _tls->use();
+  } else if (host != nullptr) {
+    host->_tls->set_thread(this);
+    host->_tls->use();
   } else {
     tls::current()->set_thread(this);
   }
@@ -34,11 +43,24 @@ void task::switch_to_internal(const Thunk* post_tls_switch_thunk) {
   gthread_switch_to(&prev_task->_ctx, &_ctx);
 
   assert(prev_task == current() && "switched back to not myself");
+  prev_task->finish_switch();
   prev_task->run_state = RUNNING;
 }
 
+void task::finish_switch() {
+  if (_switched_from != nullptr) {
+    _switched_from->on_cpu.store(false, std::memory_order_release);
+    _switched_from = nullptr;
+  }
+}
+
 template <typename Thunk>
 void task::switch_to(const Thunk& post_tls_switch_thunk) {
-  switch_to_internal(&post_tls_switch_thunk);
+  switch_to_internal(nullptr, &post_tls_switch_thunk);
+}
+
+template <typename Thunk>
+void task::switch_to(task* host, const Thunk& post_tls_switch_thunk) {
+  switch_to_internal(host, &post_tls_switch_thunk);
 }
 }  // namespace gthread
@@ -0,0 +1,104 @@
+#include "sched/trace.h"
+
+#include <algorithm>
+#include <ios>
+
+namespace gthread {
+namespace trace {
+const char* name(event_kind kind) {
+  switch (kind) {
+    case event_kind::switch_to:
+      return "switch_to";
+    case event_kind::spawn:
+      return "spawn";
+    case event_kind::park:
+      return "park";
+    case event_kind::unpark:
+      return "unpark";
+    case event_kind::sleep:
+      return "sleep";
+    case event_kind::exit:
+      return "exit";
+  }
+  return "unknown";
+}
+
+std::vector<event> ring::snapshot() const {
+  auto end = _head.load(std::memory_order_acquire);
+  auto begin = end > k_capacity ? end - k_capacity : 0;
+
+  std::vector<event> events;
+  events.reserve(end - begin);
+  for (auto i = begin; i < end; ++i) {
+    events.push_back(_events[i & k_mask]);
+  }
+
+  // the writer may have lapped the copy. it could have overwritten anything up
+  // to the slot after its last published event, so that much is dropped.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto head = _head.load(std::memory_order_relaxed);
+  if (head + 1 > begin + k_capacity) {
+    auto lapped = std::min<uint64_t>(head + 1 - k_capacity - begin,
+                                     events.size());
+    events.erase(events.begin(), events.begin() + lapped);
+  }
+  return events;
+}
+
+void write_chrome_json(std::ostream& out,
+                       const std::vector<std::vector<event>>& nodes,
+                       tsc_clock::rep end) {
+  // timestamps are relative to the first event so they stay readable
+  auto origin = end;
+  for (const auto& events : nodes) {
+    if (!events.empty()) origin = std::min(origin, events.front().time);
+  }
+
+  auto flags = out.flags();
+  auto precision = out.precision();
+  out.setf(std::ios::fixed, std::ios::floatfield);
+  out.precision(3);
+
+  // in microseconds, which is what the format expects
+  auto us = [](tsc_clock::rep ns) { return ns / 1000.0; };
+  auto id = [](const void* t) { return reinterpret_cast<uintptr_t>(t); };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+      << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+      << "\"args\":{\"name\":\"gthread\"}}";
+
+  for (size_t node = 0; node < nodes.size(); ++node) {
+    const void* running = nullptr;
+    tsc_clock::rep since = 0;
+    auto end_slice = [&](tsc_clock::rep t) {
+      if (running == nullptr) return;
+      out << ",\n{\"name\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+          << id(running) << ",\"ts\":" << us(since - origin)
+          << ",\"dur\":" << us(t - since) << ",\"args\":{\"node\":" << node
+          << "}}";
+    };
+
+    for (const auto& e : nodes[node]) {
+      if (e.kind == event_kind::switch_to) {
+        end_slice(e.time);
+        running = e.other;
+        since = e.time;
+        continue;
+      }
+
+      out << ",\n{\"name\":\"" << name(e.kind)
+          << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << id(e.task)
+          << ",\"ts\":" << us(e.time - origin) << ",\"args\":{\"node\":"
+          << node;
+      if (e.other != nullptr) out << ",\"task\":" << id(e.other);
+      out << "}}";
+    }
+    end_slice(std::max(end, since));
+  }
+
+  out << "\n]}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+}  // namespace trace
+}  // namespace gthread
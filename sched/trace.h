@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "platform/clock.h"
+
+/**
+ * records an event on |node|'s trace ring when the scheduler is built with
+ * `GTHREAD_TRACE` (`--define gthread_trace=1`), and compiles to nothing
+ * otherwise (the arguments aren't evaluated). must be called on |node|'s
+ * kernel-managed thread while the caller can't be preempted, i.e. holding the
+ * `preempt_mutex` or |node|'s lock.
+ */
+#ifdef GTHREAD_TRACE
+#define gthread_trace(node, kind, task, other) \
+  (node).trace(::gthread::trace::event_kind::kind, task, other)
+#else
+#define gthread_trace(node, kind, task, other) ((void)0)
+#endif
+
+namespace gthread {
+namespace trace {
+#ifdef GTHREAD_TRACE
+constexpr bool k_enabled = true;
+#else
+constexpr bool k_enabled = false;
+#endif
+
+enum class event_kind : uint32_t {
+  // |task| switched to |other| (either is null for the node's idle task)
+  switch_to,
+
+  // |task| spawned |other|
+  spawn,
+
+  // |task| blocked on a `waiter`. one that hands off to the task it wakes
+  // (`waiter::swap()`) only records the `unpark` and the switch.
+  park,
+
+  // |task| woke |other| from a `waiter`
+  unpark,
+
+  // |task| went to sleep on a timer
+  sleep,
+
+  // |task| stopped
+  exit,
+};
+
+const char* name(event_kind kind);
+
+struct event {
+  // on `tsc_clock`
+  tsc_clock::rep time;
+  event_kind kind;
+  const void* task;
+  const void* other;
+};
+
+/**
+ * a node's most recent events. it has a single writer, the node's
+ * kernel-managed thread, which never waits on a reader. when it is full, the
+ * oldest events are overwritten.
+ */
+class ring {
+ public:
+  static constexpr size_t k_capacity = 1 << 15;
+
+  ring() : _events(), _head(0) {}
+
+  void record(event_kind kind, const void* task, const void* other) {
+    auto i = _head.load(std::memory_order_relaxed);
+    _events[i & k_mask] = {tsc_clock::now().time_since_epoch().count(), kind,
+                           task, other};
+    _head.store(i + 1, std::memory_order_release);
+  }
+
+  /**
+   * copies out the events in the ring, oldest first. may be called from any
+   * kernel-managed thread while the writer keeps going; events it overwrote
+   * during the copy are left out.
+   */
+  std::vector<event> snapshot() const;
+
+ private:
+  static constexpr size_t k_mask = k_capacity - 1;
+
+  std::array<event, k_capacity> _events;
+
+  // the number of events ever recorded
+  std::atomic<uint64_t> _head;
+};
+
+/**
+ * writes |nodes|' events (e.g. their `ring::snapshot()`s) as a Chrome
+ * trace-event JSON object, which chrome://tracing and Perfetto load. each task
+ * gets a track of the slices it ran for, annotated with the node it ran on,
+ * and the other events are marked on it. a slice still running at the end of
+ * a node's events ends at |end|.
+ */
+void write_chrome_json(std::ostream& out,
+                       const std::vector<std::vector<event>>& nodes,
+                       tsc_clock::rep end);
+}  // namespace trace
+}  // namespace gthread
@@ -0,0 +1,125 @@
+#include "sched/trace.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "sched/sched.h"
+
+using namespace gthread;
+
+static size_t count(const std::string& s, const std::string& needle) {
+  size_t n = 0;
+  for (auto i = s.find(needle); i != std::string::npos;
+       i = s.find(needle, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+TEST(gthread_trace, ring_keeps_events_in_order) {
+  auto r = std::make_unique<trace::ring>();
+  EXPECT_TRUE(r->snapshot().empty());
+
+  int a, b;
+  r->record(trace::event_kind::spawn, &a, &b);
+  r->record(trace::event_kind::switch_to, &a, &b);
+  r->record(trace::event_kind::exit, &b, nullptr);
+
+  auto events = r->snapshot();
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].kind, trace::event_kind::spawn);
+  EXPECT_EQ(events[0].task, &a);
+  EXPECT_EQ(events[0].other, &b);
+  EXPECT_EQ(events[1].kind, trace::event_kind::switch_to);
+  EXPECT_EQ(events[2].kind, trace::event_kind::exit);
+  EXPECT_EQ(events[2].task, &b);
+  EXPECT_LE(events[0].time, events[1].time);
+  EXPECT_LE(events[1].time, events[2].time);
+}
+
+TEST(gthread_trace, ring_overwrites_oldest_events) {
+  auto r = std::make_unique<trace::ring>();
+  for (uintptr_t i = 0; i < trace::ring::k_capacity + 10; ++i) {
+    r->record(trace::event_kind::park, reinterpret_cast<void*>(i), nullptr);
+  }
+
+  // the slot the writer would fill next isn't trusted either
+  auto events = r->snapshot();
+  ASSERT_EQ(events.size(), trace::ring::k_capacity - 1);
+  EXPECT_EQ(events.front().task, reinterpret_cast<void*>(11));
+  EXPECT_EQ(events.back().task,
+            reinterpret_cast<void*>(trace::ring::k_capacity + 9));
+}
+
+TEST(gthread_trace, writes_chrome_json) {
+  int a, b;
+  auto* t_a = reinterpret_cast<const void*>(&a);
+  auto* t_b = reinterpret_cast<const void*>(&b);
+  std::vector<std::vector<trace::event>> nodes{
+      {
+          {1000, trace::event_kind::switch_to, nullptr, t_a},
+          {2000, trace::event_kind::spawn, t_a, t_b},
+          {3000, trace::event_kind::switch_to, t_a, t_b},
+          {4000, trace::event_kind::exit, t_b, nullptr},
+          {5000, trace::event_kind::switch_to, t_b, nullptr},
+      },
+      {
+          {2500, trace::event_kind::switch_to, nullptr, t_a},
+      },
+  };
+
+  std::ostringstream out;
+  trace::write_chrome_json(out, nodes, 6000);
+  auto json = out.str();
+
+  auto tid = [](const void* t) {
+    return "\"tid\":" + std::to_string(reinterpret_cast<uintptr_t>(t));
+  };
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+  EXPECT_EQ(json.substr(json.size() - 3), "]}\n");
+
+  // |a| runs on node 0 from 1us to 3us and on node 1 from 2.5us to the end,
+  // and |b| on node 0 from 3us to 5us
+  EXPECT_EQ(count(json, "\"name\":\"run\""), 3u);
+  EXPECT_NE(json.find(tid(t_a) + ",\"ts\":0.000,\"dur\":2.000,"
+                      "\"args\":{\"node\":0}"),
+            std::string::npos);
+  EXPECT_NE(json.find(tid(t_b) + ",\"ts\":2.000,\"dur\":2.000,"
+                      "\"args\":{\"node\":0}"),
+            std::string::npos);
+  EXPECT_NE(json.find(tid(t_a) + ",\"ts\":1.500,\"dur\":3.500,"
+                      "\"args\":{\"node\":1}"),
+            std::string::npos);
+
+  auto spawn = "\"name\":\"spawn\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1," +
+               tid(t_a) + ",\"ts\":1.000,\"args\":{\"node\":0,\"task\":" +
+               std::to_string(reinterpret_cast<uintptr_t>(t_b)) + "}";
+  EXPECT_NE(json.find(spawn), std::string::npos);
+  EXPECT_EQ(count(json, "\"name\":\"exit\""), 1u);
+}
+
+void* parker(void* arg) {
+  sched::sleep_for(std::chrono::milliseconds{1});
+  return arg;
+}
+
+TEST(gthread_trace, write_trace) {
+  auto h = sched::spawn(k_light_attr, parker, nullptr);
+  sched::join(&h, nullptr);
+
+  std::ostringstream out;
+  sched::write_trace(out);
+  auto json = out.str();
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+
+  if (!trace::k_enabled) {
+    EXPECT_EQ(count(json, "\"ph\":\"X\""), 0u);
+    return;
+  }
+  EXPECT_GE(count(json, "\"name\":\"spawn\""), 1u);
+  EXPECT_GE(count(json, "\"name\":\"sleep\""), 1u);
+  EXPECT_GE(count(json, "\"name\":\"exit\""), 1u);
+  EXPECT_GE(count(json, "\"name\":\"run\""), 2u);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gthread {
+/**
+ * the |T| that |m| is the |Member| of (or nullptr if |m| is nullptr)
+ *
+ * like `offsetof()`, but from a member pointer, so it works for the
+ * non-standard-layout types the intrusive containers link together
+ */
+template <typename T, typename M, M T::*Member>
+T* container_of(M* m) {
+  if (m == nullptr) return nullptr;
+
+  // the storage is never constructed; only the address of |Member| within it
+  // is taken
+  alignas(T) static char storage[sizeof(T)];
+  auto offset = reinterpret_cast<uintptr_t>(
+                    &(reinterpret_cast<T*>(storage)->*Member)) -
+                reinterpret_cast<uintptr_t>(storage);
+
+  return reinterpret_cast<T*>(reinterpret_cast<char*>(m) - offset);
+}
+}  // namespace gthread
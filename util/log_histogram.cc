@@ -0,0 +1,67 @@
+#include "util/log_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gthread {
+log_histogram& log_histogram::operator=(const log_histogram& other) {
+  for (auto& c : _counts) c.store(0, std::memory_order_relaxed);
+  _count.store(0, std::memory_order_relaxed);
+  add(other);
+  return *this;
+}
+
+uint64_t log_histogram::lowest(unsigned bucket) {
+  if (bucket < 2 * k_sub_buckets) return bucket;
+  unsigned shift = bucket / k_sub_buckets - 1;
+  return static_cast<uint64_t>(bucket - shift * k_sub_buckets) << shift;
+}
+
+uint64_t log_histogram::highest(unsigned bucket) {
+  if (bucket < 2 * k_sub_buckets) return bucket;
+  unsigned shift = bucket / k_sub_buckets - 1;
+  return lowest(bucket) + ((uint64_t{1} << shift) - 1);
+}
+
+void log_histogram::add(const log_histogram& other) {
+  uint64_t total = 0;
+  for (unsigned i = 0; i < k_buckets; ++i) {
+    auto n = other._counts[i].load(std::memory_order_relaxed);
+    _counts[i].store(_counts[i].load(std::memory_order_relaxed) + n,
+                     std::memory_order_relaxed);
+    total += n;
+  }
+
+  // the total is kept in step with the buckets that were copied rather than
+  // with |other|'s, which its writer may have moved on since
+  _count.store(_count.load(std::memory_order_relaxed) + total,
+               std::memory_order_relaxed);
+}
+
+void log_histogram::subtract(const log_histogram& other) {
+  uint64_t total = 0;
+  for (unsigned i = 0; i < k_buckets; ++i) {
+    auto mine = _counts[i].load(std::memory_order_relaxed);
+    auto n = std::min(mine, other._counts[i].load(std::memory_order_relaxed));
+    _counts[i].store(mine - n, std::memory_order_relaxed);
+    total += n;
+  }
+  _count.store(_count.load(std::memory_order_relaxed) - total,
+               std::memory_order_relaxed);
+}
+
+uint64_t log_histogram::percentile(double quantile) const {
+  auto count = this->count();
+  if (count == 0) return 0;
+
+  auto rank = static_cast<uint64_t>(std::ceil(quantile * count));
+  if (rank == 0) rank = 1;
+
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < k_buckets; ++i) {
+    seen += _counts[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return highest(i);
+  }
+  return highest(k_buckets - 1);
+}
+}  // namespace gthread
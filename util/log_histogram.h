@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gthread {
+/**
+ * counts nonnegative integers (e.g. nanoseconds) in log-linear buckets like
+ * HdrHistogram's. values below `2 * k_sub_buckets` get a bucket each, and
+ * every power of two above that is split into `k_sub_buckets` equal buckets,
+ * so a value is known to within 1/`k_sub_buckets` of itself whatever its
+ * magnitude.
+ *
+ * it has a single writer, which need not synchronize with readers. a reader
+ * copies it (every count is loaded on its own, so a copy made while the writer
+ * keeps going may be slightly out of step with itself).
+ */
+class log_histogram {
+ public:
+  static constexpr unsigned k_sub_bucket_bits = 4;
+  static constexpr unsigned k_sub_buckets = 1u << k_sub_bucket_bits;
+  static constexpr unsigned k_buckets = (64 - k_sub_bucket_bits + 1) *
+                                        k_sub_buckets;
+
+  log_histogram() : _counts(), _count(0) {}
+
+  log_histogram(const log_histogram& other) : log_histogram() { add(other); }
+  log_histogram& operator=(const log_histogram& other);
+
+  /**
+   * the bucket |value| is counted in
+   */
+  static unsigned bucket_of(uint64_t value) {
+    if (value < 2 * k_sub_buckets) return static_cast<unsigned>(value);
+    unsigned shift = 63 - __builtin_clzll(value) - k_sub_bucket_bits;
+    return shift * k_sub_buckets + static_cast<unsigned>(value >> shift);
+  }
+
+  /**
+   * the smallest and largest values counted in |bucket|
+   */
+  static uint64_t lowest(unsigned bucket);
+  static uint64_t highest(unsigned bucket);
+
+  /**
+   * counts |value|. only the single writer may call this.
+   */
+  void record(uint64_t value) {
+    auto& c = _counts[bucket_of(value)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _count.store(_count.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  }
+
+  /**
+   * adds |other|'s counts to this one's, or takes them away (e.g. to leave
+   * what was counted between two copies). `this` must not have a writer.
+   */
+  void add(const log_histogram& other);
+  void subtract(const log_histogram& other);
+
+  uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+
+  /**
+   * the value that |quantile| (in [0, 1]) of the counted values are at or
+   * below, rounded up to the top of its bucket. 0 if nothing was counted.
+   */
+  uint64_t percentile(double quantile) const;
+
+ private:
+  std::array<std::atomic<uint64_t>, k_buckets> _counts;
+  std::atomic<uint64_t> _count;
+};
+}  // namespace gthread
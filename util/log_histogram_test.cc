@@ -0,0 +1,60 @@
+#include "util/log_histogram.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using namespace gthread;
+
+TEST(log_histogram, buckets_cover_every_value) {
+  // small values are exact
+  for (uint64_t v = 0; v < 2 * log_histogram::k_sub_buckets; ++v) {
+    EXPECT_EQ(log_histogram::bucket_of(v), v);
+    EXPECT_EQ(log_histogram::lowest(v), v);
+    EXPECT_EQ(log_histogram::highest(v), v);
+  }
+
+  // buckets are contiguous, and each is a small fraction of its values
+  for (unsigned b = 1; b < log_histogram::k_buckets; ++b) {
+    EXPECT_EQ(log_histogram::lowest(b), log_histogram::highest(b - 1) + 1);
+    EXPECT_EQ(log_histogram::bucket_of(log_histogram::lowest(b)), b);
+    EXPECT_EQ(log_histogram::bucket_of(log_histogram::highest(b)), b);
+    EXPECT_LE(log_histogram::highest(b) - log_histogram::lowest(b),
+              log_histogram::lowest(b) / log_histogram::k_sub_buckets);
+  }
+  EXPECT_EQ(log_histogram::highest(log_histogram::k_buckets - 1), UINT64_MAX);
+}
+
+TEST(log_histogram, percentiles) {
+  auto h = std::make_unique<log_histogram>();
+  EXPECT_EQ(h->percentile(0.5), 0u);
+
+  for (uint64_t v = 1; v <= 1000; ++v) h->record(v * 1000);
+  EXPECT_EQ(h->count(), 1000u);
+
+  auto within = [](uint64_t got, uint64_t want) {
+    EXPECT_GE(got, want);
+    EXPECT_LE(got, want + want / log_histogram::k_sub_buckets);
+  };
+  within(h->percentile(0.5), 500000);
+  within(h->percentile(0.99), 990000);
+  within(h->percentile(0.999), 999000);
+  within(h->percentile(1), 1000000);
+  within(h->percentile(0), 1000);
+}
+
+TEST(log_histogram, add_and_subtract) {
+  auto a = std::make_unique<log_histogram>();
+  for (int i = 0; i < 100; ++i) a->record(10);
+  auto before = std::make_unique<log_histogram>(*a);
+
+  for (int i = 0; i < 100; ++i) a->record(1000000);
+  auto delta = std::make_unique<log_histogram>(*a);
+  delta->subtract(*before);
+  EXPECT_EQ(delta->count(), 100u);
+  EXPECT_GE(delta->percentile(0), 1000000u);
+
+  delta->add(*before);
+  EXPECT_EQ(delta->count(), 200u);
+  EXPECT_EQ(delta->percentile(0.5), 10u);
+}
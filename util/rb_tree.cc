@@ -0,0 +1,203 @@
+#include "util/rb_tree.h"
+
+namespace gthread {
+namespace internal {
+namespace {
+bool is_red(const rb_node* n) { return n != nullptr && n->red; }
+
+// puts |v| where |u| is in |u|'s parent
+void replace_child(rb_node** root, rb_node* u, rb_node* v) {
+  if (u->parent == nullptr) {
+    *root = v;
+  } else if (u == u->parent->left) {
+    u->parent->left = v;
+  } else {
+    u->parent->right = v;
+  }
+  if (v != nullptr) v->parent = u->parent;
+}
+
+void rotate_left(rb_node** root, rb_node* x) {
+  rb_node* y = x->right;
+  x->right = y->left;
+  if (y->left != nullptr) y->left->parent = x;
+  replace_child(root, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+void rotate_right(rb_node** root, rb_node* x) {
+  rb_node* y = x->left;
+  x->left = y->right;
+  if (y->right != nullptr) y->right->parent = x;
+  replace_child(root, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/**
+ * restores the black height after a black node was removed from above |x|
+ * (which may be nullptr, hence |parent|)
+ */
+void erase_fixup(rb_node** root, rb_node* x, rb_node* parent) {
+  while (x != *root && !is_red(x)) {
+    if (x == parent->left) {
+      rb_node* w = parent->right;
+      if (is_red(w)) {
+        w->red = false;
+        parent->red = true;
+        rotate_left(root, parent);
+        w = parent->right;
+      }
+      if (!is_red(w->left) && !is_red(w->right)) {
+        w->red = true;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if (!is_red(w->right)) {
+          w->left->red = false;
+          w->red = true;
+          rotate_right(root, w);
+          w = parent->right;
+        }
+        w->red = parent->red;
+        parent->red = false;
+        w->right->red = false;
+        rotate_left(root, parent);
+        x = *root;
+      }
+    } else {
+      rb_node* w = parent->left;
+      if (is_red(w)) {
+        w->red = false;
+        parent->red = true;
+        rotate_right(root, parent);
+        w = parent->left;
+      }
+      if (!is_red(w->left) && !is_red(w->right)) {
+        w->red = true;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if (!is_red(w->left)) {
+          w->right->red = false;
+          w->red = true;
+          rotate_left(root, w);
+          w = parent->left;
+        }
+        w->red = parent->red;
+        parent->red = false;
+        w->left->red = false;
+        rotate_right(root, parent);
+        x = *root;
+      }
+    }
+  }
+  if (x != nullptr) x->red = false;
+}
+}  // namespace
+
+void rb_insert_fixup(rb_node** root, rb_node* n) {
+  rb_node* parent;
+  while ((parent = n->parent) != nullptr && parent->red) {
+    // |parent| is red, so it isn't the root and |grandparent| exists
+    rb_node* grandparent = parent->parent;
+    if (parent == grandparent->left) {
+      rb_node* uncle = grandparent->right;
+      if (is_red(uncle)) {
+        parent->red = false;
+        uncle->red = false;
+        grandparent->red = true;
+        n = grandparent;
+        continue;
+      }
+      if (n == parent->right) {
+        rotate_left(root, parent);
+        n = parent;
+        parent = n->parent;
+      }
+      parent->red = false;
+      grandparent->red = true;
+      rotate_right(root, grandparent);
+    } else {
+      rb_node* uncle = grandparent->left;
+      if (is_red(uncle)) {
+        parent->red = false;
+        uncle->red = false;
+        grandparent->red = true;
+        n = grandparent;
+        continue;
+      }
+      if (n == parent->left) {
+        rotate_right(root, parent);
+        n = parent;
+        parent = n->parent;
+      }
+      parent->red = false;
+      grandparent->red = true;
+      rotate_left(root, grandparent);
+    }
+  }
+  (*root)->red = false;
+}
+
+void rb_erase(rb_node** root, rb_node* n) {
+  rb_node* x;
+  rb_node* x_parent;
+  bool removed_red = n->red;
+
+  if (n->left == nullptr) {
+    x = n->right;
+    x_parent = n->parent;
+    replace_child(root, n, n->right);
+  } else if (n->right == nullptr) {
+    x = n->left;
+    x_parent = n->parent;
+    replace_child(root, n, n->left);
+  } else {
+    // |n| has two children, so its successor takes its place
+    rb_node* successor = rb_first(n->right);
+    removed_red = successor->red;
+    x = successor->right;
+    if (successor->parent == n) {
+      x_parent = successor;
+    } else {
+      x_parent = successor->parent;
+      replace_child(root, successor, successor->right);
+      successor->right = n->right;
+      successor->right->parent = successor;
+    }
+    replace_child(root, n, successor);
+    successor->left = n->left;
+    successor->left->parent = successor;
+    successor->red = n->red;
+  }
+
+  if (!removed_red) erase_fixup(root, x, x_parent);
+}
+
+rb_node* rb_next(rb_node* n) {
+  if (n->right != nullptr) return rb_first(n->right);
+  while (n->parent != nullptr && n == n->parent->right) n = n->parent;
+  return n->parent;
+}
+
+rb_node* rb_prev(rb_node* n) {
+  if (n->left != nullptr) return rb_last(n->left);
+  while (n->parent != nullptr && n == n->parent->left) n = n->parent;
+  return n->parent;
+}
+
+rb_node* rb_first(rb_node* root) {
+  if (root == nullptr) return nullptr;
+  while (root->left != nullptr) root = root->left;
+  return root;
+}
+
+rb_node* rb_last(rb_node* root) {
+  if (root == nullptr) return nullptr;
+  while (root->right != nullptr) root = root->right;
+  return root;
+}
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+
+#include "util/container_of.h"
+
+namespace gthread {
+/**
+ * the links of an element in an `rb_tree`. they are embedded in the element
+ * itself, so adding it to a tree never allocates.
+ */
+struct rb_node {
+  rb_node* parent;
+  rb_node* left;
+  rb_node* right;
+  bool red;
+};
+
+namespace internal {
+/**
+ * rebalances the tree rooted at |*root| after |n| was linked in as a red leaf
+ */
+void rb_insert_fixup(rb_node** root, rb_node* n);
+
+/**
+ * unlinks |n| from the tree rooted at |*root| and rebalances it
+ */
+void rb_erase(rb_node** root, rb_node* n);
+
+/**
+ * in-order neighbors of |n| (nullptr at either end)
+ */
+rb_node* rb_next(rb_node* n);
+rb_node* rb_prev(rb_node* n);
+
+/**
+ * the minimum and maximum of the tree rooted at |root| (nullptr if empty)
+ */
+rb_node* rb_first(rb_node* root);
+rb_node* rb_last(rb_node* root);
+}  // namespace internal
+
+/**
+ * an intrusive red-black tree of |T|s linked through their |Link| member and
+ * ordered by |Compare|, which is called on `const T*`s. equal elements are
+ * kept in insertion order.
+ *
+ * the tree does not own its elements. an element may only be in one tree per
+ * `rb_node` member at a time and must be erased before it is destroyed.
+ */
+template <typename T, rb_node T::*Link, typename Compare>
+class rb_tree {
+ public:
+  rb_tree() : _root(nullptr), _first(nullptr), _size(0), _compare() {}
+
+  rb_tree(const rb_tree&) = delete;
+  rb_tree& operator=(const rb_tree&) = delete;
+
+  bool empty() const { return _root == nullptr; }
+
+  size_t size() const { return _size; }
+
+  /**
+   * links |t| into the tree in *O(log n)* time
+   */
+  void insert(T* t);
+
+  /**
+   * unlinks |t|, which must be in the tree, in *O(log n)* time
+   */
+  void erase(T* t);
+
+  /**
+   * the minimum element (or nullptr if the tree is empty) in *O(1)* time
+   */
+  T* first() const { return owner(_first); }
+
+  /**
+   * the maximum element (or nullptr if the tree is empty)
+   */
+  T* last() const { return owner(internal::rb_last(_root)); }
+
+  /**
+   * the elements just after and before |t| in order (or nullptr)
+   */
+  T* next(T* t) const { return owner(internal::rb_next(&(t->*Link))); }
+  T* prev(T* t) const { return owner(internal::rb_prev(&(t->*Link))); }
+
+ private:
+  static T* owner(rb_node* n) { return container_of<T, rb_node, Link>(n); }
+
+  rb_node* _root;
+
+  // the leftmost node is cached since it is what a runqueue pops
+  rb_node* _first;
+
+  size_t _size;
+
+  Compare _compare;
+};
+}  // namespace gthread
+
+#include "util/rb_tree_impl.h"
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "util/rb_tree.h"
+
+namespace gthread {
+template <typename T, rb_node T::*Link, typename Compare>
+void rb_tree<T, Link, Compare>::insert(T* t) {
+  rb_node* n = &(t->*Link);
+
+  // walk down to a leaf, going right on ties to keep equal elements in
+  // insertion order
+  rb_node** link = &_root;
+  rb_node* parent = nullptr;
+  bool leftmost = true;
+  while (*link != nullptr) {
+    parent = *link;
+    if (_compare(t, owner(parent))) {
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      leftmost = false;
+    }
+  }
+
+  n->parent = parent;
+  n->left = nullptr;
+  n->right = nullptr;
+  n->red = true;
+  *link = n;
+
+  if (leftmost) _first = n;
+  ++_size;
+
+  internal::rb_insert_fixup(&_root, n);
+}
+
+template <typename T, rb_node T::*Link, typename Compare>
+void rb_tree<T, Link, Compare>::erase(T* t) {
+  rb_node* n = &(t->*Link);
+  if (n == _first) _first = internal::rb_next(n);
+  --_size;
+
+  internal::rb_erase(&_root, n);
+}
+}  // namespace gthread
@@ -0,0 +1,130 @@
+#include "util/rb_tree.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace gthread;
+
+struct item {
+  int key;
+  rb_node link;
+};
+
+struct item_compare {
+  bool operator()(const item* a, const item* b) const {
+    return a->key < b->key;
+  }
+};
+
+using item_tree = rb_tree<item, &item::link, item_compare>;
+
+// returns the black height of the subtree at |n| or -1 if it is invalid
+static int check_subtree(const rb_node* n) {
+  if (n == nullptr) return 1;
+  if (n->left != nullptr && n->left->parent != n) return -1;
+  if (n->right != nullptr && n->right->parent != n) return -1;
+  if (n->red && ((n->left != nullptr && n->left->red) ||
+                 (n->right != nullptr && n->right->red))) {
+    return -1;
+  }
+
+  int left = check_subtree(n->left);
+  int right = check_subtree(n->right);
+  if (left < 0 || left != right) return -1;
+  return left + (n->red ? 0 : 1);
+}
+
+static void check_tree(const item_tree& tree) {
+  if (tree.empty()) {
+    EXPECT_EQ(tree.first(), nullptr);
+    EXPECT_EQ(tree.last(), nullptr);
+    return;
+  }
+
+  const rb_node* root = &tree.first()->link;
+  while (root->parent != nullptr) root = root->parent;
+  EXPECT_FALSE(root->red);
+  EXPECT_GT(check_subtree(root), 0);
+}
+
+TEST(gthread_rb_tree, empty) {
+  item_tree tree;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.size(), 0u);
+  check_tree(tree);
+}
+
+TEST(gthread_rb_tree, equal_keys_keep_insertion_order) {
+  item_tree tree;
+  std::vector<item> items(16);
+  for (auto& i : items) {
+    i.key = 7;
+    tree.insert(&i);
+  }
+
+  auto* cur = tree.first();
+  for (auto& i : items) {
+    EXPECT_EQ(cur, &i);
+    cur = tree.next(cur);
+  }
+  EXPECT_EQ(cur, nullptr);
+  EXPECT_EQ(tree.last(), &items.back());
+}
+
+TEST(gthread_rb_tree, matches_multiset) {
+  constexpr int k_num_items = 4096;
+
+  std::mt19937 rng(1234);
+  std::vector<item> items(k_num_items);
+  std::vector<bool> in_tree(k_num_items, false);
+  std::multiset<int> reference;
+  item_tree tree;
+
+  for (int step = 0; step < 8 * k_num_items; ++step) {
+    auto i = rng() % k_num_items;
+    if (in_tree[i]) {
+      tree.erase(&items[i]);
+      reference.erase(reference.find(items[i].key));
+    } else {
+      items[i].key = rng() % 512;
+      tree.insert(&items[i]);
+      reference.insert(items[i].key);
+    }
+    in_tree[i] = !in_tree[i];
+
+    ASSERT_EQ(tree.size(), reference.size());
+    if (!reference.empty()) {
+      ASSERT_EQ(tree.first()->key, *reference.begin());
+      ASSERT_EQ(tree.last()->key, *reference.rbegin());
+    }
+    if (step % 1024 == 0) check_tree(tree);
+  }
+
+  check_tree(tree);
+
+  // walk both directions
+  auto it = reference.begin();
+  for (auto* cur = tree.first(); cur != nullptr; cur = tree.next(cur)) {
+    ASSERT_EQ(cur->key, *it++);
+  }
+  EXPECT_EQ(it, reference.end());
+
+  auto rit = reference.rbegin();
+  for (auto* cur = tree.last(); cur != nullptr; cur = tree.prev(cur)) {
+    ASSERT_EQ(cur->key, *rit++);
+  }
+  EXPECT_EQ(rit, reference.rend());
+
+  // drain from the front like a runqueue
+  while (!tree.empty()) {
+    auto* first = tree.first();
+    ASSERT_EQ(first->key, *reference.begin());
+    tree.erase(first);
+    reference.erase(reference.begin());
+  }
+  check_tree(tree);
+}
@@ -0,0 +1,144 @@
+#include "util/timing_wheel.h"
+
+#include <cassert>
+
+namespace gthread {
+namespace internal {
+namespace {
+constexpr uint64_t k_slot_mask = timing_wheel_base::k_slots - 1;
+
+// the level a timer expiring on tick |expiry| goes on when it is tick |now|
+unsigned level_of(uint64_t now, uint64_t expiry) {
+  assert(expiry > now);
+  unsigned highest_bit = 63 - __builtin_clzll(expiry ^ now);
+  return highest_bit / timing_wheel_base::k_slot_bits;
+}
+
+void push_front(timing_wheel_node** head, timing_wheel_node* n) {
+  n->next = *head;
+  if (n->next != nullptr) n->next->pprev = &n->next;
+  n->pprev = head;
+  *head = n;
+}
+}  // namespace
+
+timing_wheel_base::timing_wheel_base(uint64_t now)
+    : _now(now), _size(0), _occupied(), _slots(), _ripe(nullptr) {}
+
+void timing_wheel_base::insert(timing_wheel_node* n, uint64_t expiry) {
+  n->expiry = expiry;
+  link(n);
+  ++_size;
+}
+
+void timing_wheel_base::erase(timing_wheel_node* n) {
+  *n->pprev = n->next;
+  if (n->next != nullptr) n->next->pprev = n->pprev;
+
+  if (n->slot != k_ripe_slot) {
+    unsigned level = n->slot / k_slots;
+    unsigned slot = n->slot % k_slots;
+    if (_slots[level][slot] == nullptr) {
+      _occupied[level] &= ~(uint64_t{1} << slot);
+    }
+  }
+  --_size;
+}
+
+timing_wheel_node* timing_wheel_base::expire(uint64_t now) {
+  timing_wheel_node* expired = _ripe;
+  _ripe = nullptr;
+  for (auto* n = expired; n != nullptr; n = n->next) --_size;
+
+  // jump from slot to slot rather than tick to tick, so a wheel that hasn't
+  // been looked at for a long time catches up quickly
+  uint64_t next;
+  while ((next = next_expiry()) <= now) {
+    _now = next;
+
+    // every level whose current slot starts on this tick is due. the levels
+    // below it are empty, because their timers were all due before now.
+    for (unsigned level = k_levels - 1; level > 0; --level) {
+      unsigned shift = level * k_slot_bits;
+      unsigned slot = (_now >> shift) & k_slot_mask;
+      if ((_now & ((uint64_t{1} << shift) - 1)) != 0 ||
+          (_occupied[level] & (uint64_t{1} << slot)) == 0) {
+        continue;
+      }
+
+      // move the timers down a level (or more)
+      auto* n = _slots[level][slot];
+      _slots[level][slot] = nullptr;
+      _occupied[level] &= ~(uint64_t{1} << slot);
+      while (n != nullptr) {
+        auto* following = n->next;
+        if (n->expiry == _now) {
+          push_front(&expired, n);
+          --_size;
+        } else {
+          link(n);
+        }
+        n = following;
+      }
+    }
+
+    unsigned slot = _now & k_slot_mask;
+    if ((_occupied[0] & (uint64_t{1} << slot)) != 0) {
+      // everything on level 0 expires on exactly the tick of its slot
+      auto* n = _slots[0][slot];
+      _slots[0][slot] = nullptr;
+      _occupied[0] &= ~(uint64_t{1} << slot);
+      while (n != nullptr) {
+        auto* following = n->next;
+        push_front(&expired, n);
+        --_size;
+        n = following;
+      }
+    }
+  }
+
+  // nothing is due until after |now|, so the wheel can skip straight there
+  if (now > _now) _now = now;
+
+  return expired;
+}
+
+uint64_t timing_wheel_base::next_expiry() const {
+  if (_ripe != nullptr) return _now;
+
+  // every occupied slot on a level comes after the current one there, so the
+  // lowest one on each level is the next due
+  uint64_t next = UINT64_MAX;
+  for (unsigned level = 0; level < k_levels; ++level) {
+    if (_occupied[level] == 0) continue;
+    auto start = slot_start(level, __builtin_ctzll(_occupied[level]));
+    if (start < next) next = start;
+  }
+  return next;
+}
+
+void timing_wheel_base::link(timing_wheel_node* n) {
+  if (n->expiry <= _now) {
+    n->slot = k_ripe_slot;
+    push_front(&_ripe, n);
+    return;
+  }
+
+  unsigned level = level_of(_now, n->expiry);
+  unsigned slot = (n->expiry >> (level * k_slot_bits)) & k_slot_mask;
+  n->slot = level * k_slots + slot;
+  push_front(&_slots[level][slot], n);
+  _occupied[level] |= uint64_t{1} << slot;
+}
+
+uint64_t timing_wheel_base::slot_start(unsigned level, unsigned slot) const {
+  unsigned shift = level * k_slot_bits;
+  unsigned prefix_shift = shift + k_slot_bits;
+
+  // the digits above |level| are the same as the current tick's
+  uint64_t prefix =
+      prefix_shift >= 64 ? 0 : (_now >> prefix_shift) << prefix_shift;
+  return prefix | (uint64_t{slot} << shift);
+}
+}  // namespace internal
+}  // namespace gthread
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "util/container_of.h"
+
+namespace gthread {
+/**
+ * the links of a timer in a `timing_wheel`. they are embedded in the element
+ * itself, so arming a timer never allocates.
+ */
+struct timing_wheel_node {
+  timing_wheel_node* next;
+  timing_wheel_node** pprev;
+  uint64_t expiry;
+  uint16_t slot;
+};
+
+namespace internal {
+/**
+ * the untyped part of a `timing_wheel`, which works in integer ticks
+ *
+ * timers live in `k_levels` levels of `k_slots` slots each. a timer is put on
+ * the level of the highest digit (in base `k_slots`) in which its expiry
+ * differs from the current tick and in the slot of its expiry's digit there.
+ * when the current tick reaches the start of a slot above level 0, the
+ * timers in it are put back on the levels below, so every timer is delivered
+ * on exactly its tick.
+ */
+class timing_wheel_base {
+ public:
+  static constexpr unsigned k_slot_bits = 6;
+  static constexpr unsigned k_slots = 1u << k_slot_bits;
+
+  // enough levels to cover every 64-bit tick, so nothing has to be clamped
+  static constexpr unsigned k_levels = (64 + k_slot_bits - 1) / k_slot_bits;
+
+  explicit timing_wheel_base(uint64_t now);
+
+  timing_wheel_base(const timing_wheel_base&) = delete;
+  timing_wheel_base& operator=(const timing_wheel_base&) = delete;
+
+  size_t size() const { return _size; }
+
+  /**
+   * arms |n| to expire on tick |expiry| in *O(1)* time. an |expiry| that has
+   * already passed is delivered by the next `expire()`.
+   */
+  void insert(timing_wheel_node* n, uint64_t expiry);
+
+  /**
+   * disarms |n|, which must be armed, in *O(1)* time
+   */
+  void erase(timing_wheel_node* n);
+
+  /**
+   * advances the wheel to tick |now| and returns every timer that expired by
+   * then, linked through `next`
+   */
+  timing_wheel_node* expire(uint64_t now);
+
+  /**
+   * a lower bound on the tick the next timer expires on (`UINT64_MAX` if no
+   * timers are armed). it is exact when that timer is on level 0.
+   */
+  uint64_t next_expiry() const;
+
+ private:
+  // the slot of timers whose expiry had already passed when they were armed
+  static constexpr uint16_t k_ripe_slot = k_levels * k_slots;
+
+  // links |n| into the slot for its expiry without counting it
+  void link(timing_wheel_node* n);
+
+  // the tick on which the timers in |slot| of |level| are due to be moved
+  uint64_t slot_start(unsigned level, unsigned slot) const;
+
+  uint64_t _now;
+
+  size_t _size;
+
+  // bit |i| of `_occupied[l]` is set iff `_slots[l][i]` is not empty
+  uint64_t _occupied[k_levels];
+
+  timing_wheel_node* _slots[k_levels][k_slots];
+
+  timing_wheel_node* _ripe;
+};
+}  // namespace internal
+
+/**
+ * an intrusive hierarchical timing wheel of |T|s linked through their |Link|
+ * member, with a resolution of one |Tick| of |Clock|
+ *
+ * arming and disarming a timer take *O(1)* time and every timer that is ripe
+ * is drained at once by `expire()`. a timer is never delivered before the
+ * time it was armed for.
+ *
+ * the wheel does not own its elements. an element may only be armed once per
+ * `timing_wheel_node` member at a time and must be disarmed or expired before
+ * it is destroyed.
+ */
+template <typename T, timing_wheel_node T::*Link, typename Clock,
+          typename Tick = std::chrono::microseconds>
+class timing_wheel {
+ public:
+  using time_point = typename Clock::time_point;
+
+  timing_wheel() : _wheel(floor_tick(Clock::now())) {}
+
+  bool empty() const { return _wheel.size() == 0; }
+
+  size_t size() const { return _wheel.size(); }
+
+  /**
+   * arms |t| to be ripe at |ripe|
+   */
+  void insert(T* t, time_point ripe) {
+    _wheel.insert(&(t->*Link), ceil_tick(ripe));
+  }
+
+  /**
+   * disarms |t| before it is ripe
+   */
+  void erase(T* t) { _wheel.erase(&(t->*Link)); }
+
+  /**
+   * disarms every element that is ripe at |now| and calls |f| on each of them
+   */
+  template <typename F>
+  void expire(time_point now, const F& f);
+
+  /**
+   * the earliest time an element could be ripe (or `time_point::max()` if the
+   * wheel is empty). the wheel only knows when elements more than 64 ticks
+   * out will be ripe to within a slot, so this may be early but never late.
+   */
+  time_point next_ripe() const;
+
+ private:
+  static uint64_t floor_tick(time_point t) {
+    return std::chrono::floor<Tick>(t.time_since_epoch()).count();
+  }
+
+  static uint64_t ceil_tick(time_point t) {
+    return std::chrono::ceil<Tick>(t.time_since_epoch()).count();
+  }
+
+  static T* owner(timing_wheel_node* n) {
+    return container_of<T, timing_wheel_node, Link>(n);
+  }
+
+  internal::timing_wheel_base _wheel;
+};
+}  // namespace gthread
+
+#include "util/timing_wheel_impl.h"
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "util/timing_wheel.h"
+
+#include <cstdint>
+
+namespace gthread {
+template <typename T, timing_wheel_node T::*Link, typename Clock,
+          typename Tick>
+template <typename F>
+void timing_wheel<T, Link, Clock, Tick>::expire(time_point now, const F& f) {
+  auto* n = _wheel.expire(floor_tick(now));
+  while (n != nullptr) {
+    // |f| may arm the element again, which overwrites its links
+    auto* next = n->next;
+    f(owner(n));
+    n = next;
+  }
+}
+
+template <typename T, timing_wheel_node T::*Link, typename Clock,
+          typename Tick>
+auto timing_wheel<T, Link, Clock, Tick>::next_ripe() const -> time_point {
+  auto tick = _wheel.next_expiry();
+  if (tick == UINT64_MAX) return time_point::max();
+  return time_point{std::chrono::duration_cast<typename Clock::duration>(
+      Tick{static_cast<typename Tick::rep>(tick)})};
+}
+}  // namespace gthread
@@ -0,0 +1,170 @@
+#include "util/timing_wheel.h"
+
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace gthread;
+
+struct fake_clock {
+  using duration = std::chrono::microseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<fake_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() { return current; }
+
+  static time_point current;
+};
+
+fake_clock::time_point fake_clock::current{std::chrono::seconds{1000}};
+
+struct timer {
+  int id;
+  fake_clock::time_point ripe;
+  bool armed = false;
+  timing_wheel_node link;
+};
+
+using timer_wheel = timing_wheel<timer, &timer::link, fake_clock>;
+
+static std::vector<timer*> expire(timer_wheel* wheel,
+                                  fake_clock::time_point now) {
+  std::vector<timer*> expired;
+  wheel->expire(now, [&](timer* t) {
+    t->armed = false;
+    expired.push_back(t);
+  });
+  return expired;
+}
+
+TEST(gthread_timing_wheel, empty) {
+  timer_wheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(wheel.next_ripe(), fake_clock::time_point::max());
+  EXPECT_TRUE(
+      expire(&wheel, fake_clock::now() + std::chrono::hours{1}).empty());
+}
+
+TEST(gthread_timing_wheel, delivers_on_exact_tick) {
+  timer_wheel wheel;
+  auto start = fake_clock::now();
+
+  // spread over several levels of the wheel
+  std::vector<timer> timers;
+  for (auto delay : {1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 300000}) {
+    timers.push_back({static_cast<int>(timers.size()),
+                      start + std::chrono::microseconds{delay}});
+  }
+  for (auto& t : timers) wheel.insert(&t, t.ripe);
+  EXPECT_EQ(wheel.size(), timers.size());
+
+  size_t delivered = 0;
+  for (auto now = start; delivered < timers.size();
+       now += std::chrono::microseconds{1}) {
+    ASSERT_LE(wheel.next_ripe(), timers[delivered].ripe);
+    for (auto* t : expire(&wheel, now)) {
+      EXPECT_EQ(t->ripe, now);
+      ++delivered;
+    }
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(gthread_timing_wheel, past_timers_are_delivered_next) {
+  timer_wheel wheel;
+  auto now = fake_clock::now() + std::chrono::seconds{5};
+  EXPECT_TRUE(expire(&wheel, now).empty());
+
+  timer t{0, now - std::chrono::seconds{1}};
+  wheel.insert(&t, t.ripe);
+  EXPECT_LE(wheel.next_ripe(), now);
+
+  auto expired = expire(&wheel, now);
+  ASSERT_EQ(expired.size(), 1u);
+  EXPECT_EQ(expired[0], &t);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(gthread_timing_wheel, erase_disarms) {
+  timer_wheel wheel;
+  auto start = fake_clock::now();
+
+  timer a{0, start + std::chrono::microseconds{10}};
+  timer b{1, start + std::chrono::microseconds{10}};
+  timer c{2, start + std::chrono::milliseconds{10}};
+  wheel.insert(&a, a.ripe);
+  wheel.insert(&b, b.ripe);
+  wheel.insert(&c, c.ripe);
+
+  wheel.erase(&a);
+  wheel.erase(&c);
+  EXPECT_EQ(wheel.size(), 1u);
+
+  auto expired = expire(&wheel, start + std::chrono::seconds{1});
+  ASSERT_EQ(expired.size(), 1u);
+  EXPECT_EQ(expired[0], &b);
+  EXPECT_EQ(wheel.next_ripe(), fake_clock::time_point::max());
+}
+
+TEST(gthread_timing_wheel, matches_multimap) {
+  constexpr int k_num_timers = 4096;
+
+  std::mt19937_64 rng(1234);
+  std::vector<timer> timers(k_num_timers);
+  std::multimap<fake_clock::time_point, timer*> reference;
+  timer_wheel wheel;
+  auto now = fake_clock::now();
+
+  for (int i = 0; i < k_num_timers; ++i) timers[i].id = i;
+
+  for (int step = 0; step < 64 * k_num_timers; ++step) {
+    auto& t = timers[rng() % k_num_timers];
+    switch (rng() % 4) {
+      case 0:
+      case 1:
+        if (t.armed) break;
+        // delays from a tick to a few days, so every low level gets used
+        t.ripe = now + std::chrono::microseconds{
+                           rng() % (uint64_t{1} << (rng() % 38))};
+        t.armed = true;
+        wheel.insert(&t, t.ripe);
+        reference.emplace(t.ripe, &t);
+        break;
+
+      case 2:
+        if (!t.armed) break;
+        for (auto it = reference.find(t.ripe);; ++it) {
+          if (it->second == &t) {
+            reference.erase(it);
+            break;
+          }
+        }
+        t.armed = false;
+        wheel.erase(&t);
+        break;
+
+      case 3: {
+        now += std::chrono::microseconds{rng() %
+                                         (uint64_t{1} << (rng() % 24))};
+        auto expired = expire(&wheel, now);
+        auto end = reference.upper_bound(now);
+        ASSERT_EQ(expired.size(),
+                  static_cast<size_t>(std::distance(reference.begin(), end)));
+        for (auto* e : expired) ASSERT_LE(e->ripe, now);
+        reference.erase(reference.begin(), end);
+        break;
+      }
+    }
+
+    ASSERT_EQ(wheel.size(), reference.size());
+    if (!reference.empty()) {
+      ASSERT_LE(wheel.next_ripe(), reference.begin()->first);
+    }
+  }
+}